@@ -1,6 +1,15 @@
 #include "3DViewer.h"
-#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <chrono>
+#include <fstream>
+#include <iterator>
 #include "utils/3DFigure.h"
+#include "utils/Trace.h"
+#include "utils/Logger.h"
+#include "utils/ImageFile.h"
+#include "utils/TextWriter.h"
+#include "utils/JsonValue.h"
 #include "tinyfiledialogs.h"
 
 C3DViewer::C3DViewer()
@@ -9,21 +18,36 @@ C3DViewer::C3DViewer()
 
 C3DViewer::~C3DViewer()
 {
-    ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
+    if (!m_headlessMode) {
+        ImGui_ImplOpenGL3_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext();
+    }
+
+    finishSave(true);
+    clearModels();
+    m_workers.reset();
+    m_profiler.release();
+    m_renderStats.uninstall();
+    if (m_traceOnExit) CTrace::writeJson("trace.json");
+    m_geometryPool.release();
+    m_textureCache.release();
+    m_chunkCache.release();
     
     if (m_vbo) glDeleteBuffers(1, &m_vbo);
     if (m_normalVBO) glDeleteBuffers(1, &m_normalVBO);
+    if (m_instanceVBO) glDeleteBuffers(1, &m_instanceVBO);
     if (m_vao) glDeleteVertexArrays(1, &m_vao);
     if (m_normalVAO) glDeleteVertexArrays(1, &m_normalVAO);
     if (m_shaderProgram) glDeleteProgram(m_shaderProgram);
     if (m_window) glfwDestroyWindow(m_window);
+    m_headless.release();
     glfwTerminate();
 }
 
 bool C3DViewer::setup()
 {
+    TRACE_THREAD_NAME("Principal");
     if (!glfwInit()) 
         return false;
 
@@ -51,6 +75,7 @@ bool C3DViewer::setup()
     }
     
     IMGUI_CHECKVERSION();
+    if (CAllocationTracker::isEnabled()) ImGui::SetAllocatorFunctions(CAllocationTracker::imguiAlloc, CAllocationTracker::imguiFree);
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO();
     io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
@@ -63,15 +88,13 @@ bool C3DViewer::setup()
     glfwSetWindowUserPointer(m_window, this);
     glfwSetFramebufferSizeCallback(m_window, [](GLFWwindow* window, int w, int h) {
         auto ptr = reinterpret_cast<C3DViewer*>(glfwGetWindowUserPointer(window));
-        if (ptr) 
+        if (ptr) {
             ptr->resize(w, h);
+            ptr->requestRedraw();
+        }
     });
 
-    if (!setupShader()) return false;
-
-    setupTriangle();
-
-    setupTriangle();
+    if (!setupRenderer()) return false;
 
     glViewport(0, 0, width, height);
     
@@ -82,13 +105,60 @@ bool C3DViewer::setup()
     glfwSetKeyCallback(m_window, keyCallbackStatic);
     glfwSetMouseButtonCallback(m_window, mouseButtonCallbackStatic);
     glfwSetCursorPosCallback(m_window, cursorPosCallbackStatic);
+    glfwSetScrollCallback(m_window, scrollCallbackStatic);
+    glfwSetCharCallback(m_window, charCallbackStatic);
+    glfwSetWindowFocusCallback(m_window, windowFocusCallbackStatic);
+    glfwSetCursorEnterCallback(m_window, cursorEnterCallbackStatic);
+    glfwSetWindowRefreshCallback(m_window, windowRefreshCallbackStatic);
+
+    return true;
+}
+
+bool C3DViewer::setupHeadless(int targetWidth, int targetHeight)
+{
+    TRACE_THREAD_NAME("Principal");
+    if (!m_headless.create() || !m_headless.createTarget(targetWidth, targetHeight)) return false;
+
+    m_headlessMode = true;
+    panelWidth = 0.0f;
+    width = targetWidth;
+    height = targetHeight;
+
+    if (!setupRenderer()) return false;
+
+    glViewport(0, 0, width, height);
+    glEnable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    return true;
+}
+
+bool C3DViewer::setupRenderer()
+{
+    if (!setupShader()) return false;
+    m_renderStats.install();
+
+    setupTriangle();
 
+    m_profiler.addSection("Frame", false);
+    m_profiler.addSection("Relleno", true);
+    m_profiler.addSection("Alambrado", true);
+    m_profiler.addSection("Vertices", true);
+    m_profiler.addSection("Normales", true);
+    m_profiler.addSection("BBox", true);
+    m_profiler.addSection("Picking", true);
+    m_profiler.addSection("ImGui", true);
     return true;
 }
 
+static double steadySeconds()
+{
+    static const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
 void C3DViewer::update()
 {
-    float currentFrame = (float)glfwGetTime();
+    float currentFrame = (float)(m_window ? glfwGetTime() : steadySeconds());
     m_deltaTime = currentFrame - m_lastFrame;
     m_lastFrame = currentFrame;
 
@@ -101,6 +171,7 @@ void C3DViewer::update()
     }
 
     fill(m_buffer.begin(), m_buffer.end(), m_background_color);
+    if (!m_window) return;
 
     float cameraSpeed = 2.5f * m_deltaTime;
 
@@ -126,7 +197,18 @@ void C3DViewer::mainLoop()
 {
     while (!glfwWindowShouldClose(m_window)) 
     {
-        glfwPollEvents();
+        if (m_continuousRender || m_redrawFrames > 0 || isAnimating()) {
+            glfwPollEvents();
+        } else {
+            glfwWaitEventsTimeout(m_saveProgress ? 0.1 : 1.0);
+            if (m_redrawFrames == 0 && !m_saveProgress) {
+                m_renderStats.poll(glfwGetTime());
+                continue;
+            }
+            m_lastFrame = (float)glfwGetTime();
+        }
+        m_renderStats.poll(glfwGetTime());
+        if (m_redrawFrames > 0) m_redrawFrames--;
 
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -137,7 +219,370 @@ void C3DViewer::mainLoop()
     }
 }
 
-void C3DViewer::onKey(int key, int scancode, int action, int mods) 
+static bool writeTextFile(const string& path, const CTextWriter& out)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    bool written = file && out.writeTo(file);
+    if (file) written = (fclose(file) == 0) && written;
+    if (!written) LOG_ERROR(LOG_IO, "Error escribiendo estadisticas: %s", path.c_str());
+    return written;
+}
+
+bool C3DViewer::loadHeadlessModel(const string& path)
+{
+    C3DFigure* figure = new C3DFigure();
+    shared_ptr<CChunkStore> chunks;
+    if (!loadFigure(figure, path, chunks)) {
+        LOG_ERROR(LOG_IO, "Error cargando: %s", path.c_str());
+        delete figure;
+        return false;
+    }
+    addModel(figure, true, chunks);
+    completeUploads(3, 30.0);
+    return true;
+}
+
+bool C3DViewer::completeUploads(int minimumFrames, double timeoutSeconds)
+{
+    double deadline = steadySeconds() + timeoutSeconds;
+    int frames = 0;
+    do {
+        renderTimedFrame();
+    } while ((++frames < minimumFrames || hasPendingUploads()) && steadySeconds() < deadline);
+    return !hasPendingUploads();
+}
+
+float C3DViewer::renderTimedFrame()
+{
+    double start = steadySeconds();
+    m_headless.bindTarget();
+    render();
+    glFinish();
+    return (float)((steadySeconds() - start) * 1000.0);
+}
+
+bool C3DViewer::runHeadless(const HeadlessOptions& options)
+{
+    if (!loadHeadlessModel(options.modelPath)) return false;
+
+    std::error_code error;
+    std::filesystem::create_directories(options.outputDirectory, error);
+
+    CTextWriter out;
+    out.append("{\"model\":");
+    out.appendQuoted(options.modelPath.c_str());
+    out.append(",\"renderer\":");
+    out.appendQuoted((const char*)glGetString(GL_RENDERER));
+    out.append(",\"width\":");
+    out.appendInt(width);
+    out.append(",\"height\":");
+    out.appendInt(height);
+    out.append(",\"framesPerView\":");
+    out.appendInt(options.frames);
+    out.append(",\"views\":[\n");
+
+    bool success = true;
+    vector<float> times, allTimes;
+    vector<unsigned char> pixels, golden;
+    for (int view = 0; view < options.views; ++view) {
+        float yaw = 360.0f * view / options.views;
+        float pitch = (view % 2) ? -20.0f : 20.0f;
+        m_rotation = glm::angleAxis(glm::radians(pitch), glm::vec3(1.0f, 0.0f, 0.0f)) *
+                     glm::angleAxis(glm::radians(yaw), glm::vec3(0.0f, 1.0f, 0.0f));
+        m_modelPos = glm::vec3(0.0f);
+        m_camPos = glm::vec3(0.0f, 0.0f, 3.0f);
+        m_yaw = -90.0f;
+        m_pitch = 0.0f;
+        updateCameraVectors();
+
+        times.clear();
+        for (int frame = 0; frame < std::max(1, options.frames); ++frame) {
+            times.push_back(renderTimedFrame());
+        }
+        RenderCounters counters = m_renderStats.getLastFrame();
+        allTimes.insert(allTimes.end(), times.begin(), times.end());
+
+        char name[32];
+        snprintf(name, sizeof(name), "view_%02d.ppm", view);
+        string imagePath = (std::filesystem::path(options.outputDirectory) / name).string();
+        if (!m_headless.readPixels(pixels) || !CImageFile::writePpm(imagePath, width, height, pixels)) {
+            LOG_ERROR(LOG_IO, "Error escribiendo imagen: %s", imagePath.c_str());
+            success = false;
+        }
+
+        long long differences = -1;
+        if (!options.goldenDirectory.empty()) {
+            int goldenWidth = 0, goldenHeight = 0;
+            string goldenPath = (std::filesystem::path(options.goldenDirectory) / name).string();
+            if (CImageFile::readPpm(goldenPath, goldenWidth, goldenHeight, golden) && goldenWidth == width && goldenHeight == height) {
+                differences = (long long)CImageFile::countDifferences(pixels, golden, options.tolerance);
+            } else {
+                differences = (long long)width * height;
+            }
+            if (differences > (long long)width * height / 1000) {
+                LOG_ERROR(LOG_RENDER, "La vista %d difiere de la referencia (%lld pixeles)", view, differences);
+                success = false;
+            }
+        }
+
+        float sum = 0.0f;
+        for (float t : times) sum += t;
+        std::sort(times.begin(), times.end());
+
+        if (view > 0) out.append(",\n");
+        out.append("{\"index\":");
+        out.appendInt(view);
+        out.append(",\"yaw\":");
+        out.appendFloat(yaw);
+        out.append(",\"pitch\":");
+        out.appendFloat(pitch);
+        out.append(",\"image\":");
+        out.appendQuoted(name);
+        out.append(",\"meanMs\":");
+        out.appendFloat(sum / times.size());
+        out.append(",\"minMs\":");
+        out.appendFloat(times.front());
+        out.append(",\"p50Ms\":");
+        out.appendFloat(sortedPercentile(times, 50.0f));
+        out.append(",\"p95Ms\":");
+        out.appendFloat(sortedPercentile(times, 95.0f));
+        out.append(",\"maxMs\":");
+        out.appendFloat(times.back());
+        out.append(",\"drawCalls\":");
+        out.appendInt((long long)counters.drawCalls);
+        out.append(",\"triangles\":");
+        out.appendInt((long long)counters.triangles);
+        if (differences >= 0) {
+            out.append(",\"differentPixels\":");
+            out.appendInt(differences);
+        }
+        out.append('}');
+    }
+
+    float sum = 0.0f;
+    for (float t : allTimes) sum += t;
+    std::sort(allTimes.begin(), allTimes.end());
+    out.append("\n],\"meanMs\":");
+    out.appendFloat(allTimes.empty() ? 0.0f : sum / allTimes.size());
+    out.append(",\"p50Ms\":");
+    out.appendFloat(sortedPercentile(allTimes, 50.0f));
+    out.append(",\"p95Ms\":");
+    out.appendFloat(sortedPercentile(allTimes, 95.0f));
+    out.append(",\"p99Ms\":");
+    out.appendFloat(sortedPercentile(allTimes, 99.0f));
+    out.append(",\"passed\":");
+    out.append(success ? "true" : "false");
+    out.append("}\n");
+
+    string statsPath = (std::filesystem::path(options.outputDirectory) / "stats.json").string();
+    if (!writeTextFile(statsPath, out)) return false;
+    LOG_INFO(LOG_RENDER, "Render sin ventana: %d vistas en %s", options.views, options.outputDirectory.c_str());
+    return success;
+}
+
+enum BenchmarkPath {
+    BENCHMARK_ORBIT,
+    BENCHMARK_FLY,
+    BENCHMARK_ZOOM
+};
+
+enum BenchmarkDisplay {
+    DISPLAY_FACES = 1,
+    DISPLAY_WIREFRAME = 2,
+    DISPLAY_VERTICES = 4,
+    DISPLAY_NORMALS = 8,
+    DISPLAY_BBOX = 16
+};
+
+struct BenchmarkSegment {
+    const char* name;
+    BenchmarkPath path;
+    int display;
+};
+
+static const BenchmarkSegment benchmarkSegments[] = {
+    { "orbita_relleno", BENCHMARK_ORBIT, DISPLAY_FACES },
+    { "orbita_alambrado", BENCHMARK_ORBIT, DISPLAY_FACES | DISPLAY_WIREFRAME },
+    { "vuelo_vertices", BENCHMARK_FLY, DISPLAY_FACES | DISPLAY_VERTICES },
+    { "zoom_normales", BENCHMARK_ZOOM, DISPLAY_FACES | DISPLAY_NORMALS },
+    { "vuelo_completo", BENCHMARK_FLY, DISPLAY_FACES | DISPLAY_WIREFRAME | DISPLAY_VERTICES | DISPLAY_NORMALS | DISPLAY_BBOX }
+};
+
+void C3DViewer::applyDisplayMode(int display)
+{
+    for (auto& model : m_models) {
+        auto& meshes = model.figure->getSubMeshesModifiable();
+        for (auto& mesh : meshes) {
+            mesh.showFaces = (display & DISPLAY_FACES) != 0;
+            mesh.showWireframe = (display & DISPLAY_WIREFRAME) != 0;
+            mesh.showVertices = (display & DISPLAY_VERTICES) != 0;
+            mesh.showNormals = (display & DISPLAY_NORMALS) != 0;
+        }
+        model.table.build(meshes);
+    }
+    m_showBBox = (display & DISPLAY_BBOX) != 0;
+    selectedSubMeshIndex = m_showBBox && m_currentModel && !m_currentModel->getSubMeshes().empty() ? 0 : -1;
+    updateResidency();
+}
+
+void C3DViewer::applyCameraPath(int path, float t)
+{
+    const float turn = 2.0f * glm::pi<float>();
+    m_modelPos = glm::vec3(0.0f);
+    m_rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    m_camPos = glm::vec3(0.0f, 0.0f, 3.0f);
+    m_yaw = -90.0f;
+    m_pitch = 0.0f;
+
+    if (path == BENCHMARK_ORBIT) {
+        m_rotation = glm::angleAxis(glm::radians(20.0f), glm::vec3(1.0f, 0.0f, 0.0f)) *
+                     glm::angleAxis(turn * t, glm::vec3(0.0f, 1.0f, 0.0f));
+    } else if (path == BENCHMARK_FLY) {
+        m_camPos = glm::vec3(0.4f * sin(turn * t), 0.2f, 3.0f - 4.5f * t);
+        m_yaw = -90.0f + 20.0f * sin(turn * t);
+        m_pitch = -10.0f;
+    } else {
+        m_rotation = glm::angleAxis(glm::radians(30.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        m_camPos = glm::vec3(0.0f, 0.0f, 4.0f - 2.8f * t);
+    }
+    updateCameraVectors();
+}
+
+static bool loadBaseline(const string& path, CJsonValue& baseline)
+{
+    ifstream file(path, ios::binary);
+    if (!file.is_open()) return false;
+    string text((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    return CJsonValue::parse(text.data(), text.size(), baseline) && baseline["segments"].isArray();
+}
+
+bool C3DViewer::runBenchmark(const BenchmarkOptions& options)
+{
+    if (!loadHeadlessModel(options.modelPath)) return false;
+
+    CJsonValue baseline;
+    bool hasBaseline = !options.baselinePath.empty() && loadBaseline(options.baselinePath, baseline);
+    if (!options.baselinePath.empty() && !hasBaseline) {
+        LOG_WARNING(LOG_IO, "No se pudo leer la linea base: %s", options.baselinePath.c_str());
+    }
+
+    int frames = std::max(2, options.frames);
+    CTextWriter out;
+    out.append("{\"model\":");
+    out.appendQuoted(options.modelPath.c_str());
+    out.append(",\"renderer\":");
+    out.appendQuoted((const char*)glGetString(GL_RENDERER));
+    out.append(",\"width\":");
+    out.appendInt(width);
+    out.append(",\"height\":");
+    out.appendInt(height);
+    out.append(",\"framesPerSegment\":");
+    out.appendInt(frames);
+    out.append(",\"segments\":[\n");
+
+    bool passed = true;
+    vector<float> times;
+    for (size_t s = 0; s < sizeof(benchmarkSegments) / sizeof(benchmarkSegments[0]); ++s) {
+        const BenchmarkSegment& segment = benchmarkSegments[s];
+        applyDisplayMode(segment.display);
+        applyCameraPath(segment.path, 0.0f);
+        renderTimedFrame();
+
+        RenderCounters totals;
+        times.clear();
+        for (int frame = 0; frame < frames; ++frame) {
+            applyCameraPath(segment.path, (float)frame / (frames - 1));
+            times.push_back(renderTimedFrame());
+            totals.add(m_renderStats.getLastFrame());
+        }
+
+        float sum = 0.0f;
+        for (float t : times) sum += t;
+        std::sort(times.begin(), times.end());
+        float p95 = sortedPercentile(times, 95.0f);
+
+        if (s > 0) out.append(",\n");
+        out.append("{\"name\":");
+        out.appendQuoted(segment.name);
+        out.append(",\"frames\":");
+        out.appendInt(frames);
+        out.append(",\"meanMs\":");
+        out.appendFloat(sum / frames);
+        out.append(",\"p50Ms\":");
+        out.appendFloat(sortedPercentile(times, 50.0f));
+        out.append(",\"p95Ms\":");
+        out.appendFloat(p95);
+        out.append(",\"p99Ms\":");
+        out.appendFloat(sortedPercentile(times, 99.0f));
+        out.append(",\"maxMs\":");
+        out.appendFloat(times.back());
+        out.append(",\"drawCalls\":");
+        out.appendInt((long long)(totals.drawCalls / frames));
+        out.append(",\"triangles\":");
+        out.appendInt((long long)(totals.triangles / frames));
+        out.append(",\"lines\":");
+        out.appendInt((long long)(totals.lines / frames));
+        out.append(",\"points\":");
+        out.appendInt((long long)(totals.points / frames));
+
+        const CJsonValue& segments = baseline["segments"];
+        for (size_t b = 0; hasBaseline && b < segments.size(); ++b) {
+            const CJsonValue& reference = segments[b];
+            if (reference["name"].asString() != segment.name) continue;
+
+            float baselineP95 = (float)reference["p95Ms"].asNumber();
+            bool regression = baselineP95 > 0.0f && p95 > baselineP95 * (1.0f + options.threshold);
+            if (regression) passed = false;
+            if ((long long)reference["triangles"].asNumber() != (long long)(totals.triangles / frames)) {
+                LOG_WARNING(LOG_RENDER, "El segmento %s dibuja otra cantidad de triangulos que la linea base", segment.name);
+            }
+            out.append(",\"baselineP95Ms\":");
+            out.appendFloat(baselineP95);
+            out.append(",\"regression\":");
+            out.append(regression ? "true" : "false");
+            if (regression) {
+                LOG_ERROR(LOG_RENDER, "Regresion en %s: p95 %.3f ms (linea base %.3f ms)", segment.name, p95, baselineP95);
+            }
+            break;
+        }
+        out.append('}');
+
+        LOG_INFO(LOG_RENDER, "%-18s p50 %.3f ms  p95 %.3f ms  p99 %.3f ms  draws %llu  tris %llu", segment.name,
+                 sortedPercentile(times, 50.0f), p95, sortedPercentile(times, 99.0f),
+                 (unsigned long long)(totals.drawCalls / frames), (unsigned long long)(totals.triangles / frames));
+    }
+    out.append("\n],\"passed\":");
+    out.append(passed ? "true" : "false");
+    out.append("}\n");
+
+    if (!writeTextFile(options.outputPath, out)) return false;
+    return passed;
+}
+
+void C3DViewer::requestRedraw()
+{
+    m_redrawFrames = 3;
+}
+
+bool C3DViewer::isAnimating()
+{
+    const int keys[] = { GLFW_KEY_UP, GLFW_KEY_DOWN, GLFW_KEY_LEFT, GLFW_KEY_RIGHT };
+    for (int key : keys) {
+        if (glfwGetKey(m_window, key) == GLFW_PRESS) return true;
+    }
+    return hasPendingUploads();
+}
+
+bool C3DViewer::hasPendingUploads()
+{
+    if (m_textureCache.isLoading() || m_chunkCache.hasDeferredUploads()) return true;
+    for (const auto& model : m_models) {
+        if (model.cloud && (model.cloud->isBuilding() || model.cloud->hasDeferredUploads())) return true;
+    }
+    return false;
+}
+
+void C3DViewer::onKey(int key, int, int action, int) 
 {
     if (action == GLFW_PRESS || action == GLFW_REPEAT)
     {
@@ -146,7 +591,7 @@ void C3DViewer::onKey(int key, int scancode, int action, int mods)
     }
 }
 
-void C3DViewer::onMouseButton(int button, int action, int mods) 
+void C3DViewer::onMouseButton(int button, int action, int) 
 {
     if (ImGui::GetIO().WantCaptureMouse) return;
     
@@ -174,6 +619,8 @@ void C3DViewer::onMouseButton(int button, int action, int mods)
 
 void C3DViewer::performPicking(int x, int y) 
 {
+    TRACE_ZONE("performPicking");
+    CProfileScope scope(m_profiler, PROFILE_PICKING);
     glViewport((int)panelWidth, 0, width - (int)panelWidth, height);
     
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
@@ -181,51 +628,58 @@ void C3DViewer::performPicking(int x, int y)
 
     glUseProgram(m_shaderProgram);
     
-    float aspect = (float)(width - panelWidth) / (float)height;
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 100.0f);
-    glm::mat4 view = glm::lookAt(m_camPos, m_camPos + m_camFront, m_camUp);
-    
-    glm::mat4 model = glm::translate(glm::mat4(1.0f), m_modelPos);
-    model = model * glm::mat4_cast(m_rotation);
-    model = glm::scale(model, m_userScale * scale_factor);
-    
-    glm::mat4 mvp = projection * view * model;
+    syncSceneTransforms();
+    m_scene.update();
+    glm::mat4 viewProjection = computeViewProjection();
 
     GLuint mvpLoc = glGetUniformLocation(m_shaderProgram, "u_mvp");
-    glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, glm::value_ptr(mvp));
-
     GLint isPickingLoc = glGetUniformLocation(m_shaderProgram, "u_isPicking");
     GLint pickColorLoc = glGetUniformLocation(m_shaderProgram, "u_pickingColor");
+    GLuint offsetLoc = glGetUniformLocation(m_shaderProgram, "u_elementOffset");
     
     glUniform1i(isPickingLoc, 1);
+    glUniform3f(offsetLoc, 0.0f, 0.0f, 0.0f);
 
-    if (m_currentModel) {
-        glBindVertexArray(m_vao);
-        
-        const std::vector<SubMesh>& subMeshes = m_currentModel->getSubMeshes();
-        GLuint offsetLoc = glGetUniformLocation(m_shaderProgram, "u_elementOffset");
+    glBindVertexArray(m_vao);
+    int pickId = 0;
+    for (const auto& model : m_models) {
+        const std::vector<SubMesh>& subMeshes = model.figure->getSubMeshes();
+        if (model.chunks) {
+            drawChunkedModel(model, viewProjection, true, pickId);
+            glBindVertexArray(m_vao);
+            pickId += (int)subMeshes.size();
+            continue;
+        }
+
+        const CRenderTable& table = model.table;
+        for (int i = 0; i < table.size(); ++i, ++pickId) {
+            glm::mat4 mvp = viewProjection * m_scene.getWorld(model.firstSubMeshNode + i);
+            glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, glm::value_ptr(mvp));
 
-        for (int i = 0; i < (int)subMeshes.size(); ++i) {
-            glm::vec3 pickColor = indexToColor(i); 
+            glm::vec3 pickColor = indexToColor(pickId); 
             glUniform3fv(pickColorLoc, 1, glm::value_ptr(pickColor));
-            glUniform3fv(offsetLoc, 1, glm::value_ptr(subMeshes[i].offset));
             
-            glDrawArrays(GL_TRIANGLES, subMeshes[i].startVertex, subMeshes[i].vertexCount);
+            glDrawArrays(GL_TRIANGLES, model.baseVertex + table.getStartVertex(i), table.getVertexCount(i));
         }
-        glBindVertexArray(0);
     }
+    glBindVertexArray(0);
 
     unsigned char pixel[4];
     glReadPixels(x, height - y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
 
     int pickedID = colorToIndex(pixel[0], pixel[1], pixel[2]);
 
-    if (pickedID != -1 && pickedID < (int)m_currentModel->getSubMeshes().size()) {
-        selectedSubMeshIndex = pickedID;
-        m_showBBox = true;
-    } else {
-        selectedSubMeshIndex = -1;
-        m_showBBox = false;
+    selectedSubMeshIndex = -1;
+    m_showBBox = false;
+    for (int m = 0; m < (int)m_models.size() && pickedID >= 0; ++m) {
+        int count = (int)m_models[m].figure->getSubMeshes().size();
+        if (pickedID < count) {
+            setActiveModel(m);
+            selectedSubMeshIndex = pickedID;
+            m_showBBox = true;
+            break;
+        }
+        pickedID -= count;
     }
 
     glUniform1i(isPickingLoc, 0);
@@ -240,7 +694,7 @@ void C3DViewer::onCursorPos(double xpos, double ypos)
 {
     if (mouseButtonsDown[0] || mouseButtonsDown[1] || mouseButtonsDown[2]) 
     {
-        cout << "Mouse Drag at " << xpos << ", " << ypos << "\n";
+        LOG_TRACE(LOG_INPUT, "Mouse Drag at %.1f, %.1f", xpos, ypos);
     }
 
     if (mouseButtonsDown[0]) 
@@ -290,64 +744,95 @@ void C3DViewer::onCursorPos(double xpos, double ypos)
 }
 
 void C3DViewer::render() {
+    AllocationCounters allocationsBefore;
+    CAllocationTracker::snapshot(allocationsBefore);
+    CAllocationScope renderScope(ALLOC_RENDER);
+    m_profiler.collect();
+    TRACE_ZONE("Frame");
+    CProfileScope frameScope(m_profiler, PROFILE_FRAME);
     update();
     
     if (m_requestLoad) {
         m_requestLoad = false;
-        const char* filterPatterns[] = { "*.obj" };
+        const char* filterPatterns[] = { "*.obj", "*.glb", "*.ply" };
         const char* openPath = nullptr;
         try {
             openPath = tinyfd_openFileDialog(
-                "Cargar Modelo", "", 1, filterPatterns, "Archivos Wavefront OBJ", 0
+                "Cargar Modelo", "", 3, filterPatterns, "Modelos OBJ / GLB / PLY", 0
             );
         } catch (...) {
-            std::cerr << "Excepcion atrapada al abrir dialogo de archivo." << std::endl;
+            LOG_ERROR(LOG_IO, "Excepcion atrapada al abrir dialogo de archivo.");
         }
 
         if (openPath) {
             C3DFigure* newModel = new C3DFigure();
-            if (newModel->loadObject(string(openPath))) {
-                if (m_ownsModel && m_currentModel) {
-                    delete m_currentModel;
-                }
-                setupModel(newModel);
-                m_ownsModel = true;
-                
-                m_modelPos = glm::vec3(0.0f);
-                m_rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
-                m_userScale = glm::vec3(1.0f); 
-                m_currentModel->normalization(); 
-                setupModel(m_currentModel);
-                
-                selectedSubMeshIndex = -1;
-                m_showBBox = false;
+            shared_ptr<CChunkStore> chunks;
+            if (loadFigure(newModel, string(openPath), chunks)) {
+                clearModels();
+                addModel(newModel, true, chunks);
             } else {
-                std::cerr << "Error cargando: " << openPath << std::endl;
+                LOG_ERROR(LOG_IO, "Error cargando: %s", openPath);
                 delete newModel;
             }
         }
     }
 
+    if (m_requestAdd) {
+        m_requestAdd = false;
+        const char* filterPatterns[] = { "*.obj", "*.glb", "*.ply" };
+        const char* openPath = nullptr;
+        try {
+            openPath = tinyfd_openFileDialog(
+                "Agregar Modelo", "", 3, filterPatterns, "Modelos OBJ / GLB / PLY", 0
+            );
+        } catch (...) {
+            LOG_ERROR(LOG_IO, "Excepcion atrapada al abrir dialogo de archivo.");
+        }
+
+        if (openPath) {
+            C3DFigure* newModel = new C3DFigure();
+            shared_ptr<CChunkStore> chunks;
+            if (loadFigure(newModel, string(openPath), chunks)) {
+                addModel(newModel, true, chunks);
+            } else {
+                LOG_ERROR(LOG_IO, "Error cargando: %s", openPath);
+                delete newModel;
+            }
+        }
+    }
+
+    if (m_saveProgress && m_saveProgress->finished) finishSave(false);
+    updateResidency();
+
+    if (m_requestTrace) {
+        m_requestTrace = false;
+        const char* filterPatterns[] = { "*.json" };
+        const char* tracePath = tinyfd_saveFileDialog("Exportar Traza", "trace.json", 1, filterPatterns, "Chrome Trace JSON");
+        if (tracePath) {
+            CAllocationScope ioScope(ALLOC_IO);
+            CTrace::writeJson(string(tracePath));
+        }
+    }
+
     if (m_requestSave && m_currentModel) {
         m_requestSave = false;
-        const char* filterPatterns[] = { "*.obj" };
+        const char* filterPatterns[] = { "*.obj", "*.glb", "*.ply" };
         const char* savePath = nullptr;
         try {
             savePath = tinyfd_saveFileDialog(
-                "Guardar Modelo", "modelo_exportado.obj", 1, filterPatterns, "Archivos Wavefront OBJ"
+                "Guardar Modelo", "modelo_exportado.obj", 2, filterPatterns, "Modelos OBJ / GLB"
             );
         } catch (...) {
-            std::cerr << "Excepcion WinRT detectada. Intentando guardar en backup_model.obj..." << std::endl;
-            if (m_currentModel) {
-                 m_currentModel->saveObject("backup_model.obj", m_modelPos, m_rotation, m_userScale * scale_factor);
-                 std::cerr << "Respaldo guardado exitosamente como 'backup_model.obj'" << std::endl;
-            }
+            LOG_ERROR(LOG_IO, "Excepcion WinRT detectada. Intentando guardar en backup_model.obj...");
+            startSave("backup_model.obj");
         }
 
         if (savePath) {
-            m_currentModel->saveObject(string(savePath), m_modelPos, m_rotation, m_userScale * scale_factor);
+            startSave(string(savePath));
         }
     }
+
+    CAllocationTracker::setFrameGuard(m_steadyFrames >= 3);
     
     if (m_enableDepthTest) glEnable(GL_DEPTH_TEST);
     else glDisable(GL_DEPTH_TEST);
@@ -383,101 +868,138 @@ void C3DViewer::render() {
     glUseProgram(m_shaderProgram);
 
     if (height == 0) height = 1; 
-    float aspect = (float)(width - panelWidth) / (float)height;
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 100.0f);
-    glm::mat4 view = glm::lookAt(m_camPos, m_camPos + m_camFront, m_camUp);
-    glm::mat4 model = glm::translate(glm::mat4(1.0f), m_modelPos);
-    model = model * glm::mat4_cast(m_rotation); 
-    model = glm::scale(model, m_userScale * scale_factor);
-
-    glm::mat4 mvp = projection * view * model;
+    syncSceneTransforms();
+    m_scene.update();
+    glm::mat4 viewProjection = computeViewProjection();
 
     GLuint mvpLoc = glGetUniformLocation(m_shaderProgram, "u_mvp");
-    if (mvpLoc != -1) {
-        glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, glm::value_ptr(mvp));
-    }
     glUniform1i(glGetUniformLocation(m_shaderProgram, "u_selectedIndex"), selectedSubMeshIndex);
 
-    if (m_currentModel) {
-        glBindVertexArray(m_vao);
-        const auto& meshes = m_currentModel->getSubMeshes();
-        GLuint meshIdLoc = glGetUniformLocation(m_shaderProgram, "u_currentMeshID");
-        GLuint offsetLoc = glGetUniformLocation(m_shaderProgram, "u_elementOffset");
-        GLuint colorLoc  = glGetUniformLocation(m_shaderProgram, "u_elementColor");
+    GLuint meshIdLoc = glGetUniformLocation(m_shaderProgram, "u_currentMeshID");
+    GLuint offsetLoc = glGetUniformLocation(m_shaderProgram, "u_elementOffset");
+    GLuint colorLoc  = glGetUniformLocation(m_shaderProgram, "u_elementColor");
+    GLint instancedLoc = glGetUniformLocation(m_shaderProgram, "u_instanced");
+    GLint hasTextureLoc = glGetUniformLocation(m_shaderProgram, "u_hasTexture");
+    GLint vertexColorsLoc = glGetUniformLocation(m_shaderProgram, "u_vertexColors");
 
-        glEnable(GL_POLYGON_OFFSET_FILL);
-        glPolygonOffset(1.0f, 1.0f);
+    m_textureCache.pump(8 * 1024 * 1024);
 
-        for (int i = 0; i < (int)meshes.size(); ++i) {
-            glUniform1i(meshIdLoc, i);
-            glUniform3fv(offsetLoc, 1, glm::value_ptr(meshes[i].offset));
-            glUniform3fv(colorLoc, 1, glm::value_ptr(meshes[i].material.kd));
-            
-            if (meshes[i].showFaces && meshes[i].vertexCount > 0) {
-                glDrawArrays(GL_TRIANGLES, meshes[i].startVertex, meshes[i].vertexCount);
-            }
-        }
-        
-        glDisable(GL_POLYGON_OFFSET_FILL);
+    m_profiler.begin(PROFILE_FILL);
 
-        for (int i = 0; i < (int)meshes.size(); ++i) {
-            if (meshes[i].showWireframe && meshes[i].vertexCount > 0) {
-                glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-                
-                glUniform1i(meshIdLoc, i);
-                glUniform3fv(offsetLoc, 1, glm::value_ptr(meshes[i].offset));
-                
-                vec3 wireColor = vec3(meshes[i].wireframeColor.r / 255.0f,
-                                      meshes[i].wireframeColor.g / 255.0f,
-                                      meshes[i].wireframeColor.b / 255.0f);
-                glUniform3fv(colorLoc, 1, glm::value_ptr(wireColor));
-                
-                glDrawArrays(GL_TRIANGLES, meshes[i].startVertex, meshes[i].vertexCount);
-                
-                glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-            }
+    glBindVertexArray(m_vao);
+
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(1.0f, 1.0f);
+
+    m_chunkCache.setBudget((size_t)m_geometryBudgetMB * 1024 * 1024);
+    m_chunkCache.beginFrame();
+    for (const auto& model : m_models) {
+        if (model.chunks) {
+            drawChunkedModel(model, viewProjection, false, 0);
+            glBindVertexArray(m_vao);
+            continue;
         }
+        glm::mat4 mvp = viewProjection * m_scene.getWorld(model.node);
+        glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, glm::value_ptr(mvp));
+        glUniform1i(vertexColorsLoc, model.vertexColors);
 
-        glEnable(GL_PROGRAM_POINT_SIZE); 
-        
-        for (int i = 0; i < (int)meshes.size(); ++i) {
-            if (meshes[i].showVertices && meshes[i].vertexCount > 0) {
-                glPointSize(meshes[i].vertexSize);
-                
-                glUniform1i(meshIdLoc, i);
-                glUniform3fv(offsetLoc, 1, glm::value_ptr(meshes[i].offset));
-                
-                vec3 vColor = vec3(meshes[i].vertexColor.r / 255.0f,
-                                   meshes[i].vertexColor.g / 255.0f,
-                                   meshes[i].vertexColor.b / 255.0f);
-                glUniform3fv(colorLoc, 1, glm::value_ptr(vColor));
-                
-                glDrawArrays(GL_POINTS, meshes[i].startVertex, meshes[i].vertexCount);
-            }
+        if (m_batchByMaterial) {
+            drawFacesInstanced(model, instancedLoc, hasTextureLoc, true);
+            drawMaterialBatches(model, meshIdLoc, offsetLoc, colorLoc, hasTextureLoc);
+        } else {
+            drawFacesInstanced(model, instancedLoc, hasTextureLoc, false);
         }
-        glDisable(GL_PROGRAM_POINT_SIZE);
     }
+    
+    m_chunkCache.endFrame();
+    TRACE_COUNTER("Chunks dibujados", m_chunkCache.getDrawnChunks());
+    TRACE_COUNTER("VRAM geometria (MB)", m_chunkCache.getResidentBytes() / (1024.0 * 1024.0));
+    
+    renderPointClouds(viewProjection);
+    glBindVertexArray(m_vao);
+    m_profiler.end(PROFILE_FILL);
 
-    if (m_currentModel) {
-        const auto& meshes = m_currentModel->getSubMeshes();
-        glUseProgram(m_shaderProgram); 
-        
-        for (const auto& mesh : meshes) {
-            if (mesh.showNormals && mesh.vertexCount > 0) {
-                renderNormals(mesh);
-            }
-        }
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glUniform1i(vertexColorsLoc, 0);
+    glUniform1i(hasTextureLoc, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glUniform3f(offsetLoc, 0.0f, 0.0f, 0.0f);
+
+    m_profiler.begin(PROFILE_WIREFRAME);
+    for (const auto& model : m_models) {
+        const CRenderTable& table = model.table;
+        const auto& meshes = model.figure->getSubMeshes();
+        CRenderTable::forEachSet(table.getWireframeBits(), [&](int i) {
+            if (table.getVertexCount(i) <= 0) return;
+            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+            
+            glm::mat4 mvp = viewProjection * m_scene.getWorld(model.firstSubMeshNode + i);
+            glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, glm::value_ptr(mvp));
+            glUniform1i(meshIdLoc, i);
+            
+            vec3 wireColor = vec3(meshes[i].wireframeColor.r / 255.0f,
+                                  meshes[i].wireframeColor.g / 255.0f,
+                                  meshes[i].wireframeColor.b / 255.0f);
+            glUniform3fv(colorLoc, 1, glm::value_ptr(wireColor));
+            
+            glDrawArrays(GL_TRIANGLES, model.baseVertex + table.getStartVertex(i), table.getVertexCount(i));
+            
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        });
     }
 
-    if (m_showBBox && m_bboxVAO != 0 && selectedSubMeshIndex != -1 && selectedSubMeshIndex < m_currentModel->getSubMeshes().size()) {
+    m_profiler.end(PROFILE_WIREFRAME);
+
+    m_profiler.begin(PROFILE_VERTICES);
+    glEnable(GL_PROGRAM_POINT_SIZE); 
+    
+    for (const auto& model : m_models) {
+        const CRenderTable& table = model.table;
+        const auto& meshes = model.figure->getSubMeshes();
+        CRenderTable::forEachSet(table.getVertexBits(), [&](int i) {
+            if (table.getVertexCount(i) <= 0) return;
+            glPointSize(meshes[i].vertexSize);
+            
+            glm::mat4 mvp = viewProjection * m_scene.getWorld(model.firstSubMeshNode + i);
+            glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, glm::value_ptr(mvp));
+            glUniform1i(meshIdLoc, i);
+            
+            vec3 vColor = vec3(meshes[i].vertexColor.r / 255.0f,
+                               meshes[i].vertexColor.g / 255.0f,
+                               meshes[i].vertexColor.b / 255.0f);
+            glUniform3fv(colorLoc, 1, glm::value_ptr(vColor));
+            
+            glDrawArrays(GL_POINTS, model.baseVertex + table.getStartVertex(i), table.getVertexCount(i));
+        });
+    }
+    glDisable(GL_PROGRAM_POINT_SIZE);
+    glBindVertexArray(0);
+    m_profiler.end(PROFILE_VERTICES);
+
+    m_profiler.begin(PROFILE_NORMALS);
+    for (const auto& model : m_models) {
+        const CRenderTable& table = model.table;
+        const auto& meshes = model.figure->getSubMeshes();
+        CRenderTable::forEachSet(table.getNormalBits(), [&](int i) {
+            if (table.getVertexCount(i) <= 0) return;
+            glm::mat4 mvp = viewProjection * m_scene.getWorld(model.firstSubMeshNode + i);
+            glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, glm::value_ptr(mvp));
+            renderNormals(model, meshes[i]);
+        });
+    }
+    m_profiler.end(PROFILE_NORMALS);
+
+    if (m_showBBox && m_bboxVAO != 0 && m_currentModel && selectedSubMeshIndex != -1 && selectedSubMeshIndex < (int)m_currentModel->getSubMeshes().size()) {
+        CProfileScope scope(m_profiler, PROFILE_BBOX);
         const SubMesh& sm = m_currentModel->getSubMeshes()[selectedSubMeshIndex];
         
         setupBoundingBox(sm.bbox);
 
-        GLuint offsetLoc = glGetUniformLocation(m_shaderProgram, "u_elementOffset");
-        GLuint colorLoc = glGetUniformLocation(m_shaderProgram, "u_elementColor");
+        glm::mat4 mvp = viewProjection * m_scene.getWorld(m_models[m_activeModel].node);
+        glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, glm::value_ptr(mvp));
 
-        glUniform1i(glGetUniformLocation(m_shaderProgram, "u_currentMeshID"), -1);
+        glUniform1i(meshIdLoc, -1);
         glUniform3fv(offsetLoc, 1, glm::value_ptr(sm.offset));
         
         vec3 bColor = vec3(bbColor.r / 255.0f, bbColor.g / 255.0f, bbColor.b / 255.0f);
@@ -495,7 +1017,21 @@ void C3DViewer::render() {
     }
 
     glViewport(0, 0, width, height);
-    drawInterface();
+    if (!m_headlessMode) {
+        CProfileScope interfaceScope(m_profiler, PROFILE_INTERFACE);
+        CAllocationScope interfaceAllocations(ALLOC_INTERFACE);
+        drawInterface();
+    }
+    m_renderStats.endFrame();
+
+    CAllocationTracker::setFrameGuard(false);
+    AllocationCounters allocationsAfter;
+    CAllocationTracker::snapshot(allocationsAfter);
+    m_frameAllocations = allocationsAfter - allocationsBefore;
+    if (m_frameAllocations.violations > 0) {
+        LOG_WARNING(LOG_RENDER, "%llu asignaciones de memoria en un frame estable.", (unsigned long long)m_frameAllocations.violations);
+    }
+    if (m_steadyFrames < 3) m_steadyFrames++;
 }
 
 void C3DViewer::drawInterface()
@@ -560,11 +1096,109 @@ void C3DViewer::drawInterface()
     ImGui::Separator();
     ImGui::Text("Visualizacion");
     ImGui::Checkbox("Mostrar FPS (5s avg)", &m_showFPS);
+    ImGui::Checkbox("Render continuo", &m_continuousRender);
+#ifdef VIEWER_TRACING
+    if (ImGui::Button("Exportar traza")) m_requestTrace = true;
+    ImGui::SameLine();
+    ImGui::Checkbox("Al salir", &m_traceOnExit);
+#endif
     if (m_showFPS) {
         ImGui::Text("FPS: %.2f", m_fps);
     }
+
+    if (ImGui::CollapsingHeader("Estadisticas de render")) {
+        const RenderCounters& stats = m_renderStats.getLastFrame();
+        ImGui::Text("Draw calls: %llu", (unsigned long long)stats.drawCalls);
+        ImGui::Text("Triangulos: %llu  Lineas: %llu  Puntos: %llu", (unsigned long long)stats.triangles,
+                    (unsigned long long)stats.lines, (unsigned long long)stats.points);
+        ImGui::Text("Cambios de estado: %llu  Uniforms: %llu", (unsigned long long)stats.stateChanges, (unsigned long long)stats.uniformUploads);
+        ImGui::Text("Bytes subidos: %.1f KB", stats.bufferBytes / 1024.0);
+        ImGui::Text("Sub-mallas dibujadas: %llu  descartadas: %llu", (unsigned long long)stats.drawnSubMeshes,
+                    (unsigned long long)stats.culledSubMeshes);
+
+        bool output = m_renderStats.isOutputEnabled();
+        if (ImGui::Checkbox("Escribir metricas", &output)) m_renderStats.setOutput(output);
+        int format = (int)m_renderStats.getFormat();
+        if (ImGui::Combo("Formato", &format, "CSV\0Prometheus\0")) m_renderStats.setFormat((MetricsFormat)format);
+        if (ImGui::InputText("Archivo", m_metricsPath, sizeof(m_metricsPath))) m_renderStats.setOutputPath(m_metricsPath);
+        if (ImGui::SliderInt("Intervalo (s)", &m_metricsPeriod, 1, 300)) m_renderStats.setPeriod(m_metricsPeriod);
+    }
+
+    if (ImGui::CollapsingHeader("Profiler")) {
+        bool profiling = m_profiler.isEnabled();
+        if (ImGui::Checkbox("Medir pasadas", &profiling)) m_profiler.setEnabled(profiling);
+
+        for (int s = 0; s < m_profiler.getSectionCount(); ++s) {
+            ImGui::PushID(s);
+            for (bool gpu : { false, true }) {
+                if (gpu && !m_profiler.hasGpu(s)) continue;
+                int count = 0, offset = 0;
+                const float* samples = m_profiler.getSamples(s, gpu, count, offset);
+                if (count == 0) continue;
+
+                ImGui::Text("%s %s: %.2f ms (p50 %.2f  p95 %.2f  p99 %.2f)", m_profiler.getName(s).c_str(), gpu ? "GPU" : "CPU",
+                            m_profiler.getLast(s, gpu), m_profiler.getPercentile(s, gpu, 50.0f),
+                            m_profiler.getPercentile(s, gpu, 95.0f), m_profiler.getPercentile(s, gpu, 99.0f));
+                ImGui::PlotLines(gpu ? "##gpu" : "##cpu", samples, count, offset, nullptr, 0.0f, FLT_MAX, ImVec2(panelWidth - 20.0f, 30.0f));
+            }
+            ImGui::PopID();
+        }
+
+        ImGui::Separator();
+        if (CAllocationTracker::isEnabled()) {
+            ImGui::Text("Asignaciones por frame: %llu (%.1f KB)", (unsigned long long)m_frameAllocations.totalCount(),
+                        m_frameAllocations.totalBytes() / 1024.0);
+            for (int tag = 0; tag < ALLOC_TAG_COUNT; ++tag) {
+                if (m_frameAllocations.count[tag] == 0) continue;
+                ImGui::BulletText("%s: %llu (%.1f KB)", CAllocationTracker::getTagName(tag),
+                                  (unsigned long long)m_frameAllocations.count[tag], m_frameAllocations.bytes[tag] / 1024.0);
+            }
+            if (ImGui::Checkbox("Frame sin asignaciones (estricto)", &m_strictAllocations)) {
+                CAllocationTracker::setStrict(m_strictAllocations);
+            }
+        } else {
+            ImGui::TextDisabled("Seguimiento de asignaciones desactivado");
+        }
+    }
     
     ImGui::Checkbox("Mostrar Bounding Box (B)", &m_showBBox);
+
+    if (ImGui::Checkbox("Agrupar por material", &m_batchByMaterial)) {
+        rebuildScene();
+    }
+    if (m_batchByMaterial && m_currentModel) {
+        ImGui::Text("Lotes de material: %d", (int)m_currentModel->getMaterialBatches().size());
+    }
+    if (m_activeModel >= 0 && m_models[m_activeModel].cloud) {
+        const CPointOctree& cloud = *m_models[m_activeModel].cloud;
+        if (cloud.isBuilding()) {
+            ImGui::ProgressBar(cloud.getBuildProgress(), ImVec2(-1.0f, 0.0f), "Construyendo octree...");
+        } else if (cloud.isReady()) {
+            ImGui::Text("Nube de puntos: %zu puntos, %d nodos", cloud.getTotalPoints(), cloud.getNodeCount());
+        }
+        ImGui::Text("Dibujados: %zu (%d nodos)", cloud.getRenderedPoints(), cloud.getRenderedNodes());
+        ImGui::Text("Residentes en GPU: %zu", cloud.getResidentPoints());
+        ImGui::SliderInt("Presupuesto (M pts)", &m_pointBudgetMillions, 1, 50);
+        ImGui::SliderFloat("Error en pantalla (px)", &m_pointErrorPixels, 0.5f, 10.0f);
+        ImGui::SliderFloat("Tamano de punto", &m_pointSize, 1.0f, 10.0f);
+    }
+    ImGui::Checkbox("Liberar geometria de CPU tras subir", &m_leanResidency);
+    size_t cpuBytes = 0;
+    for (const auto& model : m_models) cpuBytes += model.figure->getCpuBytes();
+    ImGui::Text("Geometria residente: RAM %.1f MB, GPU %.1f MB", cpuBytes / (1024.0 * 1024.0),
+                m_geometryPool.getCapacityBytes() / (1024.0 * 1024.0));
+    ImGui::Checkbox("Fuera de nucleo (paginar geometria)", &m_outOfCore);
+    if (m_outOfCore || m_chunkCache.getResidentChunks() > 0) {
+        ImGui::SliderInt("Memoria de geometria (MB)", &m_geometryBudgetMB, 128, 16384);
+        ImGui::Text("Geometria en GPU: %.1f MB, %d bloques (%d dibujados)",
+                    m_chunkCache.getResidentBytes() / (1024.0 * 1024.0),
+                    m_chunkCache.getResidentChunks(), m_chunkCache.getDrawnChunks());
+    }
+    if (m_textureCache.getTextureCount() > 0) {
+        ImGui::Text("Texturas: %d / %d", m_textureCache.getReadyCount(), m_textureCache.getTextureCount());
+        ImGui::Text("VRAM texturas: %.1f MB%s", m_textureCache.getResidentBytes() / (1024.0 * 1024.0),
+                    m_textureCache.isUsingCompression() ? " (BC)" : "");
+    }
     
     float bBoxColor[3] = { bbColor.r / 255.0f, bbColor.g / 255.0f, bbColor.b / 255.0f };
     if (ImGui::ColorEdit3("Color BB", bBoxColor)) {
@@ -578,20 +1212,21 @@ void C3DViewer::drawInterface()
         ImGui::Text("Sub-Malla Seleccionada");
         
         vector<SubMesh>& meshes = m_currentModel->getSubMeshesModifiable();
-        if (selectedSubMeshIndex < meshes.size()) {
+        if (selectedSubMeshIndex >= 0 && selectedSubMeshIndex < (int)meshes.size()) {
             SubMesh& mesh = meshes[selectedSubMeshIndex];
             ImGui::Text("ID: %d - %s", selectedSubMeshIndex, mesh.groupName.c_str());
+            if (mesh.instanceOf >= 0) {
+                ImGui::Text("Instancia de la sub-malla %d", mesh.instanceOf);
+            }
             
             ImGui::Checkbox("Mostrar Relleno", &mesh.showFaces);
 
-            float kColor[3] = { mesh.material.kd[0], mesh.material.kd[1], mesh.material.kd[2] };
-            if (ImGui::ColorEdit3("Color SM", kColor)) {
-                 mesh.material.kd[0] = kColor[0];
-                 mesh.material.kd[1] = kColor[1];
-                 mesh.material.kd[2] = kColor[2];
-            }
+            ImGui::ColorEdit3("Color SM", glm::value_ptr(mesh.color));
 
-            ImGui::DragFloat3("Traslacion SM", glm::value_ptr(mesh.offset), 0.01f);
+            if (ImGui::DragFloat3("Traslacion SM", glm::value_ptr(mesh.offset), 0.01f)) {
+                int node = m_models[m_activeModel].firstSubMeshNode + selectedSubMeshIndex;
+                m_scene.setPosition(node, mesh.offset + mesh.instanceTranslation);
+            }
             
             ImGui::Checkbox("Mostrar Vertices", &mesh.showVertices);
             if (mesh.showVertices) {
@@ -626,10 +1261,11 @@ void C3DViewer::drawInterface()
                  }
                  ImGui::SliderFloat("Longitud Normal (%)", &mesh.normalLengthPercent, 0.01f, 0.5f);
             }
+            m_models[m_activeModel].table.update(meshes, selectedSubMeshIndex);
 
             if (ImGui::Button("Eliminar Sub-malla")) {
                 m_currentModel->deleteSubMesh(selectedSubMeshIndex);
-                setupModel(m_currentModel);
+                rebuildScene();
                 selectedSubMeshIndex = -1;
                 m_showBBox = false;
             }
@@ -638,7 +1274,20 @@ void C3DViewer::drawInterface()
 
     ImGui::Separator();
     ImGui::Text("Guardar Modelo OBJ/MTL");
-    if (ImGui::Button("Guardar OBJ")) {
+    bool paged = m_activeModel >= 0 && m_models[m_activeModel].chunks;
+    if (paged) {
+        ImGui::TextWrapped("Modelo paginado: se exporta solo como OBJ, por bloques y sin normales.");
+    } else {
+        ImGui::Checkbox("Exportar normales y UVs", &m_exportFullFidelity);
+    }
+    if (m_saveProgress) {
+        int total = m_saveProgress->total;
+        float fraction = total > 0 ? (float)m_saveProgress->completed / total : 0.0f;
+        ImGui::ProgressBar(fraction, ImVec2(-1.0f, 0.0f), "Guardando...");
+        if (ImGui::Button("Cancelar guardado")) {
+            m_saveProgress->cancel = true;
+        }
+    } else if (ImGui::Button("Guardar OBJ")) {
         m_requestSave = true;
     }
 
@@ -653,6 +1302,29 @@ void C3DViewer::drawInterface()
     if (ImGui::Button("Cargar OBJ")) {
         m_requestLoad = true;
     }
+    ImGui::SameLine();
+    if (ImGui::Button("Agregar OBJ")) {
+        m_requestAdd = true;
+    }
+
+    if (!m_models.empty()) {
+        ImGui::Separator();
+        ImGui::Text("Modelos en escena: %d", (int)m_models.size());
+        for (int i = 0; i < (int)m_models.size(); ++i) {
+            ImGui::PushID(i);
+            if (ImGui::Selectable("##modelo", i == m_activeModel, 0, ImVec2(0.0f, 0.0f))) {
+                setActiveModel(i);
+                selectedSubMeshIndex = -1;
+                m_showBBox = false;
+            }
+            ImGui::SameLine();
+            ImGui::Text("Modelo %d (%d sub-mallas)", i, (int)m_models[i].figure->getSubMeshes().size());
+            ImGui::PopID();
+        }
+        if (m_models.size() > 1 && ImGui::Button("Quitar modelo activo")) {
+            removeModel(m_activeModel);
+        }
+    }
     
     ImGui::End();
 
@@ -724,27 +1396,535 @@ bool C3DViewer::checkCompileErrors(GLuint shader, const char* type)
 
 void C3DViewer::setupModel(C3DFigure* obj)
 {
-    m_currentModel = obj;
-    vector<float> vertices = obj->flatten();
-    
-    m_vertexCount = static_cast<int>(vertices.size() / 6);
+    TRACE_ZONE("setupModel");
+    clearModels();
+    addModel(obj, false);
+}
+
+bool C3DViewer::loadFigure(C3DFigure* figure, const string& path, shared_ptr<CChunkStore>& chunks)
+{
+    CAllocationScope scope(ALLOC_IO);
+    chunks.reset();
+    if (m_outOfCore) {
+        chunks = make_shared<CChunkStore>();
+        if (chunks->open(path, *figure)) return true;
+    }
+
+    if (!figure->loadObject(path)) return false;
+    figure->normalization();
+
+    if (chunks && !chunks->build(path, *figure)) chunks.reset();
+    return true;
+}
+
+int C3DViewer::addModel(C3DFigure* obj, bool owned, shared_ptr<CChunkStore> chunks)
+{
+    CAllocationScope scope(ALLOC_GEOMETRY);
+    for (auto& material : obj->getMaterialsModifiable()) {
+        if (!material.texturePath.empty()) {
+            material.textureSlot = m_textureCache.request(material.texturePath);
+        }
+    }
+
+    SceneModel model;
+    model.figure = obj;
+    model.owned = owned;
+    model.chunks = chunks;
+    if (chunks ? chunks->isPointCloud() : obj->isPointCloud()) {
+        std::error_code error;
+        std::filesystem::create_directories("pointcache", error);
+        shared_ptr<CPointOctree> cloud = make_shared<CPointOctree>();
+        string cloudPath = "pointcache/cloud_" + to_string(m_cloudCounter++) + ".pco";
+        if (!m_workers) m_workers.reset(new CThreadPool());
+        if (chunks) {
+            m_workers->enqueue([cloud, chunks, cloudPath]() {
+                TRACE_ZONE("Octree");
+                cloud->build(*chunks, vec3(0.85f), cloudPath);
+            });
+        } else {
+            shared_ptr<C3DFigure> snapshot = make_shared<C3DFigure>(*obj);
+            m_workers->enqueue([cloud, snapshot, cloudPath]() {
+                TRACE_ZONE("Octree");
+                cloud->build(snapshot->getVertices(), snapshot->getVertexColors(), vec3(0.85f), cloudPath);
+            });
+        }
+        model.cloud = cloud;
+    }
+    if (!m_models.empty()) {
+        model.position = glm::vec3(1.2f * (float)m_models.size(), 0.0f, 0.0f);
+    }
+    m_models.push_back(model);
+
+    int index = (int)m_models.size() - 1;
+    rebuildScene();
+    setActiveModel(index);
+    return index;
+}
+
+void C3DViewer::removeModel(int index)
+{
+    if (index < 0 || index >= (int)m_models.size()) return;
+
+    std::error_code error;
+    if (!m_models[index].figure->getGeometryCachePath().empty()) {
+        std::filesystem::remove(m_models[index].figure->getGeometryCachePath(), error);
+    }
+    releaseTextures(m_models[index].figure);
+    releaseCloud(m_models[index]);
+    if (m_models[index].owned) delete m_models[index].figure;
+    if (m_models[index].chunks) m_chunkCache.releaseStore(m_models[index].chunks->getId());
+    m_models.erase(m_models.begin() + index);
+
+    m_activeModel = -1;
+    m_currentModel = nullptr;
+    selectedSubMeshIndex = -1;
+    m_showBBox = false;
+
+    rebuildScene();
+    if (!m_models.empty()) {
+        setActiveModel(std::min(index, (int)m_models.size() - 1));
+    }
+}
 
+void C3DViewer::releaseTextures(C3DFigure* figure)
+{
+    for (auto& material : figure->getMaterialsModifiable()) {
+        m_textureCache.releaseSlot(material.textureSlot);
+        material.textureSlot = -1;
+    }
+}
+
+void C3DViewer::releaseCloud(SceneModel& model)
+{
+    if (!model.cloud) return;
+    model.cloud->cancel();
+    model.cloud->releaseGpu();
+    model.cloud.reset();
+}
+
+void C3DViewer::clearModels()
+{
+    for (auto& model : m_models) {
+        std::error_code error;
+        if (!model.figure->getGeometryCachePath().empty()) {
+            std::filesystem::remove(model.figure->getGeometryCachePath(), error);
+        }
+        releaseTextures(model.figure);
+        releaseCloud(model);
+        if (model.owned) delete model.figure;
+        if (model.chunks) m_chunkCache.releaseStore(model.chunks->getId());
+    }
+    m_models.clear();
+    m_scene.clear();
+    m_geometryPool.clear();
+    m_activeModel = -1;
+    m_currentModel = nullptr;
+    selectedSubMeshIndex = -1;
+    m_showBBox = false;
+}
+
+void C3DViewer::setActiveModel(int index)
+{
+    if (index == m_activeModel || index < 0 || index >= (int)m_models.size()) return;
+
+    syncSceneTransforms();
+
+    m_activeModel = index;
+    SceneModel& model = m_models[index];
+    m_currentModel = model.figure;
+    m_modelPos = model.position;
+    m_rotation = model.rotation;
+    m_userScale = model.scale / scale_factor;
+
+    setupBoundingBox(m_currentModel->getBoundingBox());
+}
+
+void C3DViewer::syncSceneTransforms()
+{
+    if (m_activeModel >= 0) {
+        SceneModel& active = m_models[m_activeModel];
+        active.position = m_modelPos;
+        active.rotation = m_rotation;
+        active.scale = m_userScale * scale_factor;
+    }
+
+    for (const auto& model : m_models) {
+        m_scene.setLocal(model.node, model.position, model.rotation, model.scale);
+    }
+}
+
+void C3DViewer::renderPointClouds(const glm::mat4& viewProjection)
+{
+    GLuint mvpLoc = glGetUniformLocation(m_shaderProgram, "u_mvp");
+    float pixelsPerUnit = (float)height / (2.0f * tan(glm::radians(45.0f) * 0.5f));
+    size_t budget = (size_t)m_pointBudgetMillions * 1000000;
+    bool any = false;
+
+    for (const auto& model : m_models) {
+        if (!model.cloud) continue;
+        if (!any) {
+            glUniform1i(glGetUniformLocation(m_shaderProgram, "u_vertexColors"), 1);
+            glUniform3f(glGetUniformLocation(m_shaderProgram, "u_elementColor"), 1.0f, 1.0f, 1.0f);
+            glUniform1i(glGetUniformLocation(m_shaderProgram, "u_instanced"), 0);
+            glUniform1i(glGetUniformLocation(m_shaderProgram, "u_hasTexture"), 0);
+            glUniform1i(glGetUniformLocation(m_shaderProgram, "u_currentMeshID"), -1);
+            glUniform3f(glGetUniformLocation(m_shaderProgram, "u_elementOffset"), 0.0f, 0.0f, 0.0f);
+            glPointSize(m_pointSize);
+            any = true;
+        }
+
+        const glm::mat4& world = m_scene.getWorld(model.node);
+        glm::mat4 mvp = viewProjection * world;
+        glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, glm::value_ptr(mvp));
+
+        glm::vec3 camera = glm::vec3(glm::inverse(world) * glm::vec4(m_camPos, 1.0f));
+        model.cloud->setBudgets(budget, budget * 2);
+        model.cloud->render(mvp, camera, pixelsPerUnit, m_pointErrorPixels);
+    }
+    if (any) glPointSize(1.0f);
+}
+
+static bool chunkVisible(const glm::vec4 planes[6], glm::vec3 min, glm::vec3 max) {
+    for (int p = 0; p < 6; ++p) {
+        glm::vec3 positive(planes[p].x >= 0.0f ? max.x : min.x,
+                           planes[p].y >= 0.0f ? max.y : min.y,
+                           planes[p].z >= 0.0f ? max.z : min.z);
+        if (glm::dot(glm::vec3(planes[p]), positive) + planes[p].w < 0.0f) return false;
+    }
+    return true;
+}
+
+void C3DViewer::drawChunkedModel(const SceneModel& model, const glm::mat4& viewProjection, bool picking, int pickBase)
+{
+    const CChunkStore& store = *model.chunks;
+    const CRenderTable& table = model.table;
+    const auto& meshes = model.figure->getSubMeshes();
+    const auto& materials = model.figure->getMaterials();
+    float pixelsPerUnit = (float)height / (2.0f * tan(glm::radians(45.0f) * 0.5f));
+
+    m_chunkQueue.clear();
+    for (int i = 0; i < table.size(); ++i) {
+        if (!picking && !table.showsFaces(i) && !table.showsWireframe(i)) continue;
+        const SubMesh& mesh = meshes[i];
+
+        const glm::mat4& world = m_scene.getWorld(model.firstSubMeshNode + i);
+        glm::mat4 m = glm::transpose(viewProjection * world);
+        glm::vec4 planes[6] = { m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[3] + m[2], m[3] - m[2] };
+        glm::vec3 camera = glm::vec3(glm::inverse(world) * glm::vec4(m_camPos, 1.0f));
+
+        bool visible = false;
+        for (int c = mesh.firstChunk; c < mesh.firstChunk + mesh.chunkCount; ++c) {
+            const ChunkRecord& chunk = store.getChunk(c);
+            if (!chunkVisible(planes, chunk.min, chunk.max)) continue;
+            visible = true;
+
+            glm::vec3 center = (chunk.min + chunk.max) * 0.5f;
+            float radius = glm::length(chunk.max - center);
+            float distance = glm::length(center - camera);
+            float size = distance <= radius ? 1e30f : radius / distance * pixelsPerUnit;
+            m_chunkQueue.push_back(make_pair(size, make_pair(i, c)));
+        }
+        if (!picking && mesh.chunkCount > 0) m_renderStats.subMesh(visible);
+    }
+    std::sort(m_chunkQueue.begin(), m_chunkQueue.end(), [](const pair<float, pair<int, int>>& a, const pair<float, pair<int, int>>& b) {
+        return a.first > b.first;
+    });
+
+    GLint mvpLoc = glGetUniformLocation(m_shaderProgram, "u_mvp");
+    GLint meshIdLoc = glGetUniformLocation(m_shaderProgram, "u_currentMeshID");
+    GLint colorLoc = glGetUniformLocation(m_shaderProgram, "u_elementColor");
+    GLint pickColorLoc = glGetUniformLocation(m_shaderProgram, "u_pickingColor");
+    GLint hasTextureLoc = glGetUniformLocation(m_shaderProgram, "u_hasTexture");
+    GLint vertexColorsLoc = glGetUniformLocation(m_shaderProgram, "u_vertexColors");
+    glUniform3f(glGetUniformLocation(m_shaderProgram, "u_elementOffset"), 0.0f, 0.0f, 0.0f);
+    glUniform1i(glGetUniformLocation(m_shaderProgram, "u_instanced"), 0);
+    if (!picking) glUniform1i(vertexColorsLoc, store.hasVertexColors());
+
+    for (const auto& item : m_chunkQueue) {
+        int i = item.second.first;
+        int c = item.second.second;
+        GLuint vao = m_chunkCache.acquire(store, c, !picking);
+        if (!vao) continue;
+
+        glm::mat4 mvp = viewProjection * m_scene.getWorld(model.firstSubMeshNode + i);
+        glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, glm::value_ptr(mvp));
+        glUniform1i(meshIdLoc, i);
+        glBindVertexArray(vao);
+        GLsizei count = (GLsizei)store.getChunk(c).vertexCount;
+
+        if (picking) {
+            glm::vec3 pickColor = indexToColor(pickBase + i);
+            glUniform3fv(pickColorLoc, 1, glm::value_ptr(pickColor));
+            glDrawArrays(GL_TRIANGLES, 0, count);
+            continue;
+        }
+
+        if (table.showsFaces(i)) {
+            bindMaterialTexture(materials[table.getMaterial(i)], hasTextureLoc);
+            glUniform3fv(colorLoc, 1, glm::value_ptr(table.getColor(i)));
+            glDrawArrays(GL_TRIANGLES, 0, count);
+        }
+        if (table.showsWireframe(i)) {
+            const SubMesh& mesh = meshes[i];
+            vec3 wireColor = vec3(mesh.wireframeColor.r / 255.0f,
+                                  mesh.wireframeColor.g / 255.0f,
+                                  mesh.wireframeColor.b / 255.0f);
+            glUniform1i(hasTextureLoc, 0);
+            glUniform1i(vertexColorsLoc, 0);
+            glUniform3fv(colorLoc, 1, glm::value_ptr(wireColor));
+            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+            glDrawArrays(GL_TRIANGLES, 0, count);
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            glUniform1i(vertexColorsLoc, store.hasVertexColors());
+        }
+    }
+    glBindVertexArray(0);
+}
+
+void C3DViewer::startSave(const string& path)
+{
+    if (!m_currentModel || m_saveProgress) return;
+    CAllocationScope scope(ALLOC_IO);
+    shared_ptr<CChunkStore> chunks = m_models[m_activeModel].chunks;
+    if (chunks && hasExtension(path, ".glb")) {
+        LOG_WARNING(LOG_IO, "Los modelos paginados solo se exportan como OBJ: %s", path.c_str());
+        return;
+    }
+
+    shared_ptr<C3DFigure> snapshot = make_shared<C3DFigure>(*m_currentModel);
+    shared_ptr<SaveProgress> progress = make_shared<SaveProgress>();
+    glm::vec3 position = m_modelPos;
+    glm::quat rotation = m_rotation;
+    glm::vec3 scale = m_userScale * scale_factor;
+    bool fullFidelity = m_exportFullFidelity;
+
+    m_saveProgress = progress;
+    m_saveThread = std::thread([snapshot, chunks, progress, path, position, rotation, scale, fullFidelity]() {
+        TRACE_THREAD_NAME("Guardado");
+        CAllocationScope scope(ALLOC_IO);
+        if (chunks) {
+            progress->success = chunks->saveObject(path, *snapshot, position, rotation, scale, progress.get());
+        } else if (!snapshot->ensureGeometry()) {
+            LOG_ERROR(LOG_GEOMETRY, "Error: No se pudo recuperar la geometria del modelo para guardarlo.");
+        } else if (hasExtension(path, ".glb")) {
+            progress->success = snapshot->saveGlb(path, position, rotation, scale, progress.get());
+        } else {
+            progress->success = snapshot->saveObject(path, position, rotation, scale, fullFidelity, progress.get());
+        }
+        progress->finished = true;
+    });
+}
+
+void C3DViewer::finishSave(bool cancel)
+{
+    if (!m_saveProgress) return;
+    if (cancel) m_saveProgress->cancel = true;
+    if (m_saveThread.joinable()) m_saveThread.join();
+    m_saveProgress.reset();
+    requestRedraw();
+}
+
+void C3DViewer::rebuildScene()
+{
+    CAllocationScope scope(ALLOC_GEOMETRY);
+    m_steadyFrames = 0;
+    GLuint previousBuffer = m_geometryPool.getBuffer();
+    m_geometryPool.clear();
+    m_scene.clear();
+
+    size_t nodeCount = 0;
+    for (const auto& model : m_models) {
+        nodeCount += 1 + model.figure->getSubMeshes().size();
+    }
+    m_scene.reserve(nodeCount);
+
+    for (auto& model : m_models) {
+        model.figure->ensureGeometry();
+        model.vertexColors = model.figure->hasVertexColors();
+        model.baseVertex = m_geometryPool.append(model.figure->flatten(m_batchByMaterial));
+        model.node = m_scene.addNode(-1, model.position, model.rotation, model.scale);
+
+        const auto& meshes = model.figure->getSubMeshes();
+        model.firstSubMeshNode = m_scene.size();
+        for (const auto& mesh : meshes) {
+            m_scene.addNode(model.node, mesh.offset + mesh.instanceTranslation);
+        }
+
+        model.table.build(meshes);
+        setupInstanceGroups(model);
+    }
+
+    m_vertexCount = m_geometryPool.getVertexCount();
+    if (m_geometryPool.getBuffer() != previousBuffer) setupVertexLayout();
+
+    if (m_currentModel) setupBoundingBox(m_currentModel->getBoundingBox());
+    updateResidency();
+    requestRedraw();
+}
+
+void C3DViewer::updateResidency()
+{
+    CAllocationScope scope(ALLOC_GEOMETRY);
+    for (auto& model : m_models) {
+        if (model.chunks) continue;
+        C3DFigure* figure = model.figure;
+
+        bool needsCpu = !m_leanResidency;
+        for (uint64_t word : model.table.getNormalBits()) {
+            if (word) needsCpu = true;
+        }
+
+        if (needsCpu) {
+            figure->ensureGeometry();
+        } else if (!figure->isGeometryReleased() && !model.residencyFailed && !m_saveProgress) {
+            std::error_code error;
+            std::filesystem::create_directories("geocache", error);
+            string cachePath = figure->getGeometryCachePath();
+            if (cachePath.empty()) cachePath = "geocache/lean_" + to_string(m_leanCounter++) + ".geo";
+            if (!figure->releaseCpuGeometry(cachePath)) {
+                model.residencyFailed = true;
+                LOG_WARNING(LOG_GEOMETRY, "No se pudo escribir %s; el modelo se mantiene en memoria", cachePath.c_str());
+            }
+        }
+    }
+}
+
+void C3DViewer::setupVertexLayout()
+{
     if (m_vao == 0) glGenVertexArrays(1, &m_vao);
-    if (m_vbo == 0) glGenBuffers(1, &m_vbo);
 
     glBindVertexArray(m_vao);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, m_geometryPool.getBuffer());
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
+    glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(4);
+
+    if (m_instanceVBO == 0) glGenBuffers(1, &m_instanceVBO);
+    glVertexAttribDivisor(2, 1);
+    glVertexAttribDivisor(3, 1);
 
     glBindVertexArray(0);
+}
+
+glm::mat4 C3DViewer::computeViewProjection()
+{
+    float aspect = (float)(width - panelWidth) / (float)height;
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(m_camPos, m_camPos + m_camFront, m_camUp);
+    return projection * view;
+}
 
-    setupBoundingBox(obj->getBoundingBox());
+void C3DViewer::setupInstanceGroups(SceneModel& model)
+{
+    model.instanceGroups = model.figure->getInstanceGroups();
+}
+
+void C3DViewer::drawFacesInstanced(const SceneModel& model, GLint instancedLoc, GLint hasTextureLoc, bool sharedOnly)
+{
+    const CRenderTable& table = model.table;
+    const auto& materials = model.figure->getMaterials();
+    const GLsizei stride = 6 * sizeof(float);
+
+    m_instanceData.clear();
+    for (const auto& group : model.instanceGroups) {
+        if (sharedOnly && !group.shared) continue;
+        for (int id : group.subMeshIds) {
+            if (!table.showsFaces(id) || table.getVertexCount(id) <= 0) continue;
+
+            const vec3& offset = table.getOffset(id);
+            const vec3& color = table.getColor(id);
+            m_instanceData.insert(m_instanceData.end(), { offset.x, offset.y, offset.z, color.x, color.y, color.z });
+            m_renderStats.subMesh(true);
+        }
+    }
+    if (m_instanceData.empty()) return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, m_instanceData.size() * sizeof(float), m_instanceData.data(), GL_STREAM_DRAW);
+    glEnableVertexAttribArray(2);
+    glEnableVertexAttribArray(3);
+    glUniform1i(instancedLoc, 1);
+
+    size_t first = 0;
+    for (const auto& group : model.instanceGroups) {
+        if (sharedOnly && !group.shared) continue;
+        GLsizei count = 0;
+        for (int id : group.subMeshIds) {
+            if (table.showsFaces(id) && table.getVertexCount(id) > 0) count++;
+        }
+        if (count == 0) continue;
+
+        int geometry = group.subMeshIds[0];
+        bindMaterialTexture(materials[table.getMaterial(geometry)], hasTextureLoc);
+
+        size_t byteOffset = first * stride;
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)byteOffset);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (void*)(byteOffset + 3 * sizeof(float)));
+        glDrawArraysInstanced(GL_TRIANGLES, model.baseVertex + table.getStartVertex(geometry), table.getVertexCount(geometry), count);
+        first += count;
+    }
+
+    glUniform1i(instancedLoc, 0);
+    glDisableVertexAttribArray(2);
+    glDisableVertexAttribArray(3);
+}
+
+void C3DViewer::drawMaterialBatches(const SceneModel& model, GLint meshIdLoc, GLint offsetLoc, GLint colorLoc, GLint hasTextureLoc)
+{
+    const CRenderTable& table = model.table;
+    const auto& materials = model.figure->getMaterials();
+    const glm::vec3 zero(0.0f);
+
+    for (const auto& batch : model.figure->getMaterialBatches()) {
+        bindMaterialTexture(materials[batch.material], hasTextureLoc);
+
+        int runStart = -1;
+        int runEnd = -1;
+
+        auto flushRun = [&]() {
+            if (runStart < 0) return;
+            glUniform1i(meshIdLoc, -1);
+            glUniform3fv(offsetLoc, 1, glm::value_ptr(zero));
+            glUniform3fv(colorLoc, 1, glm::value_ptr(batch.color));
+            glDrawArrays(GL_TRIANGLES, model.baseVertex + runStart, runEnd - runStart);
+            runStart = -1;
+        };
+
+        for (int id : batch.subMeshIds) {
+            if (!table.showsFaces(id) || table.getVertexCount(id) <= 0) {
+                flushRun();
+                continue;
+            }
+
+            m_renderStats.subMesh(true);
+            int start = table.getStartVertex(id);
+            int count = table.getVertexCount(id);
+            bool mergeable = table.getOffset(id) == zero && table.getColor(id) == batch.color;
+            if (mergeable) {
+                if (runStart < 0) runStart = start;
+                runEnd = start + count;
+                continue;
+            }
+
+            flushRun();
+            glUniform1i(meshIdLoc, id);
+            glUniform3fv(offsetLoc, 1, glm::value_ptr(table.getOffset(id)));
+            glUniform3fv(colorLoc, 1, glm::value_ptr(table.getColor(id)));
+            glDrawArrays(GL_TRIANGLES, model.baseVertex + start, count);
+        }
+        flushRun();
+    }
+}
+
+void C3DViewer::bindMaterialTexture(const Material& material, GLint hasTextureLoc)
+{
+    GLuint texture = m_textureCache.getTexture(material.textureSlot);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glUniform1i(hasTextureLoc, texture != 0);
 }
 
 void C3DViewer::setupTriangle()
@@ -775,34 +1955,82 @@ void C3DViewer::keyCallbackStatic(GLFWwindow* window, int key, int scancode, int
 {
     ImGui_ImplGlfw_KeyCallback(window, key, scancode, action, mods);
     C3DViewer* self = (C3DViewer*)glfwGetWindowUserPointer(window);
-    if (self) 
+    if (self) {
+        self->requestRedraw();
         self->onKey(key, scancode, action, mods);
+    }
 }
 
 void C3DViewer::mouseButtonCallbackStatic(GLFWwindow* window, int button, int action, int mods) 
 {
     ImGui_ImplGlfw_MouseButtonCallback(window, button, action, mods);
     C3DViewer* self = (C3DViewer*)glfwGetWindowUserPointer(window);
-    if (self)
+    if (self) {
+        self->requestRedraw();
         self->onMouseButton(button, action, mods);
+    }
 }
 
 void C3DViewer::cursorPosCallbackStatic(GLFWwindow* window, double xpos, double ypos) 
 {
     ImGui_ImplGlfw_CursorPosCallback(window, xpos, ypos);
     C3DViewer* self = (C3DViewer*)glfwGetWindowUserPointer(window);
-    if (self) 
+    if (self) {
+        self->requestRedraw();
         self->onCursorPos(xpos, ypos);
+    }
+}
+
+void C3DViewer::scrollCallbackStatic(GLFWwindow* window, double xoffset, double yoffset)
+{
+    ImGui_ImplGlfw_ScrollCallback(window, xoffset, yoffset);
+    C3DViewer* self = (C3DViewer*)glfwGetWindowUserPointer(window);
+    if (self)
+        self->requestRedraw();
+}
+
+void C3DViewer::charCallbackStatic(GLFWwindow* window, unsigned int c)
+{
+    ImGui_ImplGlfw_CharCallback(window, c);
+    C3DViewer* self = (C3DViewer*)glfwGetWindowUserPointer(window);
+    if (self)
+        self->requestRedraw();
+}
+
+void C3DViewer::windowFocusCallbackStatic(GLFWwindow* window, int focused)
+{
+    ImGui_ImplGlfw_WindowFocusCallback(window, focused);
+    C3DViewer* self = (C3DViewer*)glfwGetWindowUserPointer(window);
+    if (self)
+        self->requestRedraw();
+}
+
+void C3DViewer::cursorEnterCallbackStatic(GLFWwindow* window, int entered)
+{
+    ImGui_ImplGlfw_CursorEnterCallback(window, entered);
+    C3DViewer* self = (C3DViewer*)glfwGetWindowUserPointer(window);
+    if (self)
+        self->requestRedraw();
+}
+
+void C3DViewer::windowRefreshCallbackStatic(GLFWwindow* window)
+{
+    C3DViewer* self = (C3DViewer*)glfwGetWindowUserPointer(window);
+    if (self)
+        self->requestRedraw();
 }
 
 glm::vec3 C3DViewer::indexToColor(int index) {
-    float r = (index + 1) / 255.0f; 
-    return glm::vec3(r, 0.0f, 0.0f);
+    int id = index + 1;
+    float r = (id & 0xFF) / 255.0f;
+    float g = ((id >> 8) & 0xFF) / 255.0f;
+    float b = ((id >> 16) & 0xFF) / 255.0f;
+    return glm::vec3(r, g, b);
 }
 
 int C3DViewer::colorToIndex(unsigned char r, unsigned char g, unsigned char b) {
     if (r == 255 && g == 255 && b == 255) return -1;
-    return (int)r - 1;
+    return ((int)r | ((int)g << 8) | ((int)b << 16)) - 1;
 }
 
 void C3DViewer::updateCameraVectors() 
@@ -848,10 +2076,8 @@ void C3DViewer::setupBoundingBox(BoundingBox box) {
     glEnableVertexAttribArray(0);
 }
 
-void C3DViewer::renderNormals(const SubMesh& mesh) {
-    if (!m_currentModel) return;
-
-    BoundingBox globalBBox = m_currentModel->getBoundingBox();
+void C3DViewer::renderNormals(const SceneModel& model, const SubMesh& mesh) {
+    BoundingBox globalBBox = model.figure->getBoundingBox();
     float dx = globalBBox.max.x - globalBBox.min.x;
     float dy = globalBBox.max.y - globalBBox.min.y;
     float dz = globalBBox.max.z - globalBBox.min.z;
@@ -860,21 +2086,22 @@ void C3DViewer::renderNormals(const SubMesh& mesh) {
 
     if (normalLength < 0.0001f) normalLength = 0.05f;
 
-    const vector<vec3>& vertices = m_currentModel->getVertices();
-    const vector<vec3>& normals = m_currentModel->getNormals();
+    const vector<vec3>& vertices = model.figure->getVertices();
+    const vector<vec3>& normals = model.figure->getNormals();
+    
+    vector<float>& lines = m_normalData;
+    lines.clear();
     
-    vector<float> lines;
+    const CFacePool& faces = model.figure->getFaces();
     
-    for (const auto& face : mesh.faces) {
+    for (int f = mesh.firstFace; f < mesh.firstFace + mesh.faceCount; ++f) {
         for (int i = 0; i < 3; ++i) {
-            int vIdx = face.vertexIndices[i];
-            int nIdx = face.normalIndices[i];
+            int vIdx = faces.vertex(f, i);
+            int nIdx = faces.normal(f, i);
 
-            if (vIdx < vertices.size() && nIdx < normals.size()) {
+            if (vIdx >= 0 && vIdx < (int)vertices.size() && nIdx >= 0 && nIdx < (int)normals.size()) {
                 vec3 v = vertices[vIdx];
                 vec3 n = normals[nIdx];
-                
-                v += mesh.offset;
 
                 lines.push_back(v.x);
                 lines.push_back(v.y);
@@ -3,10 +3,23 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <vector>
+#include <thread>
+#include <memory>
 #include "imgui/imgui.h"
 #include "imgui/backends/imgui_impl_glfw.h"
 #include "imgui/backends/imgui_impl_opengl3.h"
 #include "utils/3DFigure.h"
+#include "utils/SceneGraph.h"
+#include "utils/GeometryPool.h"
+#include "utils/TextureCache.h"
+#include "utils/PointOctree.h"
+#include "utils/ChunkStore.h"
+#include "utils/RenderTable.h"
+#include "utils/FrameProfiler.h"
+#include "utils/RenderStats.h"
+#include "utils/AllocationTracker.h"
+#include "utils/HeadlessContext.h"
+#include "utils/ThreadPool.h"
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include "../glm/mat4x4.hpp"
@@ -15,6 +28,57 @@
 #include "../glm/gtc/quaternion.hpp"
 #include "../glm/gtx/quaternion.hpp"
 
+struct SceneModel {
+    C3DFigure* figure = nullptr;
+    bool owned = false;
+    int node = -1;
+    int firstSubMeshNode = -1;
+    int baseVertex = 0;
+    bool vertexColors = false;
+    bool residencyFailed = false;
+
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+
+    CRenderTable table;
+    vector<InstanceGroup> instanceGroups;
+    shared_ptr<CPointOctree> cloud;
+    shared_ptr<CChunkStore> chunks;
+};
+
+struct HeadlessOptions {
+    string modelPath;
+    string outputDirectory = "headless";
+    string goldenDirectory;
+    int width = 1280;
+    int height = 720;
+    int views = 8;
+    int frames = 10;
+    int tolerance = 8;
+};
+
+struct BenchmarkOptions {
+    string modelPath;
+    string outputPath = "benchmark.json";
+    string baselinePath;
+    int width = 1280;
+    int height = 720;
+    int frames = 120;
+    float threshold = 0.2f;
+};
+
+enum ProfileSection {
+    PROFILE_FRAME,
+    PROFILE_FILL,
+    PROFILE_WIREFRAME,
+    PROFILE_VERTICES,
+    PROFILE_NORMALS,
+    PROFILE_BBOX,
+    PROFILE_PICKING,
+    PROFILE_INTERFACE
+};
+
 class C3DViewer 
 {
 
@@ -22,7 +86,12 @@ public:
     C3DViewer();
 
     bool setup();
+    bool setupHeadless(int width, int height);
+    bool runHeadless(const HeadlessOptions& options);
+    bool runBenchmark(const BenchmarkOptions& options);
     void setupModel(C3DFigure* model);
+    bool completeUploads(int minimumFrames, double timeoutSeconds);
+    int addModel(C3DFigure* model, bool owned, shared_ptr<CChunkStore> chunks = nullptr);
 
     void mainLoop();
 
@@ -31,6 +100,28 @@ public:
 private:
 
     C3DFigure* m_currentModel = nullptr;
+    vector<SceneModel> m_models;
+    int m_activeModel = -1;
+    CSceneGraph m_scene;
+    CGeometryPool m_geometryPool = CGeometryPool(8);
+    CTextureCache m_textureCache;
+    CChunkCache m_chunkCache;
+
+    void removeModel(int index);
+    void clearModels();
+    void releaseTextures(C3DFigure* figure);
+    void releaseCloud(SceneModel& model);
+    void setActiveModel(int index);
+    void rebuildScene();
+    void syncSceneTransforms();
+    void renderPointClouds(const glm::mat4& viewProjection);
+    void updateResidency();
+    bool loadFigure(C3DFigure* figure, const string& path, shared_ptr<CChunkStore>& chunks);
+    void drawChunkedModel(const SceneModel& model, const glm::mat4& viewProjection, bool picking, int pickBase);
+    void startSave(const string& path);
+    void finishSave(bool cancel);
+    void setupVertexLayout();
+    glm::mat4 computeViewProjection();
     glm::vec3 indexToColor(int index);
     int colorToIndex(unsigned char r, unsigned char g, unsigned char b);
     int m_vertexCount;
@@ -48,6 +139,22 @@ private:
 
     void resize(int new_width, int new_height);
 
+    void requestRedraw();
+
+    bool isAnimating();
+
+    bool hasPendingUploads();
+
+    bool setupRenderer();
+
+    bool loadHeadlessModel(const string& path);
+
+    float renderTimedFrame();
+
+    void applyDisplayMode(int display);
+
+    void applyCameraPath(int path, float t);
+
     bool setupShader();
 
     bool checkCompileErrors(GLuint shader, const char* type);
@@ -60,8 +167,22 @@ private:
 
     static void cursorPosCallbackStatic(GLFWwindow* window, double xpos, double ypos);
 
+    static void scrollCallbackStatic(GLFWwindow* window, double xoffset, double yoffset);
+
+    static void charCallbackStatic(GLFWwindow* window, unsigned int c);
+
+    static void windowFocusCallbackStatic(GLFWwindow* window, int focused);
+
+    static void cursorEnterCallbackStatic(GLFWwindow* window, int entered);
+
+    static void windowRefreshCallbackStatic(GLFWwindow* window);
+
     void setupBoundingBox(BoundingBox box);
-    void renderNormals(const SubMesh& mesh);
+    void setupInstanceGroups(SceneModel& model);
+    void drawFacesInstanced(const SceneModel& model, GLint instancedLoc, GLint hasTextureLoc, bool sharedOnly);
+    void drawMaterialBatches(const SceneModel& model, GLint meshIdLoc, GLint offsetLoc, GLint colorLoc, GLint hasTextureLoc);
+    void bindMaterialTexture(const Material& material, GLint hasTextureLoc);
+    void renderNormals(const SceneModel& model, const SubMesh& mesh);
 
     void performPicking(int x, int y); 
     void updateCameraVectors();
@@ -72,6 +193,8 @@ protected:
     vector<RGBA> m_buffer;
     RGBA m_background_color = { 84, 84, 84, 255};
     GLFWwindow* m_window = nullptr;
+    CHeadlessContext m_headless;
+    bool m_headlessMode = false;
     GLuint m_vao = 0;
     GLuint m_vbo = 0;
     GLuint m_shaderProgram = 0;
@@ -85,6 +208,15 @@ protected:
     bool m_enableLineSmooth = false;
     
     bool m_showFPS = false;
+    bool m_continuousRender = false;
+    CFrameProfiler m_profiler;
+    CRenderStats m_renderStats;
+    char m_metricsPath[256] = "render_metrics.csv";
+    int m_metricsPeriod = 10;
+    int m_redrawFrames = 3;
+    AllocationCounters m_frameAllocations;
+    int m_steadyFrames = 0;
+    bool m_strictAllocations = false;
     float m_fps = 0.0f;
     float m_timeAccumulator = 0.0f;
     int m_frameCounter = 0;
@@ -92,6 +224,24 @@ protected:
     GLuint m_normalVAO = 0;
     GLuint m_normalVBO = 0;
 
+    GLuint m_instanceVBO = 0;
+    vector<float> m_instanceData;
+    vector<float> m_normalData;
+
+    bool m_batchByMaterial = false;
+
+    int m_pointBudgetMillions = 5;
+    float m_pointErrorPixels = 1.5f;
+    float m_pointSize = 2.0f;
+    int m_cloudCounter = 0;
+
+    bool m_outOfCore = false;
+    int m_geometryBudgetMB = 1024;
+    vector<pair<float, pair<int, int>>> m_chunkQueue;
+
+    bool m_leanResidency = false;
+    int m_leanCounter = 0;
+
     bool mouseButtonsDown[3] = { false, false, false };
     
     glm::vec3 m_modelPos = glm::vec3(0.0f, 0.0f, 0.0f);
@@ -113,7 +263,6 @@ protected:
     float panelWidth = 300.0f;
     char saveFileName[256] = "modelo_exportado";
     char loadFileName[256] = "cube.obj";
-    bool m_ownsModel = false;
 
     bool isDragging = false;
     bool isRotating = false;
@@ -121,41 +270,62 @@ protected:
     int selectedSubMeshIndex = -1;
     
     bool m_requestLoad = false;
+    bool m_requestAdd = false;
     bool m_requestSave = false;
+    bool m_requestTrace = false;
+    bool m_traceOnExit = false;
+    bool m_exportFullFidelity = true;
+    std::thread m_saveThread;
+    unique_ptr<CThreadPool> m_workers;
+    shared_ptr<SaveProgress> m_saveProgress;
     
     const char* vertexShaderSrc = R"glsl(
         #version 330 core
         layout(location = 0) in vec3 aPos;
         layout(location = 1) in vec3 aColor;
+        layout(location = 2) in vec3 aInstanceOffset;
+        layout(location = 3) in vec3 aInstanceColor;
+        layout(location = 4) in vec2 aTexCoord;
         
         uniform mat4 u_mvp;
         uniform vec3 u_elementOffset;
+        uniform vec3 u_elementColor;
+        uniform bool u_instanced;
+        uniform bool u_vertexColors;
 
         out vec3 vColor;
+        out vec2 vTexCoord;
         void main() 
         {
-            gl_Position = u_mvp * vec4(aPos + u_elementOffset, 1.0);
-            vColor = aColor;
+            vec3 offset = u_instanced ? aInstanceOffset : u_elementOffset;
+            gl_Position = u_mvp * vec4(aPos + offset, 1.0);
+            vec3 color = u_instanced ? aInstanceColor : u_elementColor;
+            vColor = u_vertexColors ? aColor * color : color;
+            vTexCoord = aTexCoord;
         }
     )glsl";
 
     const char* fragmentShaderSrc = R"glsl(
         #version 330 core
         in vec3 vColor;
+        in vec2 vTexCoord;
         out vec4 FragColor;
 
         uniform vec3 u_pickingColor; 
         uniform bool u_isPicking;    
         uniform int u_selectedIndex; 
         uniform int u_currentMeshID; 
-        uniform vec3 u_elementColor;
         uniform bool u_suppressHighlight;
+        uniform sampler2D u_texture;
+        uniform bool u_hasTexture;
 
         void main() {
             if (u_isPicking) {
                 FragColor = vec4(u_pickingColor, 1.0);
+            } else if (u_hasTexture) {
+                FragColor = vec4(vColor, 1.0) * texture(u_texture, vTexCoord);
             } else {
-                FragColor = vec4(u_elementColor, 1.0); 
+                FragColor = vec4(vColor, 1.0); 
             }
         }
     )glsl";
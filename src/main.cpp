@@ -1,34 +1,85 @@
 #include "3DViewer.h"
 #include "utils/3DFigure.h"
+#include "utils/Logger.h"
 #include "tinyfiledialogs.h"
-#include <iostream>
 #include <string>
+#include <cstring>
+#include <cstdlib>
 
+#ifdef _WIN32
 #include <objbase.h>
+#endif
 
 using namespace std;
 
-int main() 
+static int runOffscreen(int argc, char** argv)
 {
+    HeadlessOptions options;
+    BenchmarkOptions benchmark;
+    bool benchmarking = false;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(arg, "--headless") && hasValue) options.modelPath = argv[++i];
+        else if (!strcmp(arg, "--benchmark") && hasValue) {
+            benchmark.modelPath = argv[++i];
+            benchmarking = true;
+        }
+        else if (!strcmp(arg, "--out") && hasValue) options.outputDirectory = benchmark.outputPath = argv[++i];
+        else if (!strcmp(arg, "--golden") && hasValue) options.goldenDirectory = argv[++i];
+        else if (!strcmp(arg, "--baseline") && hasValue) benchmark.baselinePath = argv[++i];
+        else if (!strcmp(arg, "--views") && hasValue) options.views = atoi(argv[++i]);
+        else if (!strcmp(arg, "--frames") && hasValue) options.frames = benchmark.frames = atoi(argv[++i]);
+        else if (!strcmp(arg, "--tolerance") && hasValue) options.tolerance = atoi(argv[++i]);
+        else if (!strcmp(arg, "--threshold") && hasValue) benchmark.threshold = (float)atof(argv[++i]);
+        else if (!strcmp(arg, "--size") && hasValue) sscanf(argv[++i], "%dx%d", &options.width, &options.height);
+        else {
+            LOG_ERROR(LOG_GENERAL, "Argumento desconocido: %s", arg);
+            LOG_ERROR(LOG_GENERAL, "Uso: --headless <modelo> [--out dir] [--golden dir] [--views n] [--frames n] [--size WxH] [--tolerance n]");
+            LOG_ERROR(LOG_GENERAL, "     --benchmark <modelo> [--out archivo] [--baseline archivo] [--frames n] [--size WxH] [--threshold x]");
+            return 2;
+        }
+    }
+    benchmark.width = options.width;
+    benchmark.height = options.height;
+    if ((benchmarking ? benchmark.modelPath : options.modelPath).empty() || options.width <= 0 || options.height <= 0) return 2;
+
+    C3DViewer viewer;
+    if (!viewer.setupHeadless(options.width, options.height)) {
+        LOG_ERROR(LOG_GENERAL, "No se pudo crear el contexto sin ventana");
+        return -1;
+    }
+    if (benchmarking) return viewer.runBenchmark(benchmark) ? 0 : 1;
+    return viewer.runHeadless(options) ? 0 : 1;
+}
+
+int main(int argc, char** argv) 
+{
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--headless") || !strcmp(argv[i], "--benchmark")) return runOffscreen(argc, argv);
+    }
+
+#ifdef _WIN32
     HRESULT hr = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
     if (FAILED(hr)) {
-        std::cerr << "Warning: Failed to initialize COM library. File dialogs might fail." << std::endl;
+        LOG_WARNING(LOG_GENERAL, "Failed to initialize COM library. File dialogs might fail.");
     }
+#endif
 
-    const char* filterPatterns[] = { "*.obj" };
+    const char* filterPatterns[] = { "*.obj", "*.glb", "*.ply" };
     
     const char* selectedPath = tinyfd_openFileDialog(
-        "Seleccionar modelo 3D", "", 1, filterPatterns, "Archivos Wavefront OBJ", 0                             
+        "Seleccionar modelo 3D", "", 3, filterPatterns, "Modelos OBJ / GLB / PLY", 0                             
     );
 
     if (!selectedPath) 
     {
-        cout << "Operación cancelada por el usuario." << endl;
+        LOG_INFO(LOG_GENERAL, "Operación cancelada por el usuario.");
         return 0;
     }
 
     string objPath = selectedPath;
-    cout << "Cargando archivo: " << objPath << endl;
+    LOG_INFO(LOG_IO, "Cargando archivo: %s", objPath.c_str());
 
     string mtlPath = objPath.substr(0, objPath.find_last_of(".")) + ".mtl";
     
@@ -36,7 +87,7 @@ int main()
     
     if (!test.setup()) 
     {
-        fprintf(stderr, "Failed to setup C3DViewer\n");
+        LOG_ERROR(LOG_GENERAL, "Failed to setup C3DViewer");
         return -1;
     }
 
@@ -48,6 +99,8 @@ int main()
 
     test.mainLoop();
 
+#ifdef _WIN32
     CoUninitialize();
+#endif
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,363 @@
+#include "../utils/3DFigure.h"
+#include "../utils/ThreadPool.h"
+#include "../utils/TextWriter.h"
+#include "../utils/Logger.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <mutex>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+struct BatchOptions {
+    string inputDirectory;
+    string outputDirectory = "convertidos";
+    string reportPath;
+    string format = "obj";
+    size_t memoryBudget = (size_t)2048 * 1024 * 1024;
+    int threads = 0;
+    bool normalize = false;
+    bool recursive = false;
+};
+
+struct BatchJob {
+    fs::path input;
+    fs::path output;
+    uint64_t inputBytes = 0;
+    uint64_t outputBytes = 0;
+    size_t cpuBytes = 0;
+    size_t vertices = 0;
+    size_t faces = 0;
+    size_t invalidFaces = 0;
+    float loadMs = 0.0f;
+    float normalizeMs = 0.0f;
+    float saveMs = 0.0f;
+    float waitMs = 0.0f;
+    bool ok = false;
+    string error;
+};
+
+class CMemoryBudget {
+    mutex lock;
+    condition_variable released;
+    size_t budget;
+    size_t used = 0;
+    size_t peak = 0;
+
+public:
+    explicit CMemoryBudget(size_t bytes) : budget(bytes) {}
+
+    void acquire(size_t bytes) {
+        unique_lock<mutex> guard(lock);
+        released.wait(guard, [&]() { return used == 0 || used + bytes <= budget; });
+        used += bytes;
+        peak = std::max(peak, used);
+    }
+
+    void adjust(size_t from, size_t to) {
+        lock_guard<mutex> guard(lock);
+        used = used - from + to;
+        peak = std::max(peak, used);
+        if (to < from) released.notify_all();
+    }
+
+    void release(size_t bytes) {
+        lock_guard<mutex> guard(lock);
+        used -= bytes;
+        released.notify_all();
+    }
+
+    size_t getPeak() {
+        lock_guard<mutex> guard(lock);
+        return peak;
+    }
+};
+
+static double steadySeconds()
+{
+    using namespace std::chrono;
+    static const steady_clock::time_point start = steady_clock::now();
+    return duration<double>(steady_clock::now() - start).count();
+}
+
+static string lowerExtension(const fs::path& path)
+{
+    string extension = path.extension().string();
+    for (char& c : extension) c = (char)tolower((unsigned char)c);
+    return extension;
+}
+
+static bool parseOptions(int argc, char** argv, BatchOptions& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(arg, "--out") && hasValue) options.outputDirectory = argv[++i];
+        else if (!strcmp(arg, "--report") && hasValue) options.reportPath = argv[++i];
+        else if (!strcmp(arg, "--threads") && hasValue) options.threads = atoi(argv[++i]);
+        else if (!strcmp(arg, "--memory") && hasValue) options.memoryBudget = (size_t)std::max(1, atoi(argv[++i])) * 1024 * 1024;
+        else if (!strcmp(arg, "--format") && hasValue) options.format = argv[++i];
+        else if (!strcmp(arg, "--normalize")) options.normalize = true;
+        else if (!strcmp(arg, "--recursive")) options.recursive = true;
+        else if (arg[0] != '-' && options.inputDirectory.empty()) options.inputDirectory = arg;
+        else return false;
+    }
+    return !options.inputDirectory.empty() && (options.format == "obj" || options.format == "glb");
+}
+
+static vector<BatchJob> collectJobs(const BatchOptions& options)
+{
+    vector<BatchJob> jobs;
+    fs::path root(options.inputDirectory);
+    auto add = [&](const fs::directory_entry& entry) {
+        if (!entry.is_regular_file()) return;
+        string extension = lowerExtension(entry.path());
+        if (extension != ".obj" && extension != ".glb" && extension != ".ply") return;
+
+        BatchJob job;
+        job.input = entry.path();
+        job.output = fs::path(options.outputDirectory) / fs::relative(entry.path(), root);
+        job.output.replace_extension("." + options.format);
+        std::error_code error;
+        job.inputBytes = entry.file_size(error);
+        jobs.push_back(job);
+    };
+
+    std::error_code error;
+    if (options.recursive) {
+        for (fs::recursive_directory_iterator it(root, error), end; !error && it != end; it.increment(error)) add(*it);
+    } else {
+        for (fs::directory_iterator it(root, error), end; !error && it != end; it.increment(error)) add(*it);
+    }
+    if (error) LOG_ERROR(LOG_IO, "Error recorriendo %s: %s", root.string().c_str(), error.message().c_str());
+
+    std::sort(jobs.begin(), jobs.end(), [](const BatchJob& a, const BatchJob& b) { return a.input < b.input; });
+
+    map<fs::path, vector<size_t>> outputs;
+    for (size_t i = 0; i < jobs.size(); ++i) outputs[jobs[i].output].push_back(i);
+    for (const auto& entry : outputs) {
+        if (entry.second.size() < 2) continue;
+        for (size_t index : entry.second) jobs[index].error = "salida duplicada: " + entry.first.string();
+    }
+    return jobs;
+}
+
+static void validate(const C3DFigure& figure, BatchJob& job)
+{
+    const vector<vec3>& vertices = figure.getVertices();
+    const CFacePool& faces = figure.getFaces();
+    job.vertices = vertices.size();
+    job.faces = faces.size();
+    for (size_t f = 0; f < faces.size(); ++f) {
+        for (int k = 0; k < 3; ++k) {
+            int index = faces.vertex(f, k);
+            if (index < 0 || index >= (int)vertices.size()) {
+                job.invalidFaces++;
+                break;
+            }
+        }
+    }
+    if (vertices.empty()) {
+        job.error = "sin geometria";
+        return;
+    }
+    for (const auto& v : vertices) {
+        if (!std::isfinite(v.x) || !std::isfinite(v.y) || !std::isfinite(v.z)) {
+            job.error = "vertices no finitos";
+            return;
+        }
+    }
+}
+
+static void convert(const BatchOptions& options, BatchJob& job, CMemoryBudget& memory, bool parallelSave)
+{
+    size_t reserved = (size_t)job.inputBytes * 2;
+    double start = steadySeconds();
+    memory.acquire(reserved);
+    job.waitMs = (float)((steadySeconds() - start) * 1000.0);
+
+    C3DFigure figure;
+    figure.setParallelSave(parallelSave);
+    start = steadySeconds();
+    bool loaded = figure.loadObject(job.input.string());
+    job.loadMs = (float)((steadySeconds() - start) * 1000.0);
+
+    if (!loaded) job.error = "error de carga";
+    else validate(figure, job);
+
+    if (job.error.empty()) {
+        job.cpuBytes = figure.getCpuBytes();
+        size_t estimate = job.cpuBytes + (size_t)job.inputBytes;
+        memory.adjust(reserved, estimate);
+        reserved = estimate;
+
+        if (options.normalize) {
+            start = steadySeconds();
+            figure.normalization();
+            job.normalizeMs = (float)((steadySeconds() - start) * 1000.0);
+        }
+
+        std::error_code error;
+        fs::create_directories(job.output.parent_path(), error);
+        string output = job.output.string();
+        start = steadySeconds();
+        bool saved = options.format == "glb"
+            ? figure.saveGlb(output, vec3(0.0f), quat(1.0f, 0.0f, 0.0f, 0.0f), vec3(1.0f))
+            : figure.saveObject(output, vec3(0.0f), quat(1.0f, 0.0f, 0.0f, 0.0f), vec3(1.0f));
+        job.saveMs = (float)((steadySeconds() - start) * 1000.0);
+
+        if (saved) {
+            job.outputBytes = fs::file_size(job.output, error);
+            if (options.format == "obj") {
+                uint64_t mtlBytes = fs::file_size(fs::path(job.output).replace_extension(".mtl"), error);
+                if (!error) job.outputBytes += mtlBytes;
+            }
+        }
+        else job.error = "error de guardado";
+    }
+
+    job.ok = job.error.empty();
+    memory.release(reserved);
+}
+
+static void appendJob(CTextWriter& out, const BatchJob& job)
+{
+    out.append("{\"input\":");
+    out.appendQuoted(job.input.string().c_str());
+    out.append(",\"output\":");
+    out.appendQuoted(job.output.string().c_str());
+    out.append(",\"ok\":");
+    out.append(job.ok ? "true" : "false");
+    out.append(",\"warning\":");
+    out.append(job.ok && job.invalidFaces ? "true" : "false");
+    if (!job.ok) {
+        out.append(",\"error\":");
+        out.appendQuoted(job.error.c_str());
+    }
+    out.append(",\"inputBytes\":");
+    out.appendInt((long long)job.inputBytes);
+    out.append(",\"outputBytes\":");
+    out.appendInt((long long)job.outputBytes);
+    out.append(",\"cpuBytes\":");
+    out.appendInt((long long)job.cpuBytes);
+    out.append(",\"vertices\":");
+    out.appendInt((long long)job.vertices);
+    out.append(",\"faces\":");
+    out.appendInt((long long)job.faces);
+    out.append(",\"invalidFaces\":");
+    out.appendInt((long long)job.invalidFaces);
+    out.append(",\"waitMs\":");
+    out.appendFloat(job.waitMs);
+    out.append(",\"loadMs\":");
+    out.appendFloat(job.loadMs);
+    out.append(",\"normalizeMs\":");
+    out.appendFloat(job.normalizeMs);
+    out.append(",\"saveMs\":");
+    out.appendFloat(job.saveMs);
+    out.append('}');
+}
+
+int main(int argc, char** argv)
+{
+    BatchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        LOG_ERROR(LOG_GENERAL, "Uso: BatchConvert <directorio> [--out dir] [--format obj|glb] [--normalize] [--recursive]");
+        LOG_ERROR(LOG_GENERAL, "                    [--threads n] [--memory MB] [--report archivo.json]");
+        CLogger::shutdown();
+        return 2;
+    }
+
+    vector<BatchJob> jobs = collectJobs(options);
+    if (jobs.empty()) {
+        LOG_ERROR(LOG_IO, "No hay modelos OBJ/GLB/PLY en %s", options.inputDirectory.c_str());
+        CLogger::shutdown();
+        return 1;
+    }
+
+    vector<size_t> order(jobs.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return jobs[a].inputBytes > jobs[b].inputBytes; });
+
+    CMemoryBudget memory(options.memoryBudget);
+    atomic<int> finished(0);
+    double start = steadySeconds();
+    {
+        CThreadPool pool(options.threads);
+        bool parallelSave = pool.getThreadCount() == 1;
+        LOG_INFO(LOG_GENERAL, "Convirtiendo %zu modelos con %d hilos (memoria %zu MB)", jobs.size(), pool.getThreadCount(),
+                 options.memoryBudget / (1024 * 1024));
+        for (size_t index : order) {
+            if (!jobs[index].error.empty()) {
+                LOG_ERROR(LOG_IO, "%s: %s", jobs[index].input.string().c_str(), jobs[index].error.c_str());
+                ++finished;
+                continue;
+            }
+            pool.enqueue([&, index]() {
+                BatchJob& job = jobs[index];
+                convert(options, job, memory, parallelSave);
+                int done = ++finished;
+                if (job.ok) CLogger::writeBlocking(LOG_LEVEL_INFO, LOG_IO, "[%d/%zu] %s", done, jobs.size(), job.input.string().c_str());
+                else LOG_ERROR(LOG_IO, "[%d/%zu] %s: %s", done, jobs.size(), job.input.string().c_str(), job.error.c_str());
+            });
+        }
+        pool.wait();
+    }
+    double elapsed = steadySeconds() - start;
+
+    CTextWriter out;
+    out.append("{\"files\":[\n");
+    int failed = 0;
+    int warnings = 0;
+    uint64_t totalBytes = 0;
+    size_t totalFaces = 0;
+    CLogger::flush();
+    printf("%-40s %10s %10s %10s %10s %10s\n", "archivo", "caras", "espera ms", "carga ms", "norm ms", "guardar ms");
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const BatchJob& job = jobs[i];
+        if (!job.ok) failed++;
+        else if (job.invalidFaces) warnings++;
+        totalBytes += job.inputBytes;
+        totalFaces += job.faces;
+        printf("%-40s %10zu %10.1f %10.1f %10.1f %10.1f%s\n", job.input.filename().string().c_str(), job.faces,
+               job.waitMs, job.loadMs, job.normalizeMs, job.saveMs, !job.ok ? "  FALLO" : job.invalidFaces ? "  AVISO" : "");
+        if (job.invalidFaces) printf("    %zu caras con indices fuera de rango\n", job.invalidFaces);
+        if (i > 0) out.append(",\n");
+        appendJob(out, job);
+    }
+    out.append("\n],\"seconds\":");
+    out.appendFloat((float)elapsed);
+    out.append(",\"peakReservedBytes\":");
+    out.appendInt((long long)memory.getPeak());
+    out.append(",\"failed\":");
+    out.appendInt(failed);
+    out.append(",\"warnings\":");
+    out.appendInt(warnings);
+    out.append("}\n");
+
+    printf("%zu modelos, %d con errores, %d con avisos, %.2f s, %.1f MB/s, %.0f caras/s, pico de memoria reservada %.1f MB\n",
+           jobs.size(), failed, warnings, elapsed, totalBytes / (1024.0 * 1024.0) / std::max(elapsed, 1e-9),
+           totalFaces / std::max(elapsed, 1e-9), memory.getPeak() / (1024.0 * 1024.0));
+    fflush(stdout);
+
+    if (!options.reportPath.empty()) {
+        FILE* file = fopen(options.reportPath.c_str(), "wb");
+        bool written = file && out.writeTo(file);
+        if (file) written = (fclose(file) == 0) && written;
+        if (!written) {
+            LOG_ERROR(LOG_IO, "Error escribiendo el reporte: %s", options.reportPath.c_str());
+            failed++;
+        }
+    }
+
+    CLogger::shutdown();
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,171 @@
+#include "../utils/3DFigure.h"
+#include "../utils/Logger.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static bool check(bool condition, const char* test, const char* what)
+{
+    if (!condition) LOG_ERROR(LOG_GENERAL, "%s: %s", test, what);
+    return condition;
+}
+
+static bool worldBounds(C3DFigure& figure, vec3& boxMin, vec3& boxMax)
+{
+    const vector<vec3>& vertices = figure.getVertices();
+    const CFacePool& faces = figure.getFaces();
+    bool found = false;
+    for (const auto& mesh : figure.getSubMeshes()) {
+        for (int f = mesh.firstFace; f < mesh.firstFace + mesh.faceCount; ++f) {
+            for (int k = 0; k < 3; ++k) {
+                vec3 v = vertices[faces.vertex(f, k)] + mesh.instanceTranslation + mesh.offset;
+                boxMin = found ? glm::min(boxMin, v) : v;
+                boxMax = found ? glm::max(boxMax, v) : v;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+static bool isNormalized(C3DFigure& figure, const char* test)
+{
+    vec3 boxMin, boxMax;
+    if (!check(worldBounds(figure, boxMin, boxMax), test, "sin geometria")) return false;
+
+    vec3 extent = boxMax - boxMin;
+    float maxDim = std::max({ extent.x, extent.y, extent.z });
+    vec3 center = (boxMin + boxMax) * 0.5f;
+    bool ok = check(std::abs(maxDim - 1.0f) < 1e-4f, test, "la dimension mayor no es 1");
+    ok = check(glm::length(center) < 1e-4f, test, "el modelo no esta centrado") && ok;
+    if (!ok) {
+        LOG_ERROR(LOG_GENERAL, "%s: min (%g %g %g) max (%g %g %g)", test, boxMin.x, boxMin.y, boxMin.z, boxMax.x, boxMax.y, boxMax.z);
+    }
+    return ok;
+}
+
+static bool writeInstancedObj(const string& path)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+    const vec3 offsets[] = { vec3(0.0f), vec3(8.0f, 0.0f, 0.0f), vec3(0.0f, 6.0f, 0.0f), vec3(-3.0f, 0.0f, 9.5f) };
+    int base = 1;
+    for (int m = 0; m < 4; ++m) {
+        vec3 o = offsets[m];
+        fprintf(file, "v %g %g %g\nv %g %g %g\nv %g %g %g\nv %g %g %g\n", o.x, o.y, o.z, o.x + 1, o.y, o.z, o.x, o.y + 1, o.z, o.x, o.y, o.z + 1);
+        fprintf(file, "usemtl pieza%d\n", m);
+        fprintf(file, "f %d %d %d\nf %d %d %d\nf %d %d %d\nf %d %d %d\n", base, base + 1, base + 2, base, base + 1, base + 3,
+                base, base + 2, base + 3, base + 1, base + 2, base + 3);
+        base += 4;
+    }
+    return fclose(file) == 0;
+}
+
+static bool testInstancedNormalization(const fs::path& directory)
+{
+    const char* test = "normalizacion con instancias";
+    string objPath = (directory / "instancias.obj").string();
+    if (!check(writeInstancedObj(objPath), test, "no se pudo escribir el OBJ")) return false;
+
+    C3DFigure figure;
+    if (!check(figure.loadObject(objPath), test, "no se pudo cargar el OBJ")) return false;
+    bool ok = check(figure.getInstancedSubMeshCount() == 3, test, "no se detectaron las instancias");
+    ok = check(figure.getVertices().size() == 4 && figure.getNormals().size() == 4, test, "las instancias conservan sus vertices") && ok;
+    figure.normalization();
+    return isNormalized(figure, test) && ok;
+}
+
+static bool testGlbRoundTrip(const fs::path& directory)
+{
+    const char* test = "ida y vuelta OBJ -> GLB -> OBJ";
+    C3DFigure source;
+    if (!check(source.loadObject((directory / "instancias.obj").string()), test, "no se pudo cargar el OBJ")) return false;
+
+    string glbPath = (directory / "instancias.glb").string();
+    if (!check(source.saveGlb(glbPath, vec3(0.0f), quat(1.0f, 0.0f, 0.0f, 0.0f), vec3(1.0f)), test, "no se pudo guardar el GLB")) return false;
+
+    C3DFigure glb;
+    if (!check(glb.loadObject(glbPath), test, "no se pudo cargar el GLB")) return false;
+    bool ok = check(glb.getMaterials().size() == 2, test, "el GLB repite materiales compartidos");
+    glb.normalization();
+    ok = isNormalized(glb, test) && ok;
+
+    string objPath = (directory / "instancias_glb.obj").string();
+    if (!check(glb.saveObject(objPath, vec3(0.0f), quat(1.0f, 0.0f, 0.0f, 0.0f), vec3(1.0f)), test, "no se pudo guardar el OBJ")) return false;
+
+    C3DFigure obj;
+    if (!check(obj.loadObject(objPath), test, "no se pudo recargar el OBJ")) return false;
+    vec3 boxMin, boxMax;
+    ok = check(worldBounds(obj, boxMin, boxMax), test, "el OBJ exportado esta vacio") && ok;
+    ok = check(glm::all(glm::lessThanEqual(glm::abs(boxMin), vec3(0.5001f))) && glm::all(glm::lessThanEqual(glm::abs(boxMax), vec3(0.5001f))),
+               test, "el OBJ exportado sale del cubo unitario") && ok;
+    obj.normalization();
+    return isNormalized(obj, test) && ok;
+}
+
+static bool testInstancesWithTwoTextures(const fs::path& directory)
+{
+    const char* test = "instancias con dos texturas";
+    FILE* mtl = fopen((directory / "texturas.mtl").string().c_str(), "wb");
+    if (!check(mtl != nullptr, test, "no se pudo escribir el MTL")) return false;
+    fprintf(mtl, "newmtl madera\nKd 1 1 1\nmap_Kd madera.png\n\nnewmtl metal\nKd 1 1 1\nmap_Kd metal.png\n");
+    fclose(mtl);
+
+    string objPath = (directory / "texturas.obj").string();
+    FILE* file = fopen(objPath.c_str(), "wb");
+    if (!check(file != nullptr, test, "no se pudo escribir el OBJ")) return false;
+    fprintf(file, "mtllib texturas.mtl\nvt 0 0\nvt 1 0\nvt 0 1\n");
+    for (int m = 0; m < 3; ++m) {
+        fprintf(file, "v %d 0 0\nv %d 0 0\nv %d 1 0\n", 4 * m, 4 * m + 1, 4 * m);
+        fprintf(file, "usemtl %s\nf %d/1 %d/2 %d/3\n", m == 1 ? "metal" : "madera", 3 * m + 1, 3 * m + 2, 3 * m + 3);
+    }
+    fclose(file);
+
+    C3DFigure figure;
+    if (!check(figure.loadObject(objPath), test, "no se pudo cargar el OBJ")) return false;
+    bool ok = check(figure.getInstancedSubMeshCount() == 2, test, "no se detectaron las instancias");
+
+    vector<int> drawn(figure.getSubMeshes().size(), 0);
+    for (const auto& batch : figure.getMaterialBatches()) {
+        for (int id : batch.subMeshIds) drawn[id]++;
+    }
+    int sharedGroups = 0;
+    for (const auto& group : figure.getInstanceGroups()) {
+        if (!group.shared) continue;
+        sharedGroups++;
+        for (int id : group.subMeshIds) drawn[id]++;
+    }
+    ok = check(sharedGroups == 2, test, "se esperaban dos grupos de instancias, uno por textura") && ok;
+    ok = check(std::all_of(drawn.begin(), drawn.end(), [](int count) { return count == 1; }), test,
+               "alguna submalla no se dibuja exactamente una vez") && ok;
+    return ok;
+}
+
+int main()
+{
+    fs::path directory = fs::temp_directory_path() / "figure_tests";
+    std::error_code error;
+    fs::create_directories(directory, error);
+
+    const pair<const char*, function<bool(const fs::path&)>> tests[] = {
+        { "normalizacion con instancias", testInstancedNormalization },
+        { "ida y vuelta GLB", testGlbRoundTrip },
+        { "instancias con dos texturas", testInstancesWithTwoTextures },
+    };
+
+    int failed = 0;
+    for (const auto& test : tests) {
+        bool ok = test.second(directory);
+        if (!ok) failed++;
+        LOG_INFO(LOG_GENERAL, "%s %s", ok ? "OK   " : "FALLO", test.first);
+    }
+    fs::remove_all(directory, error);
+
+    CLogger::flush();
+    CLogger::shutdown();
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,218 @@
+#include "MeshGenerator.h"
+#include "../utils/TextWriter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "../glm/geometric.hpp"
+#include "../glm/gtc/constants.hpp"
+
+static vec3 sphereSurface(float u, float v, vec3& normal) {
+    float theta = u * 2.0f * pi<float>();
+    float phi = v * pi<float>();
+    normal = vec3(sin(phi) * cos(theta), cos(phi), sin(phi) * sin(theta));
+    return normal;
+}
+
+static vec3 planeSurface(float u, float v, vec3& normal) {
+    float x = u * 2.0f - 1.0f;
+    float z = v * 2.0f - 1.0f;
+    float wave = 0.1f * sin(x * 6.0f) * cos(z * 6.0f);
+    float dx = 0.6f * cos(x * 6.0f) * cos(z * 6.0f);
+    float dz = -0.6f * sin(x * 6.0f) * sin(z * 6.0f);
+    normal = normalize(vec3(-dx, 1.0f, -dz));
+    return vec3(x, wave, z);
+}
+
+static vec3 torusSurface(float u, float v, vec3& normal) {
+    float theta = u * 2.0f * pi<float>();
+    float phi = v * 2.0f * pi<float>();
+    vec3 ring(cos(theta), 0.0f, sin(theta));
+    normal = ring * cos(phi) + vec3(0.0f, sin(phi), 0.0f);
+    return ring * 0.7f + normal * 0.3f;
+}
+
+void CMeshGenerator::addGrid(int columns, int rows, vec3 (*surface)(float u, float v, vec3& normal)) {
+    int base = (int)positions.size();
+    for (int r = 0; r <= rows; ++r) {
+        for (int c = 0; c <= columns; ++c) {
+            vec2 uv((float)c / columns, (float)r / rows);
+            vec3 normal;
+            positions.push_back(surface(uv.x, uv.y, normal));
+            normals.push_back(normal);
+            texcoords.push_back(uv);
+        }
+    }
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < columns; ++c) {
+            int i0 = base + r * (columns + 1) + c;
+            int i1 = i0 + 1;
+            int i2 = i0 + columns + 1;
+            int i3 = i2 + 1;
+            indices.insert(indices.end(), { i0, i2, i1, i1, i2, i3 });
+        }
+    }
+}
+
+void CMeshGenerator::buildSphere(int triangles) {
+    int rows = std::max(2, (int)lround(sqrt(triangles / 4.0)));
+    addGrid(rows * 2, rows, sphereSurface);
+}
+
+void CMeshGenerator::buildPlane(int triangles) {
+    int rows = std::max(1, (int)lround(sqrt(triangles / 2.0)));
+    addGrid(rows, rows, planeSurface);
+}
+
+void CMeshGenerator::buildTorus(int triangles) {
+    int rows = std::max(3, (int)lround(sqrt(triangles / 4.0)));
+    addGrid(rows * 2, rows, torusSurface);
+}
+
+void CMeshGenerator::buildSoup(int triangles, int subMeshes, uint32_t seed) {
+    uint32_t state = seed ? seed : 1;
+    auto next = [&state]() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return (state & 0xFFFFFF) / (float)0x1000000;
+    };
+
+    int perCluster = std::max(1, triangles / std::max(1, subMeshes));
+    vec3 cluster(0.0f);
+    for (int t = 0; t < triangles; ++t) {
+        if (t % perCluster == 0) {
+            cluster = vec3(next() * 1.6f - 0.8f, next() * 1.6f - 0.8f, next() * 1.6f - 0.8f);
+        }
+        vec3 center = cluster + vec3(next() - 0.5f, next() - 0.5f, next() - 0.5f) * 0.4f;
+        float size = 0.02f + 0.05f * next();
+        vec3 a = center + vec3(next() - 0.5f, next() - 0.5f, next() - 0.5f) * size;
+        vec3 b = center + vec3(next() - 0.5f, next() - 0.5f, next() - 0.5f) * size;
+        vec3 c = center + vec3(next() - 0.5f, next() - 0.5f, next() - 0.5f) * size;
+        vec3 normal = cross(b - a, c - a);
+        normal = length(normal) > 0.0f ? normalize(normal) : vec3(0.0f, 1.0f, 0.0f);
+
+        int base = (int)positions.size();
+        positions.insert(positions.end(), { a, b, c });
+        normals.insert(normals.end(), { normal, normal, normal });
+        texcoords.insert(texcoords.end(), { vec2(0.0f, 0.0f), vec2(1.0f, 0.0f), vec2(0.0f, 1.0f) });
+        indices.insert(indices.end(), { base, base + 1, base + 2 });
+    }
+}
+
+bool CMeshGenerator::generate(const MeshGeneratorOptions& options) {
+    positions.clear();
+    normals.clear();
+    texcoords.clear();
+    indices.clear();
+    if (options.triangles <= 0) return false;
+
+    switch (options.shape) {
+    case MESH_SPHERE: buildSphere(options.triangles); break;
+    case MESH_GRID: buildPlane(options.triangles); break;
+    case MESH_TORUS: buildTorus(options.triangles); break;
+    case MESH_SOUP: buildSoup(options.triangles, options.subMeshes, options.seed); break;
+    default: return false;
+    }
+    return !indices.empty();
+}
+
+static void appendVec(CTextWriter& out, const char* prefix, const float* values, int count) {
+    out.append(prefix);
+    for (int i = 0; i < count; ++i) {
+        out.append(' ');
+        out.appendFloat(values[i]);
+    }
+    out.append('\n');
+}
+
+static void appendCorner(CTextWriter& out, int index, bool texcoords, bool normals) {
+    out.append(' ');
+    out.appendInt(index + 1);
+    if (!texcoords && !normals) return;
+    out.append('/');
+    if (texcoords) out.appendInt(index + 1);
+    if (normals) {
+        out.append('/');
+        out.appendInt(index + 1);
+    }
+}
+
+bool CMeshGenerator::write(const string& objPath, const MeshGeneratorOptions& options) const {
+    if (indices.empty()) return false;
+
+    string base = objPath.substr(0, objPath.find_last_of('.'));
+    string mtlPath = base + ".mtl";
+    size_t slash = mtlPath.find_last_of("/\\");
+    string mtlName = slash == string::npos ? mtlPath : mtlPath.substr(slash + 1);
+
+    int materialCount = std::max(1, options.materials);
+    CTextWriter mtl;
+    for (int m = 0; m < materialCount; ++m) {
+        float hue = (float)m / materialCount;
+        float kd[3] = { 0.5f + 0.5f * cos(6.2831853f * hue), 0.5f + 0.5f * cos(6.2831853f * (hue + 0.33f)), 0.5f + 0.5f * cos(6.2831853f * (hue + 0.67f)) };
+        float ka[3] = { 0.1f, 0.1f, 0.1f };
+        float ks[3] = { 0.5f, 0.5f, 0.5f };
+        mtl.append("newmtl mat");
+        mtl.appendInt(m);
+        mtl.append('\n');
+        appendVec(mtl, "Ka", ka, 3);
+        appendVec(mtl, "Kd", kd, 3);
+        appendVec(mtl, "Ks", ks, 3);
+        mtl.append("Ns 32\n\n");
+    }
+
+    CTextWriter obj;
+    obj.reserve(positions.size() * 96 + indices.size() * 12);
+    obj.append("# ");
+    obj.append(getShapeName(options.shape));
+    obj.append(", ");
+    obj.appendInt((long long)getTriangleCount());
+    obj.append(" triangulos\nmtllib ");
+    obj.append(mtlName);
+    obj.append('\n');
+    for (const auto& p : positions) appendVec(obj, "v", &p.x, 3);
+    if (options.texcoords) {
+        for (const auto& t : texcoords) appendVec(obj, "vt", &t.x, 2);
+    }
+    if (options.normals) {
+        for (const auto& n : normals) appendVec(obj, "vn", &n.x, 3);
+    }
+
+    size_t triangleCount = getTriangleCount();
+    size_t groups = std::min(triangleCount, (size_t)std::max(1, options.subMeshes));
+    for (size_t g = 0; g < groups; ++g) {
+        size_t first = triangleCount * g / groups;
+        size_t last = triangleCount * (g + 1) / groups;
+        obj.append("usemtl mat");
+        obj.appendInt((long long)(g % materialCount));
+        obj.append('\n');
+        for (size_t t = first; t < last; ++t) {
+            obj.append('f');
+            for (int k = 0; k < 3; ++k) appendCorner(obj, indices[t * 3 + k], options.texcoords, options.normals);
+            obj.append('\n');
+        }
+    }
+
+    FILE* file = fopen(objPath.c_str(), "wb");
+    bool ok = file && obj.writeTo(file);
+    if (file) ok = (fclose(file) == 0) && ok;
+    file = fopen(mtlPath.c_str(), "wb");
+    ok = file && mtl.writeTo(file) && ok;
+    if (file) ok = (fclose(file) == 0) && ok;
+    return ok;
+}
+
+const char* CMeshGenerator::getShapeName(MeshShape shape) {
+    static const char* names[MESH_SHAPE_COUNT] = { "esfera", "malla", "toro", "sopa" };
+    return shape >= 0 && shape < MESH_SHAPE_COUNT ? names[shape] : "?";
+}
+
+bool CMeshGenerator::parseShape(const string& name, MeshShape& shape) {
+    for (int s = 0; s < MESH_SHAPE_COUNT; ++s) {
+        if (name == getShapeName((MeshShape)s)) {
+            shape = (MeshShape)s;
+            return true;
+        }
+    }
+    return false;
+}
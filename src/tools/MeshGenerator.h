@@ -0,0 +1,50 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "../glm/vec2.hpp"
+#include "../glm/vec3.hpp"
+
+using namespace std;
+using namespace glm;
+
+enum MeshShape {
+    MESH_SPHERE,
+    MESH_GRID,
+    MESH_TORUS,
+    MESH_SOUP,
+    MESH_SHAPE_COUNT
+};
+
+struct MeshGeneratorOptions {
+    MeshShape shape = MESH_SPHERE;
+    int triangles = 100000;
+    int subMeshes = 1;
+    int materials = 4;
+    bool normals = true;
+    bool texcoords = true;
+    uint32_t seed = 1;
+};
+
+class CMeshGenerator {
+    vector<vec3> positions;
+    vector<vec3> normals;
+    vector<vec2> texcoords;
+    vector<int> indices;
+
+    void addGrid(int columns, int rows, vec3 (*surface)(float u, float v, vec3& normal));
+    void buildSphere(int triangles);
+    void buildPlane(int triangles);
+    void buildTorus(int triangles);
+    void buildSoup(int triangles, int subMeshes, uint32_t seed);
+
+public:
+    bool generate(const MeshGeneratorOptions& options);
+    bool write(const string& objPath, const MeshGeneratorOptions& options) const;
+
+    size_t getTriangleCount() const { return indices.size() / 3; }
+    size_t getVertexCount() const { return positions.size(); }
+
+    static const char* getShapeName(MeshShape shape);
+    static bool parseShape(const string& name, MeshShape& shape);
+};
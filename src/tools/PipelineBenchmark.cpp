@@ -0,0 +1,337 @@
+#include "MeshGenerator.h"
+#include "../3DViewer.h"
+#include "../utils/3DFigure.h"
+#include "../utils/Logger.h"
+#include "../utils/TextWriter.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <sstream>
+
+using namespace std;
+
+enum PipelineStage {
+    STAGE_LOAD_OBJECT,
+    STAGE_LOAD_MTL,
+    STAGE_NORMALS,
+    STAGE_NORMALIZATION,
+    STAGE_FLATTEN,
+    STAGE_SETUP_MODEL,
+    STAGE_SAVE_OBJECT,
+    STAGE_SAVE_GLB,
+    STAGE_LOAD_GLB,
+    STAGE_COUNT
+};
+
+static const char* stageNames[STAGE_COUNT] = { "loadObject", "loadMtl", "generateNormals", "normalization", "flatten", "setupModel", "saveObject", "saveGlb", "loadGlb" };
+
+struct PipelineOptions {
+    string outputDirectory = "pipeline";
+    string reportPath = "pipeline.json";
+    vector<int> sizes = { 10000, 100000, 1000000 };
+    vector<MeshShape> shapes = { MESH_SPHERE, MESH_GRID, MESH_TORUS, MESH_SOUP };
+    int subMeshes = 64;
+    int repeat = 3;
+    bool generateOnly = false;
+    bool gpu = true;
+};
+
+struct PipelineCase {
+    MeshGeneratorOptions mesh;
+    string objPath;
+    uint64_t objBytes = 0;
+    uint64_t mtlBytes = 0;
+    uint64_t glbBytes = 0;
+    size_t triangles = 0;
+    float seconds[STAGE_COUNT] = {};
+    bool measured[STAGE_COUNT] = {};
+};
+
+static double steadySeconds()
+{
+    using namespace std::chrono;
+    static const steady_clock::time_point start = steady_clock::now();
+    return duration<double>(steady_clock::now() - start).count();
+}
+
+static float median(vector<float> values)
+{
+    if (values.empty()) return 0.0f;
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+static bool parseList(const char* text, vector<string>& items)
+{
+    items.clear();
+    stringstream stream(text);
+    string item;
+    while (getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return !items.empty();
+}
+
+static bool parseOptions(int argc, char** argv, PipelineOptions& options)
+{
+    vector<string> items;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(arg, "--out") && hasValue) options.outputDirectory = argv[++i];
+        else if (!strcmp(arg, "--report") && hasValue) options.reportPath = argv[++i];
+        else if (!strcmp(arg, "--repeat") && hasValue) options.repeat = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(arg, "--submeshes") && hasValue) options.subMeshes = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(arg, "--generate-only")) options.generateOnly = true;
+        else if (!strcmp(arg, "--no-gpu")) options.gpu = false;
+        else if (!strcmp(arg, "--sizes") && hasValue && parseList(argv[++i], items)) {
+            options.sizes.clear();
+            for (const auto& item : items) {
+                int size = atoi(item.c_str());
+                if (size <= 0) return false;
+                options.sizes.push_back(size);
+            }
+        }
+        else if (!strcmp(arg, "--shapes") && hasValue && parseList(argv[++i], items)) {
+            options.shapes.clear();
+            for (const auto& item : items) {
+                MeshShape shape;
+                if (!CMeshGenerator::parseShape(item, shape)) return false;
+                options.shapes.push_back(shape);
+            }
+        }
+        else return false;
+    }
+    return true;
+}
+
+static string caseName(const MeshGeneratorOptions& mesh)
+{
+    string name = string(CMeshGenerator::getShapeName(mesh.shape)) + "_" + to_string(mesh.triangles);
+    if (mesh.texcoords) name += "_vt";
+    if (mesh.normals) name += "_vn";
+    return name;
+}
+
+static bool generateCase(PipelineCase& test)
+{
+    CMeshGenerator generator;
+    if (!generator.generate(test.mesh) || !generator.write(test.objPath, test.mesh)) {
+        LOG_ERROR(LOG_IO, "No se pudo generar: %s", test.objPath.c_str());
+        return false;
+    }
+    std::error_code error;
+    test.triangles = generator.getTriangleCount();
+    test.objBytes = std::filesystem::file_size(test.objPath, error);
+    test.mtlBytes = std::filesystem::file_size(test.objPath.substr(0, test.objPath.find_last_of('.')) + ".mtl", error);
+    return true;
+}
+
+static void measureCase(const PipelineOptions& options, PipelineCase& test, C3DViewer* viewer, unique_ptr<C3DFigure>& shown)
+{
+    vector<float> samples[STAGE_COUNT];
+    string mtlPath = test.objPath.substr(0, test.objPath.find_last_of('.')) + ".mtl";
+    string savedPath = test.objPath.substr(0, test.objPath.find_last_of('.')) + "_guardado.obj";
+    string glbPath = test.objPath.substr(0, test.objPath.find_last_of('.')) + ".glb";
+
+    for (int r = 0; r < options.repeat; ++r) {
+        auto figure = make_unique<C3DFigure>();
+        double start = steadySeconds();
+        if (!figure->loadObject(test.objPath)) {
+            LOG_ERROR(LOG_IO, "Error cargando: %s", test.objPath.c_str());
+            return;
+        }
+        samples[STAGE_LOAD_OBJECT].push_back((float)(steadySeconds() - start));
+
+        map<string, Material> materials;
+        start = steadySeconds();
+        figure->loadMtl(mtlPath, materials);
+        samples[STAGE_LOAD_MTL].push_back((float)(steadySeconds() - start));
+
+        start = steadySeconds();
+        figure->generateNormals();
+        samples[STAGE_NORMALS].push_back((float)(steadySeconds() - start));
+
+        start = steadySeconds();
+        figure->normalization();
+        samples[STAGE_NORMALIZATION].push_back((float)(steadySeconds() - start));
+
+        start = steadySeconds();
+        vector<float> vertices = figure->flatten();
+        samples[STAGE_FLATTEN].push_back((float)(steadySeconds() - start));
+        vertices = vector<float>();
+
+        C3DFigure* current = figure.get();
+        if (viewer) {
+            start = steadySeconds();
+            viewer->setupModel(current);
+            shown = std::move(figure);
+            if (!viewer->completeUploads(1, 60.0)) LOG_WARNING(LOG_RENDER, "Subidas pendientes en %s", test.objPath.c_str());
+            samples[STAGE_SETUP_MODEL].push_back((float)(steadySeconds() - start));
+        }
+
+        start = steadySeconds();
+        if (!current->saveObject(savedPath, vec3(0.0f), quat(1.0f, 0.0f, 0.0f, 0.0f), vec3(1.0f))) {
+            LOG_ERROR(LOG_IO, "Error guardando: %s", savedPath.c_str());
+            return;
+        }
+        samples[STAGE_SAVE_OBJECT].push_back((float)(steadySeconds() - start));
+
+        start = steadySeconds();
+        if (!current->saveGlb(glbPath, vec3(0.0f), quat(1.0f, 0.0f, 0.0f, 0.0f), vec3(1.0f))) {
+            LOG_ERROR(LOG_IO, "Error guardando: %s", glbPath.c_str());
+            return;
+        }
+        samples[STAGE_SAVE_GLB].push_back((float)(steadySeconds() - start));
+
+        C3DFigure glb;
+        start = steadySeconds();
+        if (!glb.loadObject(glbPath)) {
+            LOG_ERROR(LOG_IO, "Error cargando: %s", glbPath.c_str());
+            return;
+        }
+        samples[STAGE_LOAD_GLB].push_back((float)(steadySeconds() - start));
+    }
+
+    std::error_code error;
+    test.glbBytes = std::filesystem::file_size(glbPath, error);
+    std::filesystem::remove(glbPath, error);
+    std::filesystem::remove(savedPath, error);
+    std::filesystem::remove(savedPath.substr(0, savedPath.find_last_of('.')) + ".mtl", error);
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        test.measured[s] = !samples[s].empty();
+        test.seconds[s] = median(samples[s]);
+    }
+}
+
+static uint64_t stageBytes(const PipelineCase& test, int stage)
+{
+    if (stage == STAGE_LOAD_MTL) return test.mtlBytes;
+    if (stage == STAGE_SAVE_GLB || stage == STAGE_LOAD_GLB) return test.glbBytes;
+    return test.objBytes;
+}
+
+static void appendCase(CTextWriter& out, const PipelineCase& test)
+{
+    out.append("{\"name\":");
+    out.appendQuoted(caseName(test.mesh).c_str());
+    out.append(",\"shape\":");
+    out.appendQuoted(CMeshGenerator::getShapeName(test.mesh.shape));
+    out.append(",\"triangles\":");
+    out.appendInt((long long)test.triangles);
+    out.append(",\"normals\":");
+    out.append(test.mesh.normals ? "true" : "false");
+    out.append(",\"texcoords\":");
+    out.append(test.mesh.texcoords ? "true" : "false");
+    out.append(",\"objBytes\":");
+    out.appendInt((long long)test.objBytes);
+    out.append(",\"stages\":{");
+    bool first = true;
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        if (!test.measured[s]) continue;
+        double seconds = std::max((double)test.seconds[s], 1e-9);
+        double bytes = (double)stageBytes(test, s);
+        if (!first) out.append(',');
+        first = false;
+        out.appendQuoted(stageNames[s]);
+        out.append(":{\"ms\":");
+        out.appendFloat((float)(seconds * 1000.0));
+        out.append(",\"mbPerSecond\":");
+        out.appendFloat((float)(bytes / (1024.0 * 1024.0) / seconds));
+        if (s != STAGE_LOAD_MTL) {
+            out.append(",\"trianglesPerSecond\":");
+            out.appendFloat((float)(test.triangles / seconds));
+        }
+        out.append('}');
+    }
+    out.append("}}");
+}
+
+static void logCase(const PipelineCase& test)
+{
+    LOG_INFO(LOG_GENERAL, "%s: %zu triangulos, %.2f MB", caseName(test.mesh).c_str(), test.triangles, test.objBytes / (1024.0 * 1024.0));
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        if (!test.measured[s]) continue;
+        double seconds = std::max((double)test.seconds[s], 1e-9);
+        double bytes = (double)stageBytes(test, s);
+        LOG_INFO(LOG_GENERAL, "  %-16s %10.3f ms %10.1f MB/s %14.0f tri/s", stageNames[s], seconds * 1000.0,
+                 bytes / (1024.0 * 1024.0) / seconds, test.triangles / seconds);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    PipelineOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        LOG_ERROR(LOG_GENERAL, "Uso: PipelineBenchmark [--out dir] [--report archivo] [--sizes 10000,100000] [--shapes esfera,malla,toro,sopa]");
+        LOG_ERROR(LOG_GENERAL, "                         [--submeshes n] [--repeat n] [--generate-only] [--no-gpu]");
+        CLogger::shutdown();
+        return 2;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(options.outputDirectory, error);
+
+    unique_ptr<C3DFigure> shown;
+    unique_ptr<C3DViewer> viewer;
+    if (options.gpu && !options.generateOnly) {
+        viewer = make_unique<C3DViewer>();
+        if (!viewer->setupHeadless(64, 64)) {
+            LOG_WARNING(LOG_RENDER, "Sin contexto OpenGL; se omite setupModel");
+            viewer.reset();
+        }
+    }
+
+    CTextWriter out;
+    out.append("{\"repeat\":");
+    out.appendInt(options.repeat);
+    out.append(",\"cases\":[\n");
+
+    bool passed = true;
+    bool first = true;
+    for (MeshShape shape : options.shapes) {
+        for (int size : options.sizes) {
+            for (int attributes = 0; attributes < 2; ++attributes) {
+                PipelineCase test;
+                test.mesh.shape = shape;
+                test.mesh.triangles = size;
+                test.mesh.subMeshes = shape == MESH_SOUP ? options.subMeshes : 1;
+                test.mesh.normals = test.mesh.texcoords = attributes == 1;
+                test.objPath = (std::filesystem::path(options.outputDirectory) / (caseName(test.mesh) + ".obj")).string();
+
+                if (!generateCase(test)) {
+                    passed = false;
+                    continue;
+                }
+                if (options.generateOnly) continue;
+
+                measureCase(options, test, viewer.get(), shown);
+                if (!test.measured[STAGE_SAVE_OBJECT]) passed = false;
+                logCase(test);
+
+                if (!first) out.append(",\n");
+                first = false;
+                appendCase(out, test);
+            }
+        }
+    }
+    out.append("\n]}\n");
+
+    if (!options.generateOnly) {
+        FILE* file = fopen(options.reportPath.c_str(), "wb");
+        bool written = file && out.writeTo(file);
+        if (file) written = (fclose(file) == 0) && written;
+        if (!written) {
+            LOG_ERROR(LOG_IO, "Error escribiendo el reporte: %s", options.reportPath.c_str());
+            passed = false;
+        }
+    }
+
+    viewer.reset();
+    shown.reset();
+    CLogger::shutdown();
+    return passed ? 0 : 1;
+}
@@ -1,23 +1,43 @@
 #include "3DFigure.h"
+#include "ThreadPool.h"
+#include "MappedFile.h"
+#include "JsonValue.h"
+#include "Trace.h"
+#include "Logger.h"
 #include <fstream>
 #include <map>
 #include <sstream>
 #include <algorithm>
+#include <unordered_map>
+#include <cstdint>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <cstring>
+#include <cctype>
+#include <mutex>
+#include <condition_variable>
 #include "../glm/geometric.hpp" 
 #include "../glm/glm.hpp"
+#include "../glm/gtc/matrix_transform.hpp"
 
 using namespace std;
 
-C3DFigure::C3DFigure() {}
+C3DFigure::C3DFigure() : materials(1) {}
 C3DFigure::~C3DFigure() {}
 
 bool C3DFigure::loadMtl(string path, map<string, Material>& materialMap) {
+    TRACE_ZONE("loadMtl");
     ifstream file(path);
     if (!file.is_open()) {
-        cout << "Aviso: No se encontró el archivo MTL. Usando color gris por defecto." << endl;
+        LOG_WARNING(LOG_IO, "No se encontró el archivo MTL. Usando color gris por defecto.");
         return false;
     }
 
+    string dir = "";
+    size_t lastSlash = path.find_last_of("/\\");
+    if (lastSlash != string::npos) dir = path.substr(0, lastSlash + 1);
+
     string line;
     Material* currentMaterial = nullptr;
     while (getline(file, line)) {
@@ -55,6 +75,7 @@ bool C3DFigure::loadMtl(string path, map<string, Material>& materialMap) {
             }
             else if (type == "map_Kd") {
                 ss >> currentMaterial->textureMap;
+                currentMaterial->texturePath = dir + currentMaterial->textureMap;
             }
         }
     }
@@ -63,14 +84,20 @@ bool C3DFigure::loadMtl(string path, map<string, Material>& materialMap) {
 }
 
 bool C3DFigure::loadObject(string path) {
+    TRACE_ZONE("loadObject");
+    sourcePath = path;
+    if (hasExtension(path, ".glb")) return loadGlb(path);
+    if (hasExtension(path, ".ply")) return loadPly(path);
+
     ifstream entrada(path);
     if (!entrada.is_open()) {
-        cout << "Error abriendo el archivo" << endl;
+        LOG_ERROR(LOG_IO, "Error abriendo el archivo: %s", path.c_str());
         return false;
     }
 
     string linea;
     map<string, Material> materialMap;
+    map<string, int> materialIndex;
     SubMesh* currentSubMesh = nullptr;
 
     while (getline(entrada, linea)) {
@@ -81,17 +108,24 @@ bool C3DFigure::loadObject(string path) {
         if (tipo == "v") {
             vec3 v;
             ss >> v.x >> v.y >> v.z;
-            vertices.push_back(v);
+            vertices.edit().push_back(v);
+
+            vec3 color;
+            if (ss >> color.r >> color.g >> color.b) {
+                vector<vec3>& colors = vertexColors.edit();
+                colors.resize(vertices.size() - 1, vec3(0.7f));
+                colors.push_back(color);
+            }
         }
         else if (tipo == "vn") {
             vec3 vn;
             ss >> vn.x >> vn.y >> vn.z;
-            normals.push_back(vn);
+            normals.edit().push_back(vn);
         }
         else if (tipo == "vt") {
             vec3 vt;
             ss >> vt.x >> vt.y >> vt.z;
-            textures.push_back(vt);
+            textures.edit().push_back(vt);
         }
         else if (tipo == "mtllib") {
             string mtlFile;
@@ -107,29 +141,31 @@ bool C3DFigure::loadObject(string path) {
             subMeshes.push_back(SubMesh());
             currentSubMesh = &subMeshes.back();
             currentSubMesh->groupName = groupName;
+            currentSubMesh->firstFace = (int)faces.size();
         }
         else if (tipo == "f") {
             if (currentSubMesh == nullptr) {
                 subMeshes.push_back(SubMesh());
                 currentSubMesh = &subMeshes.back();
+                currentSubMesh->firstFace = (int)faces.size();
             }
             string vData;
-            vector<vec3> polygonVertices;
+            vector<ivec3> polygonVertices;
             while (ss >> vData) {
-                vec3 vertexData(0.0f, 0.0f, 0.0f);
+                ivec3 vertexData(ABSENT_INDEX);
                 size_t firstSlash = vData.find('/');
                 size_t secondSlash = vData.find('/', firstSlash + 1);
 
-                vertexData.x = static_cast<float>(stoi(vData.substr(0, firstSlash)) - 1);
+                vertexData.x = stoi(vData.substr(0, firstSlash)) - 1;
 
                 if (firstSlash != string::npos && firstSlash + 1 != secondSlash) {
                     string part = vData.substr(firstSlash + 1, secondSlash - firstSlash - 1);
-                    if (!part.empty()) vertexData.y = static_cast<float>(stoi(part) - 1);
+                    if (!part.empty()) vertexData.y = stoi(part) - 1;
                 }
 
                 if (secondSlash != string::npos) {
                     string part = vData.substr(secondSlash + 1);
-                    if (!part.empty()) vertexData.z = static_cast<float>(stoi(part) - 1);
+                    if (!part.empty()) vertexData.z = stoi(part) - 1;
                 }
                 polygonVertices.push_back(vertexData);
             }
@@ -137,19 +173,20 @@ bool C3DFigure::loadObject(string path) {
             if (polygonVertices.size() >= 3) {
                 for (size_t i = 1; i < polygonVertices.size() - 1; ++i) {
                     FaceElement face;
-                    face.vertexIndices[0] = static_cast<int>(polygonVertices[0].x);
-                    face.textureIndices[0] = static_cast<int>(polygonVertices[0].y);
-                    face.normalIndices[0] = static_cast<int>(polygonVertices[0].z);
+                    face.vertexIndices[0] = polygonVertices[0].x;
+                    face.textureIndices[0] = polygonVertices[0].y;
+                    face.normalIndices[0] = polygonVertices[0].z;
 
-                    face.vertexIndices[1] = static_cast<int>(polygonVertices[i].x);
-                    face.textureIndices[1] = static_cast<int>(polygonVertices[i].y);
-                    face.normalIndices[1] = static_cast<int>(polygonVertices[i].z);
+                    face.vertexIndices[1] = polygonVertices[i].x;
+                    face.textureIndices[1] = polygonVertices[i].y;
+                    face.normalIndices[1] = polygonVertices[i].z;
 
-                    face.vertexIndices[2] = static_cast<int>(polygonVertices[i + 1].x);
-                    face.textureIndices[2] = static_cast<int>(polygonVertices[i + 1].y);
-                    face.normalIndices[2] = static_cast<int>(polygonVertices[i + 1].z);
+                    face.vertexIndices[2] = polygonVertices[i + 1].x;
+                    face.textureIndices[2] = polygonVertices[i + 1].y;
+                    face.normalIndices[2] = polygonVertices[i + 1].z;
 
-                    currentSubMesh->faces.push_back(face);
+                    faces.push(face);
+                    currentSubMesh->faceCount++;
                 }
             }
         }
@@ -159,126 +196,418 @@ bool C3DFigure::loadObject(string path) {
             subMeshes.push_back(SubMesh());
             currentSubMesh = &subMeshes.back();
             currentSubMesh->groupName = mtlName;
+            currentSubMesh->firstFace = (int)faces.size();
 
             if (materialMap.count(mtlName)) {
-                currentSubMesh->material = materialMap[mtlName];
-            }
-            else {
-                currentSubMesh->material.kd[0] = 0.7f;
-                currentSubMesh->material.kd[1] = 0.7f;
-                currentSubMesh->material.kd[2] = 0.7f;
+                auto found = materialIndex.find(mtlName);
+                if (found == materialIndex.end()) found = materialIndex.emplace(mtlName, addMaterial(materialMap[mtlName])).first;
+                currentSubMesh->material = found->second;
+                currentSubMesh->color = materials[found->second].kd;
             }
         }
     }
 
-    if(normals.empty()){
-        normals.assign(vertices.size(), vec3(0.0f));
-        for (auto& subMesh : subMeshes) {
-            for (auto& face : subMesh.faces) {
-                int i0 = face.vertexIndices[0];
-                int i1 = face.vertexIndices[1];
-                int i2 = face.vertexIndices[2];
+    if (!vertexColors.empty()) {
+        vertexColors.edit().resize(vertices.size(), vec3(0.7f));
+        for (auto& mesh : subMeshes) {
+            if (mesh.material == 0) mesh.color = vec3(1.0f);
+        }
+    }
+    if(normals.empty() && !subMeshes.empty()) generateNormals();
+    entrada.close();
+
+    detectInstances();
+    return true;
+}
+
+void C3DFigure::generateNormals() {
+    vector<vec3>& generated = normals.edit();
+    generated.assign(vertices.size(), vec3(0.0f));
+    for (const auto& subMesh : subMeshes) {
+        if (subMesh.instanceOf >= 0) continue;
+        for (int f = subMesh.firstFace; f < subMesh.firstFace + subMesh.faceCount; ++f) {
+            int i0 = faces.vertex(f, 0);
+            int i1 = faces.vertex(f, 1);
+            int i2 = faces.vertex(f, 2);
+
+            vec3 v0 = vertices[i0];
+            vec3 v1 = vertices[i1];
+            vec3 v2 = vertices[i2];
+
+            vec3 edge1 = v1 - v0;
+            vec3 edge2 = v2 - v0;
+            vec3 faceNormal = cross(edge1, edge2);
+
+            generated[i0] += faceNormal;
+            generated[i1] += faceNormal;
+            generated[i2] += faceNormal;
+            
+            faces.setNormal(f, 0, i0);
+            faces.setNormal(f, 1, i1);
+            faces.setNormal(f, 2, i2);
+        }
+    }
+
+    for (size_t i = 0; i < generated.size(); i++) {
+        if (length(generated[i]) > 0.0f) {
+            generated[i] = normalize(generated[i]);
+        }
+    }
+}
+
+static bool localOrigin(const vector<vec3>& vertices, const CFacePool& faces, const SubMesh& mesh, vec3& origin) {
+    bool found = false;
+    for (int f = mesh.firstFace; f < mesh.firstFace + mesh.faceCount; ++f) {
+        for (int i = 0; i < 3; ++i) {
+            int idx = faces.vertex(f, i);
+            if (idx < 0 || idx >= (int)vertices.size()) return false;
+            origin = found ? glm::min(origin, vertices[idx]) : vertices[idx];
+            found = true;
+        }
+    }
+    return found;
+}
+
+// Two submeshes are instances when every corner lies within INSTANCE_POSITION_TOLERANCE * model extent
+// per axis and normals agree within acos(INSTANCE_NORMAL_COSINE) (~0.8 degrees). The instance is then drawn
+// with the prototype's geometry, so its vertices may drift by up to that tolerance.
+static const float INSTANCE_POSITION_TOLERANCE = 1e-6f;
+static const float INSTANCE_NORMAL_COSINE = 0.9999f;
+
+static uint64_t hashCombine(uint64_t h, uint64_t value) {
+    h ^= value + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    return h;
+}
+
+void C3DFigure::detectInstances() {
+    if (subMeshes.size() < 2 || vertices.empty()) return;
+
+    vec3 modelMin = vertices[0], modelMax = vertices[0];
+    for (const auto& v : vertices) {
+        modelMin = glm::min(modelMin, v);
+        modelMax = glm::max(modelMax, v);
+    }
+    vec3 extent = modelMax - modelMin;
+    float quantum = std::max({extent.x, extent.y, extent.z}) * INSTANCE_POSITION_TOLERANCE;
+    if (quantum <= 0.0f) return;
 
-                vec3 v0 = vertices[i0];
-                vec3 v1 = vertices[i1];
-                vec3 v2 = vertices[i2];
+    vector<vec3> origins(subMeshes.size());
+    unordered_map<uint64_t, vector<int>> prototypes;
 
-                vec3 edge1 = v1 - v0;
-                vec3 edge2 = v2 - v0;
-                vec3 faceNormal = cross(edge1, edge2);
+    for (int m = 0; m < (int)subMeshes.size(); ++m) {
+        SubMesh& mesh = subMeshes[m];
+        if (!localOrigin(vertices.get(), faces, mesh, origins[m])) continue;
 
-                normals[i0] += faceNormal;
-                normals[i1] += faceNormal;
-                normals[i2] += faceNormal;
-                
-                face.normalIndices[0] = face.vertexIndices[0];
-                face.normalIndices[1] = face.vertexIndices[1];
-                face.normalIndices[2] = face.vertexIndices[2];
+        uint64_t h = hashCombine(0, mesh.faceCount);
+        for (int f = mesh.firstFace; f < mesh.firstFace + mesh.faceCount; ++f) {
+            for (int i = 0; i < 3; ++i) {
+                vec3 rel = (vertices[faces.vertex(f, i)] - origins[m]) / quantum;
+                h = hashCombine(h, (uint64_t)llround(rel.x));
+                h = hashCombine(h, (uint64_t)llround(rel.y));
+                h = hashCombine(h, (uint64_t)llround(rel.z));
             }
         }
 
-        for (int i = 0; i < normals.size(); i++) {
-            if (length(normals[i]) > 0.0f) {
-                normals[i] = normalize(normals[i]);
+        vector<int>& candidates = prototypes[h];
+        int match = -1;
+        for (int p : candidates) {
+            const SubMesh& proto = subMeshes[p];
+            if (proto.faceCount != mesh.faceCount) continue;
+
+            bool equal = true;
+            for (int f = 0; f < mesh.faceCount && equal; ++f) {
+                int fa = proto.firstFace + f;
+                int fb = mesh.firstFace + f;
+                for (int i = 0; i < 3 && equal; ++i) {
+                    vec3 a = vertices[faces.vertex(fa, i)] - origins[p];
+                    vec3 b = vertices[faces.vertex(fb, i)] - origins[m];
+                    vec3 d = abs(a - b);
+                    if (d.x > quantum || d.y > quantum || d.z > quantum) equal = false;
+
+                    int ta = faces.texture(fa, i);
+                    int tb = faces.texture(fb, i);
+                    if ((ta == ABSENT_INDEX) != (tb == ABSENT_INDEX)) equal = false;
+                    if (equal && ta >= 0 && ta < (int)textures.size() && tb >= 0 && tb < (int)textures.size()) {
+                        if (textures[ta] != textures[tb]) equal = false;
+                    }
+
+                    int na = faces.normal(fa, i);
+                    int nb = faces.normal(fb, i);
+                    if (equal && na >= 0 && na < (int)normals.size() && nb >= 0 && nb < (int)normals.size()) {
+                        if (dot(normals[na], normals[nb]) < INSTANCE_NORMAL_COSINE) equal = false;
+                    }
+                }
+            }
+            if (equal) {
+                match = p;
+                break;
             }
         }
+
+        if (match == -1) {
+            candidates.push_back(m);
+            continue;
+        }
+
+        mesh.instanceOf = match;
+        mesh.instanceTranslation = origins[m] - origins[match];
     }
-    entrada.close();
-    return true;
+    compactFaces();
+}
+
+static vector<int> collapsedRemap(const vector<int>& kept, const vector<int>& dropped, size_t count) {
+    vector<char> state(count, 0);
+    for (int i : dropped) {
+        if (i >= 0 && i < (int)count) state[i] = 1;
+    }
+    for (int i : kept) {
+        if (i >= 0 && i < (int)count) state[i] = 2;
+    }
+    vector<int> remap(count);
+    int next = 0;
+    for (size_t i = 0; i < count; ++i) remap[i] = state[i] == 1 ? ABSENT_INDEX : next++;
+    return remap;
+}
+
+static vector<int> remapStream(const vector<int>& stream, const vector<int>& remap) {
+    vector<int> result(stream);
+    for (int& i : result) {
+        if (i >= 0 && i < (int)remap.size()) i = remap[i];
+    }
+    return result;
+}
+
+static void remapValues(CCowArray<vec3>& values, const vector<int>& remap) {
+    if (values.size() != remap.size()) return;
+    vector<vec3>& data = values.edit();
+    size_t next = 0;
+    for (size_t i = 0; i < data.size(); ++i) {
+        if (remap[i] != ABSENT_INDEX) data[next++] = data[i];
+    }
+    data.resize(next);
+    data.shrink_to_fit();
+}
+
+void C3DFigure::compactFaces() {
+    CFacePool compacted;
+    CFacePool dropped;
+    compacted.reserve(faces.size());
+    for (auto& mesh : subMeshes) {
+        bool instance = mesh.instanceOf >= 0;
+        int first = (int)compacted.size();
+        for (int f = mesh.firstFace; f < mesh.firstFace + mesh.faceCount; ++f) {
+            if (instance) dropped.push(faces.get(f));
+            else compacted.push(faces.get(f));
+        }
+        if (!instance) mesh.firstFace = first;
+    }
+    for (auto& mesh : subMeshes) {
+        if (mesh.instanceOf < 0) continue;
+        mesh.firstFace = subMeshes[mesh.instanceOf].firstFace;
+        mesh.faceCount = subMeshes[mesh.instanceOf].faceCount;
+    }
+    if (dropped.empty()) {
+        faces = compacted;
+        return;
+    }
+
+    vector<int> vertexMap = collapsedRemap(compacted.getVertexStream(), dropped.getVertexStream(), vertices.size());
+    vector<int> textureMap = collapsedRemap(compacted.getTextureStream(), dropped.getTextureStream(), textures.size());
+    vector<int> normalMap = collapsedRemap(compacted.getNormalStream(), dropped.getNormalStream(), normals.size());
+    faces.assign(remapStream(compacted.getVertexStream(), vertexMap), remapStream(compacted.getTextureStream(), textureMap),
+                 remapStream(compacted.getNormalStream(), normalMap));
+    remapValues(vertexColors, vertexMap);
+    remapValues(vertices, vertexMap);
+    remapValues(textures, textureMap);
+    remapValues(normals, normalMap);
 }
 
 void C3DFigure::normalization() {
+    TRACE_ZONE("normalization");
     if (vertices.empty()) return;
 
-    float minX = vertices[0].x, maxX = vertices[0].x;
-    float minY = vertices[0].y, maxY = vertices[0].y;
-    float minZ = vertices[0].z, maxZ = vertices[0].z;
-
-    for (const auto& v : vertices) {
-        minX = std::min(minX, v.x); maxX = std::max(maxX, v.x);
-        minY = std::min(minY, v.y); maxY = std::max(maxY, v.y);
-        minZ = std::min(minZ, v.z); maxZ = std::max(maxZ, v.z);
+    vector<BoundingBox> localBoxes(subMeshes.size());
+    vector<bool> hasBox(subMeshes.size(), false);
+    for (size_t m = 0; m < subMeshes.size(); ++m) {
+        const SubMesh& mesh = subMeshes[m];
+        if (mesh.instanceOf >= 0) continue;
+        for (int f = mesh.firstFace; f < mesh.firstFace + mesh.faceCount; ++f) {
+            for (int i = 0; i < 3; ++i) {
+                int idx = faces.vertex(f, i);
+                if (idx < 0 || idx >= (int)vertices.size()) continue;
+                vec3 v = vertices[idx];
+                localBoxes[m].min = hasBox[m] ? glm::min(localBoxes[m].min, v) : v;
+                localBoxes[m].max = hasBox[m] ? glm::max(localBoxes[m].max, v) : v;
+                hasBox[m] = true;
+            }
+        }
     }
 
-    vec3 center = vec3((minX + maxX) / 2.0f, (minY + maxY) / 2.0f, (minZ + maxZ) / 2.0f);
+    vec3 boxMin(0.0f), boxMax(0.0f);
+    bool found = false;
+    for (size_t m = 0; m < subMeshes.size(); ++m) {
+        int source = subMeshes[m].instanceOf >= 0 ? subMeshes[m].instanceOf : (int)m;
+        if (!hasBox[source]) continue;
+        vec3 worldMin = localBoxes[source].min + subMeshes[m].instanceTranslation;
+        vec3 worldMax = localBoxes[source].max + subMeshes[m].instanceTranslation;
+        boxMin = found ? glm::min(boxMin, worldMin) : worldMin;
+        boxMax = found ? glm::max(boxMax, worldMax) : worldMax;
+        found = true;
+    }
+    if (!found) {
+        boxMin = boxMax = vertices[0];
+        for (const auto& v : vertices) {
+            boxMin = glm::min(boxMin, v);
+            boxMax = glm::max(boxMax, v);
+        }
+    }
 
-    float dx = maxX - minX;
-    float dy = maxY - minY;
-    float dz = maxZ - minZ;
-    float maxDim = max({dx, dy, dz});
+    vec3 center = (boxMin + boxMax) / 2.0f;
+    vec3 extent = boxMax - boxMin;
+    float maxDim = max({extent.x, extent.y, extent.z});
     float scaleFactor = (maxDim == 0) ? 1.0f : 1.0f / maxDim;
 
-    for (auto& v : vertices) {
+    for (auto& v : vertices.edit()) {
         v = (v - center) * scaleFactor;
     }
 
-    boundingBox.min = (vec3(minX, minY, minZ) - center) * scaleFactor;
-    boundingBox.max = (vec3(maxX, maxY, maxZ) - center) * scaleFactor;
+    boundingBox.min = (boxMin - center) * scaleFactor;
+    boundingBox.max = (boxMax - center) * scaleFactor;
 
-    for (auto& mesh : subMeshes) {
-        if (mesh.faces.empty()) continue;
-        
-        vec3 subMin = vertices[mesh.faces[0].vertexIndices[0]];
-        vec3 subMax = subMin;
+    for (size_t m = 0; m < subMeshes.size(); ++m) {
+        subMeshes[m].instanceTranslation *= scaleFactor;
+        localBoxes[m].min = (localBoxes[m].min - center) * scaleFactor;
+        localBoxes[m].max = (localBoxes[m].max - center) * scaleFactor;
+    }
 
-        for (const auto& face : mesh.faces) {
-            for (int i = 0; i < 3; ++i) {
-                int idx = face.vertexIndices[i];
-                if (idx < vertices.size()) {
-                    vec3 v = vertices[idx];
-                    subMin = glm::min(subMin, v);
-                    subMax = glm::max(subMax, v);
-                }
+    for (size_t m = 0; m < subMeshes.size(); ++m) {
+        SubMesh& mesh = subMeshes[m];
+        const BoundingBox& local = localBoxes[mesh.instanceOf >= 0 ? mesh.instanceOf : m];
+        mesh.bbox.min = local.min + mesh.instanceTranslation;
+        mesh.bbox.max = local.max + mesh.instanceTranslation;
+    }
+}
+
+vector<InstanceGroup> C3DFigure::getInstanceGroups() const {
+    vector<bool> hasInstances(subMeshes.size(), false);
+    for (const auto& mesh : subMeshes) {
+        if (mesh.instanceOf >= 0) hasInstances[mesh.instanceOf] = true;
+    }
+
+    vector<InstanceGroup> groups;
+    map<pair<int, string>, int> groupOf;
+    for (int i = 0; i < (int)subMeshes.size(); ++i) {
+        int root = subMeshes[i].instanceOf >= 0 ? subMeshes[i].instanceOf : i;
+        pair<int, string> key(root, materials[subMeshes[i].material].texturePath);
+
+        auto found = groupOf.find(key);
+        if (found == groupOf.end()) {
+            found = groupOf.insert(make_pair(key, (int)groups.size())).first;
+            groups.push_back(InstanceGroup());
+            groups.back().shared = hasInstances[root];
+        }
+        groups[found->second].subMeshIds.push_back(i);
+    }
+    return groups;
+}
+
+bool sameRenderState(const Material& a, const Material& b) {
+    return a.kd == b.kd && a.ka == b.ka && a.ks == b.ks && a.ns == b.ns &&
+           a.ni == b.ni && a.d == b.d && a.illum == b.illum && a.texturePath == b.texturePath;
+}
+
+void C3DFigure::buildMaterialBatches() {
+    batches.clear();
+
+    vector<bool> hasInstances(subMeshes.size(), false);
+    for (const auto& mesh : subMeshes) {
+        if (mesh.instanceOf >= 0) hasInstances[mesh.instanceOf] = true;
+    }
+
+    for (int i = 0; i < (int)subMeshes.size(); ++i) {
+        const SubMesh& mesh = subMeshes[i];
+        if (mesh.instanceOf >= 0 || hasInstances[i]) continue;
+
+        MaterialBatch* batch = nullptr;
+        for (auto& candidate : batches) {
+            if (candidate.color == mesh.color && sameRenderState(materials[candidate.material], materials[mesh.material])) {
+                batch = &candidate;
+                break;
             }
         }
-        mesh.bbox.min = subMin;
-        mesh.bbox.max = subMax;
+        if (!batch) {
+            batches.push_back(MaterialBatch());
+            batch = &batches.back();
+            batch->material = mesh.material;
+            batch->color = mesh.color;
+        }
+        batch->subMeshIds.push_back(i);
     }
 }
 
-vector<float> C3DFigure::flatten() {
+int C3DFigure::addMaterial(const Material& material) {
+    materials.push_back(material);
+    return (int)materials.size() - 1;
+}
+
+vector<float> C3DFigure::flatten(bool batchByMaterial) {
+    TRACE_ZONE("flatten");
     vector<float> data;
     int currentVertexOffset = 0; 
-    for (auto& mesh : subMeshes) {
+
+    auto emit = [&](SubMesh& mesh) {
         mesh.startVertex = currentVertexOffset;
         int count = 0;
 
-        for (const auto& face : mesh.faces) {
+        for (int f = mesh.firstFace; f < mesh.firstFace + mesh.faceCount; ++f) {
             for (int i = 0; i < 3; ++i) {
-                int vIdx = face.vertexIndices[i];
-                if (vIdx >= 0 && vIdx < vertices.size()) {
+                int vIdx = faces.vertex(f, i);
+                if (vIdx >= 0 && vIdx < (int)vertices.size()) {
                     data.push_back(vertices[vIdx].x);
                     data.push_back(vertices[vIdx].y);
                     data.push_back(vertices[vIdx].z);
-                    data.push_back(mesh.material.kd[0]);
-                    data.push_back(mesh.material.kd[1]);
-                    data.push_back(mesh.material.kd[2]);
+                    vec3 color = vIdx < (int)vertexColors.size() ? vertexColors[vIdx] : mesh.color;
+                    data.push_back(color.r);
+                    data.push_back(color.g);
+                    data.push_back(color.b);
+
+                    int tIdx = faces.texture(f, i);
+                    vec3 uv = (tIdx >= 0 && tIdx < (int)textures.size()) ? textures[tIdx] : vec3(0.0f);
+                    data.push_back(uv.x);
+                    data.push_back(uv.y);
                     count++;
                 }
             }
         }
         mesh.vertexCount = count;    
         currentVertexOffset += count; 
+    };
+
+    if (batchByMaterial) {
+        buildMaterialBatches();
+    } else {
+        batches.clear();
+    }
+
+    vector<bool> emitted(subMeshes.size(), false);
+    for (auto& batch : batches) {
+        batch.startVertex = currentVertexOffset;
+        for (int id : batch.subMeshIds) {
+            emit(subMeshes[id]);
+            emitted[id] = true;
+        }
+        batch.vertexCount = currentVertexOffset - batch.startVertex;
+    }
+
+    for (size_t i = 0; i < subMeshes.size(); ++i) {
+        if (subMeshes[i].instanceOf >= 0 || emitted[i]) continue;
+        emit(subMeshes[i]);
+    }
+
+    for (auto& mesh : subMeshes) {
+        if (mesh.instanceOf < 0) continue;
+        mesh.startVertex = subMeshes[mesh.instanceOf].startVertex;
+        mesh.vertexCount = subMeshes[mesh.instanceOf].vertexCount;
     }
     return data;
 }
@@ -287,6 +616,146 @@ BoundingBox C3DFigure::getBoundingBox(){
     return boundingBox;
 }
 
+void C3DFigure::releaseGeometry() {
+    vertices = CCowArray<vec3>();
+    normals = CCowArray<vec3>();
+    textures = CCowArray<vec3>();
+    vertexColors = CCowArray<vec3>();
+    faces.clear();
+    for (auto& mesh : subMeshes) {
+        mesh.firstFace = 0;
+        mesh.faceCount = 0;
+    }
+}
+
+struct GeometryCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t vertexCount;
+    uint64_t normalCount;
+    uint64_t textureCount;
+    uint64_t colorCount;
+    uint64_t vertexIndexCount;
+    uint64_t textureIndexCount;
+    uint64_t normalIndexCount;
+    uint64_t subMeshCount;
+};
+
+static const uint32_t GEOMETRY_CACHE_VERSION = 2;
+
+template <typename T>
+static bool writeArray(FILE* file, const vector<T>& items) {
+    return items.empty() || fwrite(items.data(), sizeof(T), items.size(), file) == items.size();
+}
+
+template <typename T>
+static bool readArray(FILE* file, vector<T>& data, uint64_t count) {
+    data.resize((size_t)count);
+    return data.empty() || fread(data.data(), sizeof(T), data.size(), file) == data.size();
+}
+
+bool C3DFigure::writeGeometryCache(const string& path) const {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+
+    GeometryCacheHeader header;
+    memcpy(header.magic, "GEO1", 4);
+    header.version = GEOMETRY_CACHE_VERSION;
+    header.vertexCount = vertices.size();
+    header.normalCount = normals.size();
+    header.textureCount = textures.size();
+    header.colorCount = vertexColors.size();
+    header.vertexIndexCount = faces.getVertexStream().size();
+    header.textureIndexCount = faces.getTextureStream().size();
+    header.normalIndexCount = faces.getNormalStream().size();
+    header.subMeshCount = subMeshes.size();
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && writeArray(file, vertices.get()) && writeArray(file, normals.get()) &&
+         writeArray(file, textures.get()) && writeArray(file, vertexColors.get());
+    ok = ok && writeArray(file, faces.getVertexStream()) && writeArray(file, faces.getTextureStream()) &&
+         writeArray(file, faces.getNormalStream());
+    for (const auto& mesh : subMeshes) {
+        int32_t range[2] = { mesh.firstFace, mesh.faceCount };
+        ok = ok && fwrite(range, sizeof(range), 1, file) == 1;
+    }
+    ok = (fclose(file) == 0) && ok;
+    if (!ok) remove(path.c_str());
+    return ok;
+}
+
+bool C3DFigure::readGeometryCache(const string& path) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+
+    GeometryCacheHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, "GEO1", 4) == 0 &&
+              header.version == GEOMETRY_CACHE_VERSION && header.subMeshCount == subMeshes.size();
+    ok = ok && readArray(file, vertices.edit(), header.vertexCount) && readArray(file, normals.edit(), header.normalCount) &&
+         readArray(file, textures.edit(), header.textureCount) && readArray(file, vertexColors.edit(), header.colorCount);
+
+    vector<int> vertexStream, textureStream, normalStream;
+    ok = ok && readArray(file, vertexStream, header.vertexIndexCount) && readArray(file, textureStream, header.textureIndexCount) &&
+         readArray(file, normalStream, header.normalIndexCount);
+    faces.assign(std::move(vertexStream), std::move(textureStream), std::move(normalStream));
+    for (auto& mesh : subMeshes) {
+        int32_t range[2] = { 0, 0 };
+        ok = ok && fread(range, sizeof(range), 1, file) == 1;
+        mesh.firstFace = range[0];
+        mesh.faceCount = range[1];
+    }
+    fclose(file);
+    if (!ok) releaseGeometry();
+    return ok;
+}
+
+bool C3DFigure::reloadGeometryFromSource() {
+    if (sourcePath.empty() || !sourceLayout) return false;
+
+    C3DFigure source;
+    if (!source.loadObject(sourcePath)) return false;
+    source.normalization();
+    if (source.subMeshes.size() != subMeshes.size()) return false;
+
+    vertices = source.vertices;
+    normals = source.normals;
+    textures = source.textures;
+    vertexColors = source.vertexColors;
+    faces = source.faces;
+    for (size_t i = 0; i < subMeshes.size(); ++i) {
+        subMeshes[i].firstFace = source.subMeshes[i].firstFace;
+        subMeshes[i].faceCount = source.subMeshes[i].faceCount;
+    }
+    return true;
+}
+
+bool C3DFigure::releaseCpuGeometry(const string& cachePath) {
+    if (geometryReleased) return true;
+    if (!geometryCached || geometryCachePath.empty()) {
+        if (geometryCachePath.empty()) geometryCachePath = cachePath;
+        geometryCached = writeGeometryCache(geometryCachePath);
+        if (!geometryCached && (!sourceLayout || sourcePath.empty())) return false;
+    }
+    releaseGeometry();
+    geometryReleased = true;
+    return true;
+}
+
+bool C3DFigure::ensureGeometry() {
+    if (!geometryReleased) return true;
+    bool ok = geometryCached && readGeometryCache(geometryCachePath);
+    if (!ok) {
+        LOG_WARNING(LOG_GEOMETRY, "Cache de geometria no disponible, releyendo %s", sourcePath.c_str());
+        ok = reloadGeometryFromSource();
+    }
+    if (ok) geometryReleased = false;
+    return ok;
+}
+
+size_t C3DFigure::getCpuBytes() const {
+    return (vertices.size() + normals.size() + textures.size() + vertexColors.size()) * sizeof(vec3) + faces.getBytes();
+}
+
 const vector<SubMesh>& C3DFigure::getSubMeshes() { 
     return subMeshes; 
 }
@@ -296,96 +765,1593 @@ vector<SubMesh>& C3DFigure::getSubMeshesModifiable() {
 }
 
 void C3DFigure::deleteSubMesh(int index) {
-    if (index >= 0 && index < subMeshes.size()) {
-        subMeshes.erase(subMeshes.begin() + index);
+    if (index < 0 || index >= (int)subMeshes.size()) return;
+    if (!ensureGeometry()) return;
+    geometryCached = false;
+    sourceLayout = false;
+
+    if (subMeshes[index].instanceOf < 0) {
+        int heir = -1;
+        for (int i = 0; i < (int)subMeshes.size(); ++i) {
+            if (subMeshes[i].instanceOf != index) continue;
+            if (heir == -1) {
+                heir = i;
+                subMeshes[i].firstChunk = subMeshes[index].firstChunk;
+                subMeshes[i].chunkCount = subMeshes[index].chunkCount;
+                subMeshes[i].instanceOf = -1;
+            } else {
+                subMeshes[i].instanceOf = heir;
+            }
+        }
+    }
+
+    subMeshes.erase(subMeshes.begin() + index);
+
+    for (auto& mesh : subMeshes) {
+        if (mesh.instanceOf > index) mesh.instanceOf--;
     }
+    compactFaces();
 }
 
-void C3DFigure::saveObject(string filename, vec3 globalPos, quat globalRot, vec3 scale) {
-    if (filename.empty()) return;
-    
-    string objName = filename;
-    if (objName.length() < 4 || objName.substr(objName.length() - 4) != ".obj") {
-        objName += ".obj";
+const vector<MaterialBatch>& C3DFigure::getMaterialBatches() const {
+    return batches;
+}
+
+int C3DFigure::getInstancedSubMeshCount() const {
+    int count = 0;
+    for (const auto& mesh : subMeshes) {
+        if (mesh.instanceOf >= 0) count++;
     }
-    
-    string mtlName = objName.substr(0, objName.length() - 4) + ".mtl";
-    string mtlSimpleName = mtlName;
-    size_t lastSlash = mtlName.find_last_of("/\\");
-    if (lastSlash != string::npos) {
-        mtlSimpleName = mtlName.substr(lastSlash + 1);
+    return count;
+}
+
+struct DenseRemap {
+    vector<int> index;
+    vector<uint32_t> stamp;
+    uint32_t generation = 0;
+    int base = 0;
+
+    void begin(int first, int last) {
+        base = first;
+        size_t count = last >= first ? (size_t)(last - first + 1) : 0;
+        if (index.size() < count) {
+            index.resize(count);
+            stamp.assign(count, 0);
+            generation = 0;
+        }
+        if (++generation == 0) {
+            std::fill(stamp.begin(), stamp.end(), 0);
+            generation = 1;
+        }
     }
 
-    ofstream objFile(objName);
-    ofstream mtlFile(mtlName);
-    
-    if (!objFile.is_open() || !mtlFile.is_open()) {
-        cout << "Error salvando archivo: " << objName << endl;
+    bool insert(int key, int value) {
+        key -= base;
+        if (stamp[key] == generation) return false;
+        stamp[key] = generation;
+        index[key] = value;
+        return true;
+    }
+
+    int operator[](int key) const { return index[key - base]; }
+};
+
+static DenseRemap& threadRemap() {
+    static thread_local DenseRemap remap;
+    return remap;
+}
+
+static vec3 normalScaleFor(vec3 scale) {
+    vec3 cofactor(scale.y * scale.z, scale.x * scale.z, scale.x * scale.y);
+    return scale.x * scale.y * scale.z < 0.0f ? -cofactor : cofactor;
+}
+
+static vec3 transformNormal(const vec3& normal, quat rotation, vec3 normalScale) {
+    vec3 n = rotation * (normal * normalScale);
+    float len = length(n);
+    return len > 0.0f ? n / len : vec3(0.0f, 1.0f, 0.0f);
+}
+
+static bool validFace(const CFacePool& faces, int face, size_t vertexCount) {
+    for (int k = 0; k < 3; ++k) {
+        int index = faces.vertex(face, k);
+        if (index < 0 || index >= (int)vertexCount) return false;
+    }
+    return true;
+}
+
+static void vertexRange(const CFacePool& faces, const SubMesh& mesh, size_t vertexCount, int& first, int& last) {
+    first = 0;
+    last = -1;
+    for (int f = mesh.firstFace; f < mesh.firstFace + mesh.faceCount; ++f) {
+        if (!validFace(faces, f, vertexCount)) continue;
+        for (int i = 0; i < 3; ++i) {
+            int index = faces.vertex(f, i);
+            if (last < first) first = last = index;
+            first = std::min(first, index);
+            last = std::max(last, index);
+        }
+    }
+}
+
+static bool cancelled(const SaveProgress* progress) {
+    return progress && progress->cancel;
+}
+
+static void tick(SaveProgress* progress) {
+    if (progress) progress->completed++;
+}
+
+static const size_t PARALLEL_SAVE_MIN_FACES = 50000;
+
+// The caller waits for helpers queued on the static pool: never call this from inside a task (one of the
+// pool's own workers), or every worker ends up waiting for helpers that can no longer run.
+static void parallelFor(size_t count, bool parallel, const function<void(size_t)>& task) {
+    if (!parallel || count < 2) {
+        for (size_t i = 0; i < count; ++i) task(i);
         return;
     }
 
-    mtlFile << "# Generated by 3DViewer" << endl;
-    
-    objFile << "# Generated by 3DViewer" << endl;
-    objFile << "mtllib " << mtlSimpleName << endl;
+    static CThreadPool pool;
+    atomic<size_t> next(0);
+    auto run = [&]() {
+        for (size_t i = next++; i < count; i = next++) task(i);
+    };
 
-    int vertexOffset = 1; 
-    
-    for (const auto& mesh : subMeshes) {
-        mtlFile << "newmtl " << mesh.groupName << endl;
-        mtlFile << "Ns " << mesh.material.ns << endl;
-        mtlFile << "Ka " << mesh.material.ka[0] << " " << mesh.material.ka[1] << " " << mesh.material.ka[2] << endl;
-        mtlFile << "Kd " << mesh.material.kd[0] << " " << mesh.material.kd[1] << " " << mesh.material.kd[2] << endl;
-        mtlFile << "Ks " << mesh.material.ks[0] << " " << mesh.material.ks[1] << " " << mesh.material.ks[2] << endl;
-        mtlFile << "Ni " << mesh.material.ni << endl;
-        mtlFile << "d " << mesh.material.d << endl;
-        mtlFile << "illum 2" << endl; 
-        if (!mesh.material.textureMap.empty()) {
-            mtlFile << "map_Kd " << mesh.material.textureMap << endl;
-        }
-        mtlFile << endl;
-
-        objFile << "usemtl " << mesh.groupName << endl;
-        
-        map<int, int> indexMap; 
-
-        for (const auto& face : mesh.faces) {
-            bool validFace = true;
-            for (int k = 0; k < 3; ++k) {
-                if (face.vertexIndices[k] < 0 || face.vertexIndices[k] >= vertices.size()) {
-                    validFace = false;
-                    break;
-                }
+    mutex doneMutex;
+    condition_variable done;
+    int pending = (int)std::min<size_t>(count - 1, (size_t)pool.getThreadCount());
+    for (int h = pending; h > 0; --h) {
+        pool.enqueue([&]() {
+            run();
+            lock_guard<mutex> lock(doneMutex);
+            if (--pending == 0) done.notify_one();
+        });
+    }
+    run();
+
+    unique_lock<mutex> lock(doneMutex);
+    done.wait(lock, [&]() { return pending == 0; });
+}
+
+void C3DFigure::buildCompactBody(vector<CTextWriter>& chunks, vec3 globalPos, quat globalRot, vec3 scale, SaveProgress* progress) const {
+    size_t meshCount = subMeshes.size();
+    size_t totalFaces = 0;
+    for (const auto& mesh : subMeshes) totalFaces += mesh.faceCount;
+    bool parallel = parallelSave && totalFaces >= PARALLEL_SAVE_MIN_FACES;
+    if (progress) progress->total = (int)meshCount * 3;
+
+    vector<int> uniqueCounts(meshCount, 0);
+    vector<pair<int, int>> ranges(meshCount);
+    parallelFor(meshCount, parallel, [&](size_t m) {
+        if (cancelled(progress)) return;
+        vertexRange(faces, subMeshes[m], vertices.size(), ranges[m].first, ranges[m].second);
+        DenseRemap& remap = threadRemap();
+        remap.begin(ranges[m].first, ranges[m].second);
+
+        int count = 0;
+        const SubMesh& mesh = subMeshes[m];
+        for (int f = mesh.firstFace; f < mesh.firstFace + mesh.faceCount; ++f) {
+            if (!validFace(faces, f, vertices.size())) continue;
+            for (int i = 0; i < 3; ++i) {
+                if (remap.insert(faces.vertex(f, i), count)) count++;
             }
-            if (!validFace) continue;
+        }
+        uniqueCounts[m] = count;
+        tick(progress);
+    });
+
+    vector<long long> baseIndex(meshCount, 1);
+    for (size_t m = 1; m < meshCount; ++m) baseIndex[m] = baseIndex[m - 1] + uniqueCounts[m - 1];
 
+    chunks.assign(meshCount, CTextWriter());
+    parallelFor(meshCount, parallel, [&](size_t m) {
+        if (cancelled(progress)) return;
+        const SubMesh& mesh = subMeshes[m];
+        int lastFace = mesh.firstFace + mesh.faceCount;
+        CTextWriter& out = chunks[m];
+        out.reserve((size_t)uniqueCounts[m] * 40 + (size_t)mesh.faceCount * 32 + mesh.groupName.size() + 8);
+
+        DenseRemap& remap = threadRemap();
+        remap.begin(ranges[m].first, ranges[m].second);
+
+        out.append("usemtl "); out.append(mesh.groupName); out.append('\n');
+
+        int count = 0;
+        for (int f = mesh.firstFace; f < lastFace; ++f) {
+            if (!validFace(faces, f, vertices.size())) continue;
             for (int i = 0; i < 3; ++i) {
-                int oldIdx = face.vertexIndices[i];
-                
-                if (indexMap.find(oldIdx) == indexMap.end()) {
-                    vec3 v = vertices[oldIdx];
-                    vec3 bakedV = v + mesh.offset; 
-                    bakedV = bakedV * scale; 
-                    bakedV = globalRot * bakedV; 
-                    bakedV += globalPos; 
-                    
-                    objFile << "v " << bakedV.x << " " << bakedV.y << " " << bakedV.z << endl;
-                    
-                    indexMap[oldIdx] = vertexOffset++;
-                }
+                int oldIdx = faces.vertex(f, i);
+                if (!remap.insert(oldIdx, count)) continue;
+                count++;
+
+                vec3 bakedV = vertices[oldIdx] + mesh.instanceTranslation + mesh.offset; 
+                bakedV = bakedV * scale; 
+                bakedV = globalRot * bakedV; 
+                bakedV += globalPos; 
+
+                out.append("v ");
+                out.appendFloat(bakedV.x); out.append(' ');
+                out.appendFloat(bakedV.y); out.append(' ');
+                out.appendFloat(bakedV.z); out.append('\n');
             }
+        }
 
-            objFile << "f";
+        for (int f = mesh.firstFace; f < lastFace; ++f) {
+            if (!validFace(faces, f, vertices.size())) continue;
+            out.append('f');
             for (int i = 0; i < 3; ++i) {
-                int oldIdx = face.vertexIndices[i];
-                int finalIdx = indexMap[oldIdx];
-                objFile << " " << finalIdx;
+                out.append(' ');
+                out.appendInt(baseIndex[m] + remap[faces.vertex(f, i)]);
             }
-            objFile << endl;
+            out.append('\n');
         }
+        tick(progress);
+    });
+}
+
+static void appendVec(CTextWriter& out, const char* tag, vec3 v, int components) {
+    out.append(tag);
+    for (int c = 0; c < components; ++c) {
+        out.append(' ');
+        out.appendFloat(v[c]);
     }
-    
-    objFile.close();
-    mtlFile.close();
-    cout << "Guardado exitoso: " << objName << endl;
-}
\ No newline at end of file
+    out.append('\n');
+}
+
+void C3DFigure::buildIndexedBody(vector<CTextWriter>& chunks, vec3 globalPos, quat globalRot, vec3 scale, SaveProgress* progress) const {
+    size_t meshCount = subMeshes.size();
+    size_t totalFaces = 0;
+    for (const auto& mesh : subMeshes) totalFaces += mesh.faceCount;
+    bool parallel = parallelSave && totalFaces >= PARALLEL_SAVE_MIN_FACES;
+    if (progress) progress->total = 1;
+
+    vector<vec3> translations;
+    vector<int> translationOf(meshCount);
+    vector<vector<int>> groupMeshes;
+    unordered_map<uint64_t, vector<int>> translationGroups;
+    for (size_t m = 0; m < meshCount; ++m) {
+        vec3 t = subMeshes[m].instanceTranslation + subMeshes[m].offset;
+        uint64_t key = 0;
+        for (int c = 0; c < 3; ++c) key = hashCombine(key, (uint64_t)llround((double)t[c] * 1e6));
+
+        vector<int>& candidates = translationGroups[key];
+        int group = -1;
+        for (int k : candidates) {
+            if (translations[k] == t) group = k;
+        }
+        if (group < 0) {
+            group = (int)translations.size();
+            candidates.push_back(group);
+            translations.push_back(t);
+            groupMeshes.emplace_back();
+        }
+        translationOf[m] = group;
+        groupMeshes[group].push_back((int)m);
+    }
+
+    vector<vector<int>> cornerV(meshCount), cornerT(meshCount), cornerN(meshCount);
+    vector<int> usedVertices, usedVertexGroup;
+    vector<int> textureRemap(textures.size(), -1), normalRemap(normals.size(), -1);
+    vector<int> usedTextures, usedNormals;
+
+    vector<pair<int, int>> groupRanges(translations.size(), make_pair(0, -1));
+    for (size_t m = 0; m < meshCount; ++m) {
+        int first, last;
+        vertexRange(faces, subMeshes[m], vertices.size(), first, last);
+        if (last < first) continue;
+        pair<int, int>& range = groupRanges[translationOf[m]];
+        if (range.second < range.first) range = make_pair(first, last);
+        range.first = std::min(range.first, first);
+        range.second = std::max(range.second, last);
+    }
+
+    DenseRemap& remap = threadRemap();
+    for (size_t g = 0; g < translations.size(); ++g) {
+        remap.begin(groupRanges[g].first, groupRanges[g].second);
+        for (int m : groupMeshes[g]) {
+            if (cancelled(progress)) return;
+            const SubMesh& mesh = subMeshes[m];
+            cornerV[m].reserve((size_t)mesh.faceCount * 3);
+            cornerT[m].reserve((size_t)mesh.faceCount * 3);
+            cornerN[m].reserve((size_t)mesh.faceCount * 3);
+
+            for (int f = mesh.firstFace; f < mesh.firstFace + mesh.faceCount; ++f) {
+                if (!validFace(faces, f, vertices.size())) continue;
+                for (int i = 0; i < 3; ++i) {
+                    int v = faces.vertex(f, i);
+                    if (remap.insert(v, (int)usedVertices.size())) {
+                        usedVertices.push_back(v);
+                        usedVertexGroup.push_back((int)g);
+                    }
+                    cornerV[m].push_back(remap[v]);
+
+                    int t = faces.texture(f, i);
+                    if (t >= 0 && t < (int)textures.size()) {
+                        if (textureRemap[t] < 0) {
+                            textureRemap[t] = (int)usedTextures.size();
+                            usedTextures.push_back(t);
+                        }
+                        cornerT[m].push_back(textureRemap[t]);
+                    } else {
+                        cornerT[m].push_back(-1);
+                    }
+
+                    int n = faces.normal(f, i);
+                    if (n >= 0 && n < (int)normals.size()) {
+                        if (normalRemap[n] < 0) {
+                            normalRemap[n] = (int)usedNormals.size();
+                            usedNormals.push_back(n);
+                        }
+                        cornerN[m].push_back(normalRemap[n]);
+                    } else {
+                        cornerN[m].push_back(-1);
+                    }
+                }
+            }
+        }
+    }
+
+    const size_t linesPerChunk = 65536;
+    size_t vChunks = (usedVertices.size() + linesPerChunk - 1) / linesPerChunk;
+    size_t tChunks = (usedTextures.size() + linesPerChunk - 1) / linesPerChunk;
+    size_t nChunks = (usedNormals.size() + linesPerChunk - 1) / linesPerChunk;
+    size_t attributeChunks = vChunks + tChunks + nChunks;
+
+    vec3 normalScale = normalScaleFor(scale);
+    chunks.assign(attributeChunks + meshCount, CTextWriter());
+    if (progress) {
+        progress->total = 1 + (int)chunks.size() * 2;
+        progress->completed = 1;
+    }
+
+    parallelFor(attributeChunks + meshCount, parallel, [&](size_t c) {
+        if (cancelled(progress)) return;
+        CTextWriter& out = chunks[c];
+        if (c < vChunks) {
+            size_t begin = c * linesPerChunk;
+            size_t end = std::min(begin + linesPerChunk, usedVertices.size());
+            out.reserve((end - begin) * 40);
+            for (size_t i = begin; i < end; ++i) {
+                vec3 bakedV = vertices[usedVertices[i]] + translations[usedVertexGroup[i]];
+                bakedV = bakedV * scale;
+                bakedV = globalRot * bakedV;
+                bakedV += globalPos;
+                appendVec(out, "v", bakedV, 3);
+            }
+            tick(progress);
+            return;
+        }
+        c -= vChunks;
+        if (c < tChunks) {
+            size_t begin = c * linesPerChunk;
+            size_t end = std::min(begin + linesPerChunk, usedTextures.size());
+            out.reserve((end - begin) * 28);
+            for (size_t i = begin; i < end; ++i) {
+                appendVec(out, "vt", textures[usedTextures[i]], 2);
+            }
+            tick(progress);
+            return;
+        }
+        c -= tChunks;
+        if (c < nChunks) {
+            size_t begin = c * linesPerChunk;
+            size_t end = std::min(begin + linesPerChunk, usedNormals.size());
+            out.reserve((end - begin) * 40);
+            for (size_t i = begin; i < end; ++i) {
+                appendVec(out, "vn", transformNormal(normals[usedNormals[i]], globalRot, normalScale), 3);
+            }
+            tick(progress);
+            return;
+        }
+        c -= nChunks;
+
+        const SubMesh& mesh = subMeshes[c];
+        const vector<int>& cv = cornerV[c];
+        const vector<int>& ct = cornerT[c];
+        const vector<int>& cn = cornerN[c];
+        out.reserve(cv.size() * 24 + mesh.groupName.size() + 8);
+
+        out.append("usemtl "); out.append(mesh.groupName); out.append('\n');
+        for (size_t i = 0; i < cv.size(); i += 3) {
+            out.append('f');
+            for (size_t k = i; k < i + 3; ++k) {
+                out.append(' ');
+                out.appendInt(cv[k] + 1);
+                if (ct[k] < 0 && cn[k] < 0) continue;
+                out.append('/');
+                if (ct[k] >= 0) out.appendInt(ct[k] + 1);
+                if (cn[k] < 0) continue;
+                out.append('/');
+                out.appendInt(cn[k] + 1);
+            }
+            out.append('\n');
+        }
+        tick(progress);
+    });
+}
+
+void C3DFigure::appendMaterialLibrary(CTextWriter& mtl) const {
+    mtl.append("# Generated by 3DViewer\n");
+    for (const auto& mesh : subMeshes) {
+        const Material& m = materials[mesh.material];
+        mtl.append("newmtl "); mtl.append(mesh.groupName); mtl.append('\n');
+        mtl.append("Ns "); mtl.appendFloat(m.ns); mtl.append('\n');
+        mtl.append("Ka "); mtl.appendFloat(m.ka[0]); mtl.append(' '); mtl.appendFloat(m.ka[1]); mtl.append(' '); mtl.appendFloat(m.ka[2]); mtl.append('\n');
+        mtl.append("Kd "); mtl.appendFloat(mesh.color[0]); mtl.append(' '); mtl.appendFloat(mesh.color[1]); mtl.append(' '); mtl.appendFloat(mesh.color[2]); mtl.append('\n');
+        mtl.append("Ks "); mtl.appendFloat(m.ks[0]); mtl.append(' '); mtl.appendFloat(m.ks[1]); mtl.append(' '); mtl.appendFloat(m.ks[2]); mtl.append('\n');
+        mtl.append("Ni "); mtl.appendFloat(m.ni); mtl.append('\n');
+        mtl.append("d "); mtl.appendFloat(m.d); mtl.append('\n');
+        mtl.append("illum 2\n");
+        if (!m.textureMap.empty()) {
+            mtl.append("map_Kd "); mtl.append(m.textureMap); mtl.append('\n');
+        }
+        mtl.append('\n');
+    }
+}
+
+bool C3DFigure::saveObject(string filename, vec3 globalPos, quat globalRot, vec3 scale, bool fullFidelity, SaveProgress* progress) const {
+    TRACE_ZONE("saveObject");
+    if (filename.empty()) return false;
+    
+    string objName = filename;
+    if (objName.length() < 4 || objName.substr(objName.length() - 4) != ".obj") {
+        objName += ".obj";
+    }
+    
+    string mtlName = objName.substr(0, objName.length() - 4) + ".mtl";
+    string mtlSimpleName = mtlName;
+    size_t lastSlash = mtlName.find_last_of("/\\");
+    if (lastSlash != string::npos) {
+        mtlSimpleName = mtlName.substr(lastSlash + 1);
+    }
+
+    FILE* objFile = fopen(objName.c_str(), "wb");
+    FILE* mtlFile = fopen(mtlName.c_str(), "wb");
+    
+    if (!objFile || !mtlFile) {
+        if (objFile) fclose(objFile);
+        if (mtlFile) fclose(mtlFile);
+        LOG_ERROR(LOG_IO, "Error salvando archivo: %s", objName.c_str());
+        return false;
+    }
+
+    CTextWriter mtl;
+    appendMaterialLibrary(mtl);
+
+    vector<CTextWriter> chunks;
+    if (fullFidelity) buildIndexedBody(chunks, globalPos, globalRot, scale, progress);
+    else buildCompactBody(chunks, globalPos, globalRot, scale, progress);
+
+    CTextWriter header;
+    header.append("# Generated by 3DViewer\n");
+    header.append("mtllib "); header.append(mtlSimpleName); header.append('\n');
+
+    bool ok = !cancelled(progress) && header.writeTo(objFile);
+    for (const auto& chunk : chunks) {
+        if (!ok || cancelled(progress)) break;
+        ok = chunk.writeTo(objFile);
+        tick(progress);
+    }
+    ok = ok && !cancelled(progress) && mtl.writeTo(mtlFile);
+    ok = (fclose(objFile) == 0) && ok;
+    ok = (fclose(mtlFile) == 0) && ok;
+
+    if (cancelled(progress)) {
+        remove(objName.c_str());
+        remove(mtlName.c_str());
+        LOG_INFO(LOG_IO, "Guardado cancelado: %s", objName.c_str());
+        return false;
+    }
+    if (!ok) {
+        LOG_ERROR(LOG_IO, "Error salvando archivo: %s", objName.c_str());
+        return false;
+    }
+    LOG_INFO(LOG_IO, "Guardado exitoso: %s", objName.c_str());
+    return true;
+}
+
+static const uint32_t GLB_MAGIC = 0x46546C67;
+static const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+static const uint32_t GLB_CHUNK_BIN = 0x004E4942;
+static const int GL_FLOAT_COMPONENT = 5126;
+static const int GL_UNSIGNED_BYTE_COMPONENT = 5121;
+static const int GL_UNSIGNED_SHORT_COMPONENT = 5123;
+static const int GL_UNSIGNED_INT_COMPONENT = 5125;
+
+static_assert(sizeof(vec3) == 3 * sizeof(float), "vec3 must be tightly packed");
+
+bool hasExtension(const string& path, const string& extension) {
+    if (path.size() < extension.size()) return false;
+    for (size_t i = 0; i < extension.size(); ++i) {
+        char c = path[path.size() - extension.size() + i];
+        if (tolower((unsigned char)c) != tolower((unsigned char)extension[i])) return false;
+    }
+    return true;
+}
+
+static void appendJsonVec(CTextWriter& out, const float* values, int count) {
+    out.append('[');
+    for (int i = 0; i < count; ++i) {
+        if (i > 0) out.append(',');
+        out.appendFloat(values[i]);
+    }
+    out.append(']');
+}
+
+struct GlbCorner {
+    int v, t, n;
+    bool operator==(const GlbCorner& other) const { return v == other.v && t == other.t && n == other.n; }
+};
+
+struct GlbCornerHash {
+    size_t operator()(const GlbCorner& c) const {
+        return (size_t)hashCombine(hashCombine((uint64_t)(uint32_t)c.v, (uint64_t)(uint32_t)c.t), (uint64_t)(uint32_t)c.n);
+    }
+};
+
+bool C3DFigure::saveGlb(string filename, vec3 globalPos, quat globalRot, vec3 scale, SaveProgress* progress) const {
+    TRACE_ZONE("saveGlb");
+    if (filename.empty()) return false;
+    if (!hasExtension(filename, ".glb")) filename += ".glb";
+    if (progress) progress->total = 2;
+
+    vec3 normalScale = normalScaleFor(scale);
+    vector<vec3> positions, outNormals;
+    vector<float> uvs;
+    vector<uint32_t> indices;
+    vector<size_t> indexStart(subMeshes.size(), 0), indexCount(subMeshes.size(), 0);
+    bool hasUV = false;
+
+    unordered_map<GlbCorner, uint32_t, GlbCornerHash> corners;
+    for (size_t m = 0; m < subMeshes.size(); ++m) {
+        const SubMesh& mesh = subMeshes[m];
+        if (mesh.instanceOf >= 0) continue;
+        if (cancelled(progress)) return false;
+
+        indexStart[m] = indices.size();
+        for (int f = mesh.firstFace; f < mesh.firstFace + mesh.faceCount; ++f) {
+            if (!validFace(faces, f, vertices.size())) continue;
+            for (int i = 0; i < 3; ++i) {
+                GlbCorner corner = { faces.vertex(f, i), faces.texture(f, i), faces.normal(f, i) };
+                if (corner.t < 0 || corner.t >= (int)textures.size()) corner.t = -1;
+                if (corner.n < 0 || corner.n >= (int)normals.size()) corner.n = -1;
+
+                auto found = corners.find(corner);
+                if (found == corners.end()) {
+                    uint32_t index = (uint32_t)positions.size();
+                    found = corners.emplace(corner, index).first;
+
+                    positions.push_back(globalRot * (vertices[corner.v] * scale) + globalPos);
+
+                    outNormals.push_back(corner.n >= 0 ? transformNormal(normals[corner.n], globalRot, normalScale) : vec3(0.0f, 1.0f, 0.0f));
+
+                    if (corner.t >= 0) hasUV = true;
+                    vec3 uv = corner.t >= 0 ? textures[corner.t] : vec3(0.0f);
+                    uvs.push_back(uv.x);
+                    uvs.push_back(1.0f - uv.y);
+                }
+                indices.push_back(found->second);
+            }
+        }
+        indexCount[m] = indices.size() - indexStart[m];
+    }
+
+    vec3 minPos(0.0f), maxPos(0.0f);
+    if (!positions.empty()) {
+        minPos = maxPos = positions[0];
+        for (const auto& p : positions) {
+            minPos = glm::min(minPos, p);
+            maxPos = glm::max(maxPos, p);
+        }
+    }
+
+    size_t positionBytes = positions.size() * sizeof(vec3);
+    size_t normalBytes = outNormals.size() * sizeof(vec3);
+    size_t uvBytes = hasUV ? uvs.size() * sizeof(float) : 0;
+    size_t indexBytes = indices.size() * sizeof(uint32_t);
+    size_t binBytes = positionBytes + normalBytes + uvBytes + indexBytes;
+
+    int positionAccessor = 0, normalAccessor = 1, uvAccessor = hasUV ? 2 : -1;
+    int firstIndexAccessor = hasUV ? 3 : 2;
+    int indexView = hasUV ? 3 : 2;
+
+    vector<int> materialOf(subMeshes.size(), -1);
+    vector<int> materialSource;
+    for (size_t m = 0; m < subMeshes.size(); ++m) {
+        size_t k = 0;
+        while (k < materialSource.size() && (subMeshes[materialSource[k]].material != subMeshes[m].material ||
+                                             subMeshes[materialSource[k]].color != subMeshes[m].color)) k++;
+        if (k == materialSource.size()) materialSource.push_back((int)m);
+        materialOf[m] = (int)k;
+    }
+
+    vector<string> images;
+    vector<int> textureOf(materialSource.size(), -1);
+    for (size_t k = 0; k < materialSource.size(); ++k) {
+        const string& map = materials[subMeshes[materialSource[k]].material].textureMap;
+        if (map.empty()) continue;
+        size_t i = 0;
+        while (i < images.size() && images[i] != map) i++;
+        if (i == images.size()) images.push_back(map);
+        textureOf[k] = (int)i;
+    }
+
+    vector<int> indexAccessorOf(subMeshes.size(), -1);
+    vector<int> prototypes;
+    for (size_t m = 0; m < subMeshes.size(); ++m) {
+        if (subMeshes[m].instanceOf >= 0 || indexCount[m] == 0) continue;
+        indexAccessorOf[m] = firstIndexAccessor + (int)prototypes.size();
+        prototypes.push_back((int)m);
+    }
+
+    vector<int> meshOf(subMeshes.size(), -1);
+    int meshCount = 0;
+    for (size_t m = 0; m < subMeshes.size(); ++m) {
+        int source = subMeshes[m].instanceOf >= 0 ? subMeshes[m].instanceOf : (int)m;
+        if (indexAccessorOf[source] >= 0) meshOf[m] = meshCount++;
+    }
+
+    CTextWriter json;
+    json.append("{\"asset\":{\"version\":\"2.0\",\"generator\":\"3DViewer\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],");
+
+    json.append("\"nodes\":[{\"name\":\"root\"");
+    if (!subMeshes.empty()) {
+        json.append(",\"children\":[");
+        for (size_t m = 0; m < subMeshes.size(); ++m) {
+            if (m > 0) json.append(',');
+            json.appendInt((long long)m + 1);
+        }
+        json.append(']');
+    }
+    json.append('}');
+    for (size_t m = 0; m < subMeshes.size(); ++m) {
+        const SubMesh& mesh = subMeshes[m];
+        vec3 translation = globalRot * ((mesh.instanceTranslation + mesh.offset) * scale);
+        json.append(",{\"name\":");
+        json.appendQuoted(mesh.groupName.c_str());
+        if (meshOf[m] >= 0) {
+            json.append(",\"mesh\":");
+            json.appendInt(meshOf[m]);
+        }
+        if (translation != vec3(0.0f)) {
+            json.append(",\"translation\":");
+            appendJsonVec(json, &translation.x, 3);
+        }
+        json.append('}');
+    }
+    json.append("],");
+
+    json.append("\"meshes\":[");
+    for (size_t m = 0; m < subMeshes.size(); ++m) {
+        if (meshOf[m] < 0) continue;
+        int source = subMeshes[m].instanceOf >= 0 ? subMeshes[m].instanceOf : (int)m;
+        if (meshOf[m] > 0) json.append(',');
+        json.append("{\"name\":");
+        json.appendQuoted(subMeshes[m].groupName.c_str());
+        json.append(",\"primitives\":[{\"attributes\":{\"POSITION\":");
+        json.appendInt(positionAccessor);
+        json.append(",\"NORMAL\":");
+        json.appendInt(normalAccessor);
+        if (hasUV) {
+            json.append(",\"TEXCOORD_0\":");
+            json.appendInt(uvAccessor);
+        }
+        json.append("},\"indices\":");
+        json.appendInt(indexAccessorOf[source]);
+        json.append(",\"material\":");
+        json.appendInt(materialOf[m]);
+        json.append(",\"mode\":4}]}");
+    }
+    json.append("],");
+
+    json.append("\"materials\":[");
+    for (size_t k = 0; k < materialSource.size(); ++k) {
+        int m = materialSource[k];
+        const Material& mat = materials[subMeshes[m].material];
+        vec3 color = subMeshes[m].color;
+        float alpha = mat.d > 0.0f ? mat.d : 1.0f;
+        float baseColor[4] = { color[0], color[1], color[2], alpha };
+        float roughness = sqrt(2.0f / (std::max(mat.ns, 0.0f) + 2.0f));
+
+        if (k > 0) json.append(',');
+        json.append("{\"name\":");
+        json.appendQuoted((mat.name.empty() ? subMeshes[m].groupName : mat.name).c_str());
+        json.append(",\"pbrMetallicRoughness\":{\"baseColorFactor\":");
+        appendJsonVec(json, baseColor, 4);
+        json.append(",\"metallicFactor\":0,\"roughnessFactor\":");
+        json.appendFloat(roughness);
+        if (textureOf[k] >= 0) {
+            json.append(",\"baseColorTexture\":{\"index\":");
+            json.appendInt(textureOf[k]);
+            json.append('}');
+        }
+        json.append('}');
+        if (alpha < 1.0f) json.append(",\"alphaMode\":\"BLEND\"");
+        json.append(",\"extras\":{\"ka\":");
+        appendJsonVec(json, &mat.ka.x, 3);
+        json.append(",\"ks\":");
+        appendJsonVec(json, &mat.ks.x, 3);
+        json.append(",\"ns\":"); json.appendFloat(mat.ns);
+        json.append(",\"ni\":"); json.appendFloat(mat.ni);
+        json.append(",\"d\":"); json.appendFloat(mat.d);
+        json.append(",\"illum\":"); json.appendFloat(mat.illum);
+        json.append("}}");
+    }
+    json.append("],");
+
+    if (!images.empty()) {
+        json.append("\"samplers\":[{\"magFilter\":9729,\"minFilter\":9987,\"wrapS\":10497,\"wrapT\":10497}],\"images\":[");
+        for (size_t i = 0; i < images.size(); ++i) {
+            if (i > 0) json.append(',');
+            json.append("{\"uri\":");
+            json.appendQuoted(images[i].c_str());
+            json.append('}');
+        }
+        json.append("],\"textures\":[");
+        for (size_t i = 0; i < images.size(); ++i) {
+            if (i > 0) json.append(',');
+            json.append("{\"sampler\":0,\"source\":");
+            json.appendInt((long long)i);
+            json.append('}');
+        }
+        json.append("],");
+    }
+
+    json.append("\"accessors\":[{\"bufferView\":0,\"componentType\":");
+    json.appendInt(GL_FLOAT_COMPONENT);
+    json.append(",\"count\":");
+    json.appendInt((long long)positions.size());
+    json.append(",\"type\":\"VEC3\",\"min\":");
+    appendJsonVec(json, &minPos.x, 3);
+    json.append(",\"max\":");
+    appendJsonVec(json, &maxPos.x, 3);
+    json.append("},{\"bufferView\":1,\"componentType\":");
+    json.appendInt(GL_FLOAT_COMPONENT);
+    json.append(",\"count\":");
+    json.appendInt((long long)outNormals.size());
+    json.append(",\"type\":\"VEC3\"}");
+    if (hasUV) {
+        json.append(",{\"bufferView\":2,\"componentType\":");
+        json.appendInt(GL_FLOAT_COMPONENT);
+        json.append(",\"count\":");
+        json.appendInt((long long)positions.size());
+        json.append(",\"type\":\"VEC2\"}");
+    }
+    for (int m : prototypes) {
+        json.append(",{\"bufferView\":");
+        json.appendInt(indexView);
+        json.append(",\"byteOffset\":");
+        json.appendInt((long long)(indexStart[m] * sizeof(uint32_t)));
+        json.append(",\"componentType\":");
+        json.appendInt(GL_UNSIGNED_INT_COMPONENT);
+        json.append(",\"count\":");
+        json.appendInt((long long)indexCount[m]);
+        json.append(",\"type\":\"SCALAR\"}");
+    }
+    json.append("],");
+
+    size_t offset = 0;
+    json.append("\"bufferViews\":[");
+    json.append("{\"buffer\":0,\"byteOffset\":0,\"byteLength\":");
+    json.appendInt((long long)positionBytes);
+    json.append(",\"target\":34962}");
+    offset += positionBytes;
+    json.append(",{\"buffer\":0,\"byteOffset\":");
+    json.appendInt((long long)offset);
+    json.append(",\"byteLength\":");
+    json.appendInt((long long)normalBytes);
+    json.append(",\"target\":34962}");
+    offset += normalBytes;
+    if (hasUV) {
+        json.append(",{\"buffer\":0,\"byteOffset\":");
+        json.appendInt((long long)offset);
+        json.append(",\"byteLength\":");
+        json.appendInt((long long)uvBytes);
+        json.append(",\"target\":34962}");
+        offset += uvBytes;
+    }
+    json.append(",{\"buffer\":0,\"byteOffset\":");
+    json.appendInt((long long)offset);
+    json.append(",\"byteLength\":");
+    json.appendInt((long long)indexBytes);
+    json.append(",\"target\":34963}],");
+
+    json.append("\"buffers\":[{\"byteLength\":");
+    json.appendInt((long long)binBytes);
+    json.append("}]}");
+    while (json.size() % 4 != 0) json.append(' ');
+    tick(progress);
+
+    if (cancelled(progress)) return false;
+
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (!file) {
+        LOG_ERROR(LOG_IO, "Error salvando archivo: %s", filename.c_str());
+        return false;
+    }
+
+    uint32_t jsonLength = (uint32_t)json.size();
+    uint32_t binLength = (uint32_t)binBytes;
+    uint32_t totalLength = 12 + 8 + jsonLength + 8 + binLength;
+    uint32_t header[5] = { GLB_MAGIC, 2, totalLength, jsonLength, GLB_CHUNK_JSON };
+    uint32_t binHeader[2] = { binLength, GLB_CHUNK_BIN };
+
+    bool ok = fwrite(header, sizeof(header), 1, file) == 1;
+    ok = ok && json.writeTo(file);
+    ok = ok && fwrite(binHeader, sizeof(binHeader), 1, file) == 1;
+    if (positionBytes) ok = ok && fwrite(positions.data(), positionBytes, 1, file) == 1;
+    if (normalBytes) ok = ok && fwrite(outNormals.data(), normalBytes, 1, file) == 1;
+    if (uvBytes) ok = ok && fwrite(uvs.data(), uvBytes, 1, file) == 1;
+    if (indexBytes) ok = ok && fwrite(indices.data(), indexBytes, 1, file) == 1;
+    ok = (fclose(file) == 0) && ok;
+    tick(progress);
+
+    if (!ok) {
+        LOG_ERROR(LOG_IO, "Error salvando archivo: %s", filename.c_str());
+        return false;
+    }
+    LOG_INFO(LOG_IO, "Guardado exitoso: %s", filename.c_str());
+    return true;
+}
+
+struct GlbAccessor {
+    const unsigned char* data = nullptr;
+    size_t count = 0;
+    size_t stride = 0;
+    int componentType = 0;
+};
+
+static int componentSize(int componentType) {
+    switch (componentType) {
+    case GL_UNSIGNED_BYTE_COMPONENT: return 1;
+    case GL_UNSIGNED_SHORT_COMPONENT: return 2;
+    case GL_UNSIGNED_INT_COMPONENT:
+    case GL_FLOAT_COMPONENT: return 4;
+    default: return 0;
+    }
+}
+
+static int componentCount(const string& type) {
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4") return 4;
+    return 0;
+}
+
+static bool resolveAccessor(const CJsonValue& gltf, int index, int components, const unsigned char* bin, size_t binSize, GlbAccessor& out) {
+    const CJsonValue& accessor = gltf["accessors"][(size_t)index];
+    if (!accessor.isObject() || componentCount(accessor["type"].asString()) != components) return false;
+
+    const CJsonValue& view = gltf["bufferViews"][(size_t)accessor["bufferView"].asInt(-1)];
+    if (!view.isObject() || view["buffer"].asInt(0) != 0) return false;
+
+    out.componentType = accessor["componentType"].asInt();
+    int elementSize = componentSize(out.componentType) * components;
+    if (elementSize == 0) return false;
+
+    out.count = (size_t)accessor["count"].asNumber();
+    out.stride = (size_t)view["byteStride"].asInt(0);
+    if (out.stride == 0) out.stride = elementSize;
+
+    size_t start = (size_t)view["byteOffset"].asNumber() + (size_t)accessor["byteOffset"].asNumber();
+    size_t viewEnd = (size_t)view["byteOffset"].asNumber() + (size_t)view["byteLength"].asNumber();
+    if (viewEnd > binSize) return false;
+    if (out.count > 0 && start + (out.count - 1) * out.stride + elementSize > viewEnd) return false;
+
+    out.data = bin + start;
+    return true;
+}
+
+static mat4 nodeMatrix(const CJsonValue& node) {
+    const CJsonValue& matrix = node["matrix"];
+    if (matrix.isArray() && matrix.size() == 16) {
+        mat4 result;
+        for (int c = 0; c < 4; ++c) {
+            for (int r = 0; r < 4; ++r) result[c][r] = (float)matrix[(size_t)(c * 4 + r)].asNumber();
+        }
+        return result;
+    }
+
+    vec3 translation(0.0f), scaling(1.0f);
+    quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+    const CJsonValue& t = node["translation"];
+    const CJsonValue& r = node["rotation"];
+    const CJsonValue& s = node["scale"];
+    if (t.size() == 3) translation = vec3((float)t[0].asNumber(), (float)t[1].asNumber(), (float)t[2].asNumber());
+    if (r.size() == 4) rotation = quat((float)r[3].asNumber(), (float)r[0].asNumber(), (float)r[1].asNumber(), (float)r[2].asNumber());
+    if (s.size() == 3) scaling = vec3((float)s[0].asNumber(1.0), (float)s[1].asNumber(1.0), (float)s[2].asNumber(1.0));
+
+    mat4 result = glm::translate(mat4(1.0f), translation) * glm::mat4_cast(rotation);
+    return glm::scale(result, scaling);
+}
+
+static bool isTranslationOnly(const mat4& m) {
+    const float eps = 1e-6f;
+    for (int c = 0; c < 3; ++c) {
+        for (int r = 0; r < 3; ++r) {
+            if (fabs(m[c][r] - (c == r ? 1.0f : 0.0f)) > eps) return false;
+        }
+    }
+    return true;
+}
+
+static Material materialFromGltf(const CJsonValue& gltf, int index, const string& dir) {
+    Material material;
+    const CJsonValue& source = gltf["materials"][(size_t)index];
+    if (!source.isObject()) return material;
+
+    material.name = source["name"].asString();
+    material.d = 1.0f;
+    const CJsonValue& pbr = source["pbrMetallicRoughness"];
+    const CJsonValue& color = pbr["baseColorFactor"];
+    if (color.size() == 4) {
+        material.kd = vec3((float)color[0].asNumber(), (float)color[1].asNumber(), (float)color[2].asNumber());
+        material.d = (float)color[3].asNumber(1.0);
+    } else {
+        material.kd = vec3(1.0f);
+    }
+    float roughness = (float)pbr["roughnessFactor"].asNumber(1.0);
+    material.ns = roughness > 0.0f ? 2.0f / (roughness * roughness) - 2.0f : 1000.0f;
+
+    const CJsonValue& extras = source["extras"];
+    if (extras.isObject()) {
+        const CJsonValue& ka = extras["ka"];
+        const CJsonValue& ks = extras["ks"];
+        if (ka.size() == 3) material.ka = vec3((float)ka[0].asNumber(), (float)ka[1].asNumber(), (float)ka[2].asNumber());
+        if (ks.size() == 3) material.ks = vec3((float)ks[0].asNumber(), (float)ks[1].asNumber(), (float)ks[2].asNumber());
+        material.ns = (float)extras["ns"].asNumber(material.ns);
+        material.ni = (float)extras["ni"].asNumber(material.ni);
+        material.d = (float)extras["d"].asNumber(material.d);
+        material.illum = (float)extras["illum"].asNumber(material.illum);
+    }
+
+    const CJsonValue& texture = pbr["baseColorTexture"];
+    if (texture.isObject()) {
+        int image = gltf["textures"][(size_t)texture["index"].asInt(-1)]["source"].asInt(-1);
+        const string& uri = gltf["images"][(size_t)image]["uri"].asString();
+        if (!uri.empty() && uri.compare(0, 5, "data:") != 0) {
+            material.textureMap = uri;
+            material.texturePath = dir + uri;
+        }
+    }
+    return material;
+}
+
+bool C3DFigure::loadGlb(string path) {
+    CMappedFile file;
+    if (!file.open(path)) {
+        LOG_ERROR(LOG_IO, "Error abriendo el archivo: %s", path.c_str());
+        return false;
+    }
+
+    const unsigned char* data = file.getData();
+    size_t size = file.getSize();
+    uint32_t header[5];
+    if (size < sizeof(header)) {
+        LOG_ERROR(LOG_IO, "Archivo GLB invalido: %s", path.c_str());
+        return false;
+    }
+    memcpy(header, data, sizeof(header));
+    if (header[0] != GLB_MAGIC || header[1] != 2 || header[4] != GLB_CHUNK_JSON || 20 + (size_t)header[3] > size) {
+        LOG_ERROR(LOG_IO, "Archivo GLB invalido: %s", path.c_str());
+        return false;
+    }
+
+    CJsonValue gltf;
+    if (!CJsonValue::parse((const char*)data + 20, header[3], gltf)) {
+        LOG_ERROR(LOG_IO, "JSON invalido en GLB: %s", path.c_str());
+        return false;
+    }
+
+    const unsigned char* bin = nullptr;
+    size_t binSize = 0;
+    size_t binChunk = 20 + (((size_t)header[3] + 3) & ~(size_t)3);
+    if (binChunk + 8 <= size) {
+        uint32_t chunk[2];
+        memcpy(chunk, data + binChunk, sizeof(chunk));
+        if (chunk[1] == GLB_CHUNK_BIN && binChunk + 8 + chunk[0] <= size) {
+            bin = data + binChunk + 8;
+            binSize = chunk[0];
+        }
+    }
+
+    string dir = "";
+    size_t lastSlash = path.find_last_of("/\\");
+    if (lastSlash != string::npos) dir = path.substr(0, lastSlash + 1);
+
+    map<int, int> positionBase, normalBase, uvBase;
+    map<pair<int, int>, int> prototypeOf;
+    map<int, int> materialOf;
+
+    auto loadPositions = [&](int accessorIndex, const GlbAccessor& accessor, const mat4* transform) -> int {
+        if (!transform) {
+            auto found = positionBase.find(accessorIndex);
+            if (found != positionBase.end()) return found->second;
+        }
+
+        vector<vec3>& out = vertices.edit();
+        int base = (int)out.size();
+        out.resize(out.size() + accessor.count);
+        if (!transform && accessor.stride == sizeof(vec3)) {
+            memcpy(&out[base], accessor.data, accessor.count * sizeof(vec3));
+        } else {
+            for (size_t i = 0; i < accessor.count; ++i) {
+                vec3 p;
+                memcpy(&p, accessor.data + i * accessor.stride, sizeof(vec3));
+                out[base + i] = transform ? vec3(*transform * vec4(p, 1.0f)) : p;
+            }
+        }
+        if (!transform) positionBase[accessorIndex] = base;
+        return base;
+    };
+
+    auto loadNormals = [&](int accessorIndex, const mat4* transform) -> int {
+        if (!transform) {
+            auto found = normalBase.find(accessorIndex);
+            if (found != normalBase.end()) return found->second;
+        }
+        GlbAccessor accessor;
+        if (!resolveAccessor(gltf, accessorIndex, 3, bin, binSize, accessor) || accessor.componentType != GL_FLOAT_COMPONENT) return -1;
+
+        vector<vec3>& out = normals.edit();
+        int base = (int)out.size();
+        out.resize(out.size() + accessor.count);
+        if (!transform && accessor.stride == sizeof(vec3)) {
+            memcpy(&out[base], accessor.data, accessor.count * sizeof(vec3));
+        } else {
+            mat3 normalMatrix = transform ? transpose(inverse(mat3(*transform))) : mat3(1.0f);
+            for (size_t i = 0; i < accessor.count; ++i) {
+                vec3 n;
+                memcpy(&n, accessor.data + i * accessor.stride, sizeof(vec3));
+                n = normalMatrix * n;
+                float len = length(n);
+                out[base + i] = len > 0.0f ? n / len : n;
+            }
+        }
+        if (!transform) normalBase[accessorIndex] = base;
+        return base;
+    };
+
+    auto loadUVs = [&](int accessorIndex) -> int {
+        auto found = uvBase.find(accessorIndex);
+        if (found != uvBase.end()) return found->second;
+        GlbAccessor accessor;
+        if (!resolveAccessor(gltf, accessorIndex, 2, bin, binSize, accessor) || accessor.componentType != GL_FLOAT_COMPONENT) return -1;
+
+        vector<vec3>& out = textures.edit();
+        int base = (int)out.size();
+        out.resize(out.size() + accessor.count);
+        for (size_t i = 0; i < accessor.count; ++i) {
+            float uv[2];
+            memcpy(uv, accessor.data + i * accessor.stride, sizeof(uv));
+            out[base + i] = vec3(uv[0], 1.0f - uv[1], 0.0f);
+        }
+        uvBase[accessorIndex] = base;
+        return base;
+    };
+
+    auto loadPrimitive = [&](const CJsonValue& primitive, const mat4& world, const string& name) {
+        if (primitive["mode"].asInt(4) != 4) return;
+        const CJsonValue& attributes = primitive["attributes"];
+        int positionAccessor = attributes["POSITION"].asInt(-1);
+        if (positionAccessor < 0) return;
+        int indexAccessor = primitive["indices"].asInt(-1);
+
+        SubMesh mesh;
+        mesh.groupName = name;
+        int gltfMaterial = primitive["material"].asInt(-1);
+        auto material = materialOf.find(gltfMaterial);
+        if (material == materialOf.end()) material = materialOf.emplace(gltfMaterial, addMaterial(materialFromGltf(gltf, gltfMaterial, dir))).first;
+        mesh.material = material->second;
+        mesh.color = materials[mesh.material].kd;
+
+        bool translationOnly = isTranslationOnly(world);
+        pair<int, int> key(positionAccessor, indexAccessor);
+        if (translationOnly) {
+            mesh.instanceTranslation = vec3(world[3]);
+            auto found = prototypeOf.find(key);
+            if (found != prototypeOf.end()) {
+                mesh.instanceOf = found->second;
+                mesh.firstFace = subMeshes[found->second].firstFace;
+                mesh.faceCount = subMeshes[found->second].faceCount;
+                subMeshes.push_back(mesh);
+                return;
+            }
+        }
+
+        GlbAccessor positions;
+        if (!resolveAccessor(gltf, positionAccessor, 3, bin, binSize, positions) || positions.componentType != GL_FLOAT_COMPONENT) return;
+
+        const mat4* transform = translationOnly ? nullptr : &world;
+        int vCount = (int)positions.count;
+        int vBase = loadPositions(positionAccessor, positions, transform);
+
+        int nBase = attributes.has("NORMAL") ? loadNormals(attributes["NORMAL"].asInt(), transform) : -1;
+        int tBase = attributes.has("TEXCOORD_0") ? loadUVs(attributes["TEXCOORD_0"].asInt()) : -1;
+
+        vector<uint32_t> corners;
+        if (indexAccessor >= 0) {
+            GlbAccessor indices;
+            if (!resolveAccessor(gltf, indexAccessor, 1, bin, binSize, indices)) return;
+            if (indices.componentType != GL_UNSIGNED_BYTE_COMPONENT && indices.componentType != GL_UNSIGNED_SHORT_COMPONENT &&
+                indices.componentType != GL_UNSIGNED_INT_COMPONENT) {
+                LOG_WARNING(LOG_IO, "Indices con componentType %d no soportado en %s", indices.componentType, name.c_str());
+                return;
+            }
+            corners.resize(indices.count);
+            for (size_t i = 0; i < indices.count; ++i) {
+                const unsigned char* p = indices.data + i * indices.stride;
+                if (indices.componentType == GL_UNSIGNED_INT_COMPONENT) {
+                    memcpy(&corners[i], p, sizeof(uint32_t));
+                } else if (indices.componentType == GL_UNSIGNED_SHORT_COMPONENT) {
+                    uint16_t value;
+                    memcpy(&value, p, sizeof(value));
+                    corners[i] = value;
+                } else {
+                    corners[i] = *p;
+                }
+            }
+        } else {
+            corners.resize(vCount);
+            for (int i = 0; i < vCount; ++i) corners[i] = (uint32_t)i;
+        }
+
+        if (nBase < 0) {
+            vector<vec3>& out = normals.edit();
+            nBase = (int)out.size();
+            out.resize(out.size() + vCount, vec3(0.0f));
+            for (size_t i = 0; i + 2 < corners.size(); i += 3) {
+                if (corners[i] >= (uint32_t)vCount || corners[i + 1] >= (uint32_t)vCount || corners[i + 2] >= (uint32_t)vCount) continue;
+                vec3 v0 = vertices[vBase + corners[i]];
+                vec3 faceNormal = cross(vertices[vBase + corners[i + 1]] - v0, vertices[vBase + corners[i + 2]] - v0);
+                for (int k = 0; k < 3; ++k) out[nBase + corners[i + k]] += faceNormal;
+            }
+            for (int i = nBase; i < (int)out.size(); ++i) {
+                if (length(out[i]) > 0.0f) out[i] = normalize(out[i]);
+            }
+        }
+
+        mesh.firstFace = (int)faces.size();
+        for (size_t i = 0; i + 2 < corners.size(); i += 3) {
+            if (corners[i] >= (uint32_t)vCount || corners[i + 1] >= (uint32_t)vCount || corners[i + 2] >= (uint32_t)vCount) continue;
+            FaceElement face;
+            for (int k = 0; k < 3; ++k) {
+                int local = (int)corners[i + k];
+                face.vertexIndices[k] = vBase + local;
+                face.normalIndices[k] = nBase + local;
+                face.textureIndices[k] = tBase >= 0 ? tBase + local : ABSENT_INDEX;
+            }
+            faces.push(face);
+            mesh.faceCount++;
+        }
+
+        if (translationOnly) prototypeOf[key] = (int)subMeshes.size();
+        subMeshes.push_back(mesh);
+    };
+
+    function<void(int, const mat4&, int)> visit = [&](int nodeIndex, const mat4& parent, int depth) {
+        const CJsonValue& node = gltf["nodes"][(size_t)nodeIndex];
+        if (!node.isObject() || depth > 64) return;
+        mat4 world = parent * nodeMatrix(node);
+
+        int meshIndex = node["mesh"].asInt(-1);
+        const CJsonValue& mesh = gltf["meshes"][(size_t)meshIndex];
+        if (mesh.isObject()) {
+            string name = node["name"].asString();
+            if (name.empty()) name = mesh["name"].asString();
+            if (name.empty()) name = "mesh_" + to_string(meshIndex);
+
+            const CJsonValue& primitives = mesh["primitives"];
+            for (size_t p = 0; p < primitives.size(); ++p) {
+                loadPrimitive(primitives[p], world, primitives.size() > 1 ? name + "_" + to_string(p) : name);
+            }
+        }
+
+        const CJsonValue& children = node["children"];
+        for (size_t c = 0; c < children.size(); ++c) visit(children[c].asInt(-1), world, depth + 1);
+    };
+
+    const CJsonValue& scene = gltf["scenes"][(size_t)gltf["scene"].asInt(0)];
+    if (scene.isObject()) {
+        const CJsonValue& roots = scene["nodes"];
+        for (size_t i = 0; i < roots.size(); ++i) visit(roots[i].asInt(-1), mat4(1.0f), 0);
+    } else {
+        const CJsonValue& nodes = gltf["nodes"];
+        vector<bool> isChild(nodes.size(), false);
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            const CJsonValue& children = nodes[i]["children"];
+            for (size_t c = 0; c < children.size(); ++c) {
+                int child = children[c].asInt(-1);
+                if (child >= 0 && child < (int)isChild.size()) isChild[child] = true;
+            }
+        }
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            if (!isChild[i]) visit((int)i, mat4(1.0f), 0);
+        }
+    }
+
+    if (subMeshes.empty()) {
+        LOG_ERROR(LOG_IO, "El archivo GLB no contiene mallas: %s", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+enum class PlyType { Invalid, Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+struct PlyProperty {
+    string name;
+    PlyType type = PlyType::Invalid;
+    PlyType countType = PlyType::Invalid;
+    bool isList = false;
+    size_t offset = 0;
+};
+
+struct PlyElement {
+    string name;
+    size_t count = 0;
+    vector<PlyProperty> properties;
+    size_t fixedSize = 0;
+    bool hasList = false;
+
+    int find(const string& property) const {
+        for (size_t i = 0; i < properties.size(); ++i) {
+            if (properties[i].name == property) return (int)i;
+        }
+        return -1;
+    }
+};
+
+static PlyType plyType(const string& name) {
+    if (name == "char" || name == "int8") return PlyType::Int8;
+    if (name == "uchar" || name == "uint8") return PlyType::UInt8;
+    if (name == "short" || name == "int16") return PlyType::Int16;
+    if (name == "ushort" || name == "uint16") return PlyType::UInt16;
+    if (name == "int" || name == "int32") return PlyType::Int32;
+    if (name == "uint" || name == "uint32") return PlyType::UInt32;
+    if (name == "float" || name == "float32") return PlyType::Float32;
+    if (name == "double" || name == "float64") return PlyType::Float64;
+    return PlyType::Invalid;
+}
+
+static size_t plySize(PlyType type) {
+    switch (type) {
+    case PlyType::Int8: case PlyType::UInt8: return 1;
+    case PlyType::Int16: case PlyType::UInt16: return 2;
+    case PlyType::Int32: case PlyType::UInt32: case PlyType::Float32: return 4;
+    case PlyType::Float64: return 8;
+    default: return 0;
+    }
+}
+
+static double plyRead(const unsigned char* p, PlyType type) {
+    switch (type) {
+    case PlyType::Int8: return (double)*(const int8_t*)p;
+    case PlyType::UInt8: return (double)*p;
+    case PlyType::Int16: { int16_t v; memcpy(&v, p, 2); return v; }
+    case PlyType::UInt16: { uint16_t v; memcpy(&v, p, 2); return v; }
+    case PlyType::Int32: { int32_t v; memcpy(&v, p, 4); return v; }
+    case PlyType::UInt32: { uint32_t v; memcpy(&v, p, 4); return v; }
+    case PlyType::Float32: { float v; memcpy(&v, p, 4); return v; }
+    case PlyType::Float64: { double v; memcpy(&v, p, 8); return v; }
+    default: return 0.0;
+    }
+}
+
+class CPlySource {
+    CMappedFile mapping;
+    FILE* file = nullptr;
+    const unsigned char* mapped = nullptr;
+    size_t mappedSize = 0;
+    size_t position = 0;
+
+    vector<unsigned char> window;
+    size_t windowBegin = 0;
+    size_t windowEnd = 0;
+
+public:
+    static const size_t WINDOW_BYTES = 4 * 1024 * 1024;
+
+    ~CPlySource() {
+        if (file) fclose(file);
+    }
+
+    bool open(const string& path) {
+        if (mapping.open(path)) {
+            mapped = mapping.getData();
+            mappedSize = mapping.getSize();
+            return true;
+        }
+        file = fopen(path.c_str(), "rb");
+        if (!file) return false;
+        window.resize(WINDOW_BYTES);
+        return true;
+    }
+
+    bool isMapped() const { return mapped != nullptr; }
+
+    const unsigned char* take(size_t bytes) {
+        if (mapped) {
+            if (bytes > mappedSize - position) return nullptr;
+            const unsigned char* p = mapped + position;
+            position += bytes;
+            return p;
+        }
+
+        if (windowEnd - windowBegin < bytes) {
+            size_t remaining = windowEnd - windowBegin;
+            memmove(window.data(), window.data() + windowBegin, remaining);
+            windowBegin = 0;
+            windowEnd = remaining;
+            if (window.size() < bytes) window.resize(bytes);
+            windowEnd += fread(window.data() + windowEnd, 1, window.size() - windowEnd, file);
+            if (windowEnd < bytes) return nullptr;
+        }
+        const unsigned char* p = window.data() + windowBegin;
+        windowBegin += bytes;
+        return p;
+    }
+
+    bool readLine(string& line) {
+        line.clear();
+        while (true) {
+            const unsigned char* c = take(1);
+            if (!c) return !line.empty();
+            if (*c == '\n') break;
+            if (*c != '\r') line += (char)*c;
+        }
+        return true;
+    }
+
+    size_t batchFor(size_t count, size_t stride) const {
+        if (mapped || stride == 0) return count;
+        return std::max<size_t>(1, WINDOW_BYTES / stride);
+    }
+};
+
+static bool parsePlyHeader(CPlySource& source, vector<PlyElement>& elements, string& format) {
+    string line;
+    if (!source.readLine(line) || line != "ply") return false;
+
+    while (source.readLine(line)) {
+        stringstream ss(line);
+        string keyword;
+        ss >> keyword;
+
+        if (keyword == "format") {
+            ss >> format;
+        } else if (keyword == "element") {
+            PlyElement element;
+            ss >> element.name >> element.count;
+            elements.push_back(element);
+        } else if (keyword == "property") {
+            if (elements.empty()) return false;
+            PlyElement& element = elements.back();
+            PlyProperty property;
+            string type;
+            ss >> type;
+            if (type == "list") {
+                string countType, itemType;
+                ss >> countType >> itemType >> property.name;
+                property.isList = true;
+                property.countType = plyType(countType);
+                property.type = plyType(itemType);
+                if (property.countType == PlyType::Invalid) return false;
+                element.hasList = true;
+            } else {
+                ss >> property.name;
+                property.type = plyType(type);
+                property.offset = element.fixedSize;
+                element.fixedSize += plySize(property.type);
+            }
+            if (property.type == PlyType::Invalid) return false;
+            element.properties.push_back(property);
+        } else if (keyword == "end_header") {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool skipPlyElement(CPlySource& source, const PlyElement& element) {
+    if (!element.hasList) {
+        size_t batch = source.batchFor(element.count, element.fixedSize);
+        for (size_t done = 0; done < element.count; done += batch) {
+            size_t n = std::min(batch, element.count - done);
+            if (n * element.fixedSize > 0 && !source.take(n * element.fixedSize)) return false;
+        }
+        return true;
+    }
+
+    for (size_t i = 0; i < element.count; ++i) {
+        for (const auto& property : element.properties) {
+            size_t count = 1;
+            if (property.isList) {
+                const unsigned char* p = source.take(plySize(property.countType));
+                if (!p) return false;
+                count = (size_t)plyRead(p, property.countType);
+            }
+            if (!source.take(count * plySize(property.type))) return false;
+        }
+    }
+    return true;
+}
+
+bool C3DFigure::loadPly(string path) {
+    CPlySource source;
+    if (!source.open(path)) {
+        LOG_ERROR(LOG_IO, "Error abriendo el archivo: %s", path.c_str());
+        return false;
+    }
+
+    vector<PlyElement> elements;
+    string format;
+    if (!parsePlyHeader(source, elements, format)) {
+        LOG_ERROR(LOG_IO, "Cabecera PLY invalida: %s", path.c_str());
+        return false;
+    }
+    if (format != "binary_little_endian") {
+        LOG_ERROR(LOG_IO, "Formato PLY no soportado (%s), se requiere binary_little_endian", format.c_str());
+        return false;
+    }
+
+    SubMesh mesh;
+    string name = path;
+    size_t lastSlash = name.find_last_of("/\\");
+    if (lastSlash != string::npos) name = name.substr(lastSlash + 1);
+    mesh.groupName = name.substr(0, name.find_last_of('.'));
+
+    bool hasNormals = false;
+    bool hasColors = false;
+
+    for (const auto& element : elements) {
+        if (element.name == "vertex" && !element.hasList) {
+            int x = element.find("x"), y = element.find("y"), z = element.find("z");
+            if (x < 0 || y < 0 || z < 0) {
+                LOG_ERROR(LOG_IO, "El PLY no tiene coordenadas x/y/z");
+                return false;
+            }
+            int nx = element.find("nx"), ny = element.find("ny"), nz = element.find("nz");
+            int r = element.find("red"), g = element.find("green"), b = element.find("blue");
+            hasNormals = nx >= 0 && ny >= 0 && nz >= 0;
+            hasColors = r >= 0 && g >= 0 && b >= 0;
+
+            const PlyProperty& px = element.properties[x];
+            bool packedFloats = px.type == PlyType::Float32 && px.offset == 0 &&
+                                element.properties[y].type == PlyType::Float32 && element.properties[y].offset == 4 &&
+                                element.properties[z].type == PlyType::Float32 && element.properties[z].offset == 8;
+            bool packedNormals = hasNormals && element.properties[nx].type == PlyType::Float32 &&
+                                 element.properties[ny].offset == element.properties[nx].offset + 4 &&
+                                 element.properties[nz].offset == element.properties[nx].offset + 8 &&
+                                 element.properties[ny].type == PlyType::Float32 && element.properties[nz].type == PlyType::Float32;
+            float colorScale = hasColors && element.properties[r].type == PlyType::UInt8 ? 1.0f / 255.0f : 1.0f;
+
+            vector<vec3>& outVertices = vertices.edit();
+            vector<vec3>* outNormals = hasNormals ? &normals.edit() : nullptr;
+            vector<vec3>* outColors = hasColors ? &vertexColors.edit() : nullptr;
+            size_t base = outVertices.size();
+            outVertices.resize(base + element.count);
+            if (outNormals) outNormals->resize(base + element.count);
+            if (outColors) outColors->resize(base + element.count);
+
+            size_t stride = element.fixedSize;
+            size_t batch = source.batchFor(element.count, stride);
+            for (size_t done = 0; done < element.count; done += batch) {
+                size_t n = std::min(batch, element.count - done);
+                const unsigned char* block = source.take(n * stride);
+                if (!block) {
+                    LOG_ERROR(LOG_IO, "Archivo PLY truncado: %s", path.c_str());
+                    return false;
+                }
+
+                vec3* dst = &outVertices[base + done];
+                if (packedFloats && stride == sizeof(vec3)) {
+                    memcpy(dst, block, n * sizeof(vec3));
+                } else {
+                    for (size_t i = 0; i < n; ++i) {
+                        const unsigned char* p = block + i * stride;
+                        if (packedFloats) {
+                            memcpy(&dst[i], p, sizeof(vec3));
+                        } else {
+                            dst[i] = vec3((float)plyRead(p + px.offset, px.type),
+                                          (float)plyRead(p + element.properties[y].offset, element.properties[y].type),
+                                          (float)plyRead(p + element.properties[z].offset, element.properties[z].type));
+                        }
+                    }
+                }
+
+                if (outNormals) {
+                    vec3* normalDst = &(*outNormals)[base + done];
+                    for (size_t i = 0; i < n; ++i) {
+                        const unsigned char* p = block + i * stride;
+                        if (packedNormals) {
+                            memcpy(&normalDst[i], p + element.properties[nx].offset, sizeof(vec3));
+                        } else {
+                            normalDst[i] = vec3((float)plyRead(p + element.properties[nx].offset, element.properties[nx].type),
+                                                (float)plyRead(p + element.properties[ny].offset, element.properties[ny].type),
+                                                (float)plyRead(p + element.properties[nz].offset, element.properties[nz].type));
+                        }
+                    }
+                }
+
+                if (outColors) {
+                    vec3* colorDst = &(*outColors)[base + done];
+                    for (size_t i = 0; i < n; ++i) {
+                        const unsigned char* p = block + i * stride;
+                        colorDst[i] = vec3((float)plyRead(p + element.properties[r].offset, element.properties[r].type),
+                                           (float)plyRead(p + element.properties[g].offset, element.properties[g].type),
+                                           (float)plyRead(p + element.properties[b].offset, element.properties[b].type)) * colorScale;
+                    }
+                }
+            }
+        } else if (element.name == "face") {
+            int list = element.find("vertex_indices");
+            if (list < 0) list = element.find("vertex_index");
+            if (list < 0 || !element.properties[list].isList) {
+                if (!skipPlyElement(source, element)) return false;
+                continue;
+            }
+
+            mesh.firstFace = (int)faces.size() - mesh.faceCount;
+            faces.reserve(faces.size() + element.count);
+            int vertexCount = (int)vertices.size();
+            vector<int> polygon;
+
+            for (size_t f = 0; f < element.count; ++f) {
+                polygon.clear();
+                for (int k = 0; k < (int)element.properties.size(); ++k) {
+                    const PlyProperty& property = element.properties[k];
+                    size_t count = 1;
+                    if (property.isList) {
+                        const unsigned char* p = source.take(plySize(property.countType));
+                        if (!p) return false;
+                        count = (size_t)plyRead(p, property.countType);
+                    }
+                    size_t itemSize = plySize(property.type);
+                    const unsigned char* items = source.take(count * itemSize);
+                    if (!items && count > 0) {
+                        LOG_ERROR(LOG_IO, "Archivo PLY truncado: %s", path.c_str());
+                        return false;
+                    }
+                    if (k != list) continue;
+
+                    polygon.resize(count);
+                    if (property.type == PlyType::Int32 || property.type == PlyType::UInt32) {
+                        memcpy(polygon.data(), items, count * sizeof(int));
+                    } else {
+                        for (size_t i = 0; i < count; ++i) polygon[i] = (int)plyRead(items + i * itemSize, property.type);
+                    }
+                }
+
+                for (size_t i = 1; i + 1 < polygon.size(); ++i) {
+                    int a = polygon[0], b = polygon[i], c = polygon[i + 1];
+                    if (a < 0 || b < 0 || c < 0 || a >= vertexCount || b >= vertexCount || c >= vertexCount) continue;
+                    FaceElement face = {
+                        { a, b, c },
+                        { ABSENT_INDEX, ABSENT_INDEX, ABSENT_INDEX },
+                        { a, b, c }
+                    };
+                    faces.push(face);
+                    mesh.faceCount++;
+                }
+            }
+        } else {
+            if (!skipPlyElement(source, element)) {
+                LOG_ERROR(LOG_IO, "Archivo PLY truncado: %s", path.c_str());
+                return false;
+            }
+        }
+    }
+
+    if (vertices.empty()) {
+        LOG_ERROR(LOG_IO, "El archivo PLY no contiene vertices: %s", path.c_str());
+        return false;
+    }
+
+    if (hasColors) mesh.color = vec3(1.0f);
+    if (mesh.faceCount > 0) subMeshes.push_back(mesh);
+    if (!hasNormals && !subMeshes.empty()) generateNormals();
+    return true;
+}
@@ -9,6 +9,10 @@
 #include <map>
 #include <sstream>
 #include <fstream>
+#include "TextWriter.h"
+#include "CowArray.h"
+#include "FacePool.h"
+#include <atomic>
 
 using namespace std;
 using namespace glm;
@@ -19,19 +23,15 @@ struct RGBA {
 
 struct Material{
     string name;
-    float ns;
-    vec3 ka;
+    float ns = 0.0f;
+    vec3 ka = vec3(0.0f);
     vec3 kd = {0.7f, 0.7f, 0.7f};
-    vec3 ks;
-    float ni, d;
-    float illum;
+    vec3 ks = vec3(0.0f);
+    float ni = 0.0f, d = 0.0f;
+    float illum = 0.0f;
     string textureMap;
-};
-
-struct FaceElement{
-    int vertexIndices[3];
-    int textureIndices[3];
-    int normalIndices[3];
+    string texturePath;
+    int textureSlot = -1;
 };
 
 struct BoundingBox {
@@ -41,8 +41,10 @@ struct BoundingBox {
 
 struct SubMesh{
     string groupName;
-    Material material;
-    vector<FaceElement> faces;
+    int material = 0;
+    vec3 color = vec3(0.7f);
+    int firstFace = 0;
+    int faceCount = 0;
 
     int startVertex = 0;
     int vertexCount = 0;
@@ -50,6 +52,12 @@ struct SubMesh{
     vec3 offset = vec3(0.0f); 
     BoundingBox bbox;
 
+    int instanceOf = -1;
+    vec3 instanceTranslation = vec3(0.0f);
+
+    int firstChunk = -1;
+    int chunkCount = 0;
+
     bool showVertices = false;
     RGBA vertexColor = {255, 0, 0, 255};
     float vertexSize = 5.0f;
@@ -64,27 +72,97 @@ struct SubMesh{
     float normalLengthPercent = 0.05f;
 };
 
+struct MaterialBatch {
+    int material = 0;
+    vec3 color = vec3(0.7f);
+    vector<int> subMeshIds;
+    int startVertex = 0;
+    int vertexCount = 0;
+};
+
+struct InstanceGroup {
+    vector<int> subMeshIds;
+    bool shared = false;
+};
+
+bool sameRenderState(const Material& a, const Material& b);
+bool hasExtension(const string& path, const string& extension);
+
+struct SaveProgress {
+    atomic<int> completed{0};
+    atomic<int> total{0};
+    atomic<bool> cancel{false};
+    atomic<bool> finished{false};
+    atomic<bool> success{false};
+};
+
 class C3DFigure {
-    vector<vec3> vertices;
-    vector<vec3> normals;
-    vector<vec3> textures;
+    CCowArray<vec3> vertices;
+    CCowArray<vec3> normals;
+    CCowArray<vec3> textures;
+    CCowArray<vec3> vertexColors;
+    CFacePool faces;
+    vector<Material> materials;
     vector<SubMesh> subMeshes;
+    vector<MaterialBatch> batches;
 
     BoundingBox boundingBox;
 
+    string sourcePath;
+    string geometryCachePath;
+    bool geometryReleased = false;
+    bool geometryCached = false;
+    bool sourceLayout = true;
+    bool parallelSave = true;
+
+    void detectInstances();
+    void compactFaces();
+    void buildMaterialBatches();
+    int addMaterial(const Material& material);
+    void buildCompactBody(vector<CTextWriter>& chunks, vec3 globalPos, quat globalRot, vec3 scale, SaveProgress* progress) const;
+    void buildIndexedBody(vector<CTextWriter>& chunks, vec3 globalPos, quat globalRot, vec3 scale, SaveProgress* progress) const;
+    bool writeGeometryCache(const string& path) const;
+    bool readGeometryCache(const string& path);
+    bool reloadGeometryFromSource();
+
 public:
     C3DFigure();
     ~C3DFigure();
 
     bool loadObject(string path);
     bool loadMtl(string path, map<string, Material>& materialMap);
+    bool loadGlb(string path);
+    bool loadPly(string path);
+    void generateNormals();
     void normalization();
     BoundingBox getBoundingBox();
-    vector<float> flatten();
+    void setBoundingBox(const BoundingBox& box) { boundingBox = box; }
+    void releaseGeometry();
+    bool releaseCpuGeometry(const string& cachePath);
+    bool ensureGeometry();
+    bool isGeometryReleased() const { return geometryReleased; }
+    void setParallelSave(bool enabled) { parallelSave = enabled; }
+    size_t getCpuBytes() const;
+    const string& getSourcePath() const { return sourcePath; }
+    const string& getGeometryCachePath() const { return geometryCachePath; }
+    vector<float> flatten(bool batchByMaterial = false);
     const vector<SubMesh>& getSubMeshes();
     vector<SubMesh>& getSubMeshesModifiable();
     void deleteSubMesh(int index);
-    const vector<vec3>& getVertices() const { return vertices; }
-    const vector<vec3>& getNormals() const { return normals; }
-    void saveObject(string path, glm::vec3 pos, glm::quat rot, glm::vec3 scale);
+    const CFacePool& getFaces() const { return faces; }
+    const vector<Material>& getMaterials() const { return materials; }
+    vector<Material>& getMaterialsModifiable() { return materials; }
+    const Material& getMaterial(const SubMesh& mesh) const { return materials[mesh.material]; }
+    const vector<MaterialBatch>& getMaterialBatches() const;
+    vector<InstanceGroup> getInstanceGroups() const;
+    int getInstancedSubMeshCount() const;
+    const vector<vec3>& getVertices() const { return vertices.get(); }
+    const vector<vec3>& getNormals() const { return normals.get(); }
+    const vector<vec3>& getTextures() const { return textures.get(); }
+    const vector<vec3>& getVertexColors() const { return vertexColors.get(); }
+    bool hasVertexColors() const { return !vertexColors.empty(); }
+    bool isPointCloud() const { return subMeshes.empty() && !vertices.empty(); }
+    void appendMaterialLibrary(CTextWriter& mtl) const;
+    bool saveObject(string path, glm::vec3 pos, glm::quat rot, glm::vec3 scale, bool fullFidelity = false, SaveProgress* progress = nullptr) const;
+    bool saveGlb(string path, glm::vec3 pos, glm::quat rot, glm::vec3 scale, SaveProgress* progress = nullptr) const;
 };
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include "AllocationTracker.h"
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+static atomic<uint64_t> allocationCount[ALLOC_TAG_COUNT];
+static atomic<uint64_t> allocationBytes[ALLOC_TAG_COUNT];
+static atomic<uint64_t> violationCount;
+static atomic<bool> strictMode;
+static thread_local int currentTag = ALLOC_GENERAL;
+static thread_local bool frameGuard = false;
+
+uint64_t AllocationCounters::totalCount() const {
+    uint64_t total = 0;
+    for (int i = 0; i < ALLOC_TAG_COUNT; ++i) total += count[i];
+    return total;
+}
+
+uint64_t AllocationCounters::totalBytes() const {
+    uint64_t total = 0;
+    for (int i = 0; i < ALLOC_TAG_COUNT; ++i) total += bytes[i];
+    return total;
+}
+
+AllocationCounters AllocationCounters::operator-(const AllocationCounters& other) const {
+    AllocationCounters result;
+    for (int i = 0; i < ALLOC_TAG_COUNT; ++i) {
+        result.count[i] = count[i] - other.count[i];
+        result.bytes[i] = bytes[i] - other.bytes[i];
+    }
+    result.violations = violations - other.violations;
+    return result;
+}
+
+static void reportViolation() {
+    violationCount.fetch_add(1, memory_order_relaxed);
+#ifdef _DEBUG
+    assert(!"Asignacion de memoria dentro de un frame estable");
+#endif
+}
+
+void CAllocationTracker::record(size_t bytes) {
+    int tag = currentTag;
+    allocationCount[tag].fetch_add(1, memory_order_relaxed);
+    allocationBytes[tag].fetch_add(bytes, memory_order_relaxed);
+    if (frameGuard && (tag == ALLOC_RENDER || tag == ALLOC_INTERFACE) && strictMode.load(memory_order_relaxed)) reportViolation();
+}
+
+AllocationTag CAllocationTracker::getTag() {
+    return (AllocationTag)currentTag;
+}
+
+AllocationTag CAllocationTracker::setTag(AllocationTag tag) {
+    AllocationTag previous = (AllocationTag)currentTag;
+    currentTag = tag;
+    return previous;
+}
+
+void CAllocationTracker::setFrameGuard(bool active) {
+    frameGuard = active;
+}
+
+void CAllocationTracker::setStrict(bool strict) {
+    strictMode = strict;
+}
+
+bool CAllocationTracker::isStrict() {
+    return strictMode;
+}
+
+bool CAllocationTracker::isEnabled() {
+#ifdef VIEWER_ALLOC_TRACKING
+    return true;
+#else
+    return false;
+#endif
+}
+
+void CAllocationTracker::snapshot(AllocationCounters& out) {
+    for (int i = 0; i < ALLOC_TAG_COUNT; ++i) {
+        out.count[i] = allocationCount[i].load(memory_order_relaxed);
+        out.bytes[i] = allocationBytes[i].load(memory_order_relaxed);
+    }
+    out.violations = violationCount.load(memory_order_relaxed);
+}
+
+const char* CAllocationTracker::getTagName(int tag) {
+    static const char* names[ALLOC_TAG_COUNT] = { "General", "Render", "Interfaz", "Geometria", "Texturas", "E/S" };
+    return tag >= 0 && tag < ALLOC_TAG_COUNT ? names[tag] : "?";
+}
+
+void* CAllocationTracker::imguiAlloc(size_t size, void*) {
+    record(size);
+    return malloc(size);
+}
+
+void CAllocationTracker::imguiFree(void* pointer, void*) {
+    free(pointer);
+}
+
+#ifdef VIEWER_ALLOC_TRACKING
+
+static void* rawAllocate(size_t size, size_t alignment) {
+    if (!alignment) return malloc(size ? size : 1);
+#ifdef _MSC_VER
+    return _aligned_malloc(size ? size : 1, alignment);
+#else
+    void* pointer = nullptr;
+    if (posix_memalign(&pointer, alignment < sizeof(void*) ? sizeof(void*) : alignment, size ? size : 1) != 0) return nullptr;
+    return pointer;
+#endif
+}
+
+static void* allocate(size_t size, size_t alignment = 0) {
+    CAllocationTracker::record(size);
+    for (;;) {
+        void* pointer = rawAllocate(size, alignment);
+        if (pointer) return pointer;
+        new_handler handler = get_new_handler();
+        if (!handler) throw bad_alloc();
+        handler();
+    }
+}
+
+static void* allocateNoThrow(size_t size, size_t alignment = 0) noexcept {
+    try {
+        return allocate(size, alignment);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+static void releaseAligned(void* pointer) {
+#ifdef _MSC_VER
+    _aligned_free(pointer);
+#else
+    free(pointer);
+#endif
+}
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void* operator new(size_t size, const nothrow_t&) noexcept { return allocateNoThrow(size); }
+void* operator new[](size_t size, const nothrow_t&) noexcept { return allocateNoThrow(size); }
+
+void* operator new(size_t size, align_val_t alignment) { return allocate(size, (size_t)alignment); }
+void* operator new[](size_t size, align_val_t alignment) { return allocate(size, (size_t)alignment); }
+void* operator new(size_t size, align_val_t alignment, const nothrow_t&) noexcept { return allocateNoThrow(size, (size_t)alignment); }
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t&) noexcept { return allocateNoThrow(size, (size_t)alignment); }
+
+void operator delete(void* pointer) noexcept { free(pointer); }
+void operator delete[](void* pointer) noexcept { free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { free(pointer); }
+void operator delete(void* pointer, const nothrow_t&) noexcept { free(pointer); }
+void operator delete[](void* pointer, const nothrow_t&) noexcept { free(pointer); }
+void operator delete(void* pointer, align_val_t) noexcept { releaseAligned(pointer); }
+void operator delete[](void* pointer, align_val_t) noexcept { releaseAligned(pointer); }
+void operator delete(void* pointer, size_t, align_val_t) noexcept { releaseAligned(pointer); }
+void operator delete[](void* pointer, size_t, align_val_t) noexcept { releaseAligned(pointer); }
+void operator delete(void* pointer, align_val_t, const nothrow_t&) noexcept { releaseAligned(pointer); }
+void operator delete[](void* pointer, align_val_t, const nothrow_t&) noexcept { releaseAligned(pointer); }
+
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+enum AllocationTag {
+    ALLOC_GENERAL,
+    ALLOC_RENDER,
+    ALLOC_INTERFACE,
+    ALLOC_GEOMETRY,
+    ALLOC_TEXTURES,
+    ALLOC_IO,
+    ALLOC_TAG_COUNT
+};
+
+struct AllocationCounters {
+    uint64_t count[ALLOC_TAG_COUNT] = {};
+    uint64_t bytes[ALLOC_TAG_COUNT] = {};
+    uint64_t violations = 0;
+
+    uint64_t totalCount() const;
+    uint64_t totalBytes() const;
+    AllocationCounters operator-(const AllocationCounters& other) const;
+};
+
+class CAllocationTracker {
+public:
+    static void record(size_t bytes);
+    static AllocationTag getTag();
+    static AllocationTag setTag(AllocationTag tag);
+    static void setFrameGuard(bool active);
+    static void setStrict(bool strict);
+    static bool isStrict();
+    static bool isEnabled();
+    static void snapshot(AllocationCounters& out);
+    static const char* getTagName(int tag);
+
+    static void* imguiAlloc(size_t size, void* user);
+    static void imguiFree(void* pointer, void* user);
+};
+
+class CAllocationScope {
+    AllocationTag previous;
+
+public:
+    explicit CAllocationScope(AllocationTag tag) : previous(CAllocationTracker::setTag(tag)) {}
+    ~CAllocationScope() { CAllocationTracker::setTag(previous); }
+    CAllocationScope(const CAllocationScope&) = delete;
+    CAllocationScope& operator=(const CAllocationScope&) = delete;
+};
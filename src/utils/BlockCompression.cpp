@@ -0,0 +1,166 @@
+#include "BlockCompression.h"
+#include <algorithm>
+#include <cmath>
+
+size_t blockBytes(BlockFormat format) {
+    return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+size_t compressedLevelSize(BlockFormat format, int width, int height) {
+    size_t blocksX = (size_t)std::max(1, (width + 3) / 4);
+    size_t blocksY = (size_t)std::max(1, (height + 3) / 4);
+    return blocksX * blocksY * blockBytes(format);
+}
+
+static uint16_t packRGB565(const float c[3]) {
+    int r = (int)std::lround(std::min(std::max(c[0], 0.0f), 255.0f) * 31.0f / 255.0f);
+    int g = (int)std::lround(std::min(std::max(c[1], 0.0f), 255.0f) * 63.0f / 255.0f);
+    int b = (int)std::lround(std::min(std::max(c[2], 0.0f), 255.0f) * 31.0f / 255.0f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void unpackRGB565(uint16_t packed, int out[3]) {
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+}
+
+void encodeBC1Block(const uint8_t rgba[64], uint8_t out[8]) {
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < 3; ++c) mean[c] += rgba[i * 4 + c];
+    }
+    for (int c = 0; c < 3; ++c) mean[c] /= 16.0f;
+
+    float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; ++i) {
+        float r = rgba[i * 4 + 0] - mean[0];
+        float g = rgba[i * 4 + 1] - mean[1];
+        float b = rgba[i * 4 + 2] - mean[2];
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (int iter = 0; iter < 4; ++iter) {
+        float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        float len = std::max({ std::fabs(x), std::fabs(y), std::fabs(z) });
+        if (len < 1e-6f) break;
+        axis[0] = x / len; axis[1] = y / len; axis[2] = z / len;
+    }
+
+    float minProj = 1e30f, maxProj = -1e30f;
+    for (int i = 0; i < 16; ++i) {
+        float p = (rgba[i * 4 + 0] - mean[0]) * axis[0] + (rgba[i * 4 + 1] - mean[1]) * axis[1] +
+                  (rgba[i * 4 + 2] - mean[2]) * axis[2];
+        minProj = std::min(minProj, p);
+        maxProj = std::max(maxProj, p);
+    }
+
+    float axisLen2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    float hi[3], lo[3];
+    for (int c = 0; c < 3; ++c) {
+        hi[c] = mean[c] + axis[c] * maxProj / axisLen2;
+        lo[c] = mean[c] + axis[c] * minProj / axisLen2;
+    }
+
+    uint16_t c0 = packRGB565(hi);
+    uint16_t c1 = packRGB565(lo);
+    if (c0 < c1) std::swap(c0, c1);
+
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        int palette[4][3];
+        unpackRGB565(c0, palette[0]);
+        unpackRGB565(c1, palette[1]);
+        for (int c = 0; c < 3; ++c) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (int i = 0; i < 16; ++i) {
+            int best = 0, bestDist = 1 << 30;
+            for (int p = 0; p < 4; ++p) {
+                int dr = rgba[i * 4 + 0] - palette[p][0];
+                int dg = rgba[i * 4 + 1] - palette[p][1];
+                int db = rgba[i * 4 + 2] - palette[p][2];
+                int dist = dr * dr + dg * dg + db * db;
+                if (dist < bestDist) {
+                    bestDist = dist;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (2 * i);
+        }
+    }
+
+    out[0] = (uint8_t)(c0 & 0xFF); out[1] = (uint8_t)(c0 >> 8);
+    out[2] = (uint8_t)(c1 & 0xFF); out[3] = (uint8_t)(c1 >> 8);
+    for (int i = 0; i < 4; ++i) out[4 + i] = (uint8_t)(indices >> (8 * i));
+}
+
+void encodeBC4Block(const uint8_t values[16], uint8_t out[8]) {
+    uint8_t hi = values[0], lo = values[0];
+    for (int i = 1; i < 16; ++i) {
+        hi = std::max(hi, values[i]);
+        lo = std::min(lo, values[i]);
+    }
+
+    uint64_t bits = 0;
+    if (hi != lo) {
+        int palette[8] = { hi, lo };
+        for (int k = 2; k < 8; ++k) palette[k] = ((8 - k) * hi + (k - 1) * lo) / 7;
+
+        for (int i = 0; i < 16; ++i) {
+            int best = 0, bestDist = 1 << 30;
+            for (int k = 0; k < 8; ++k) {
+                int dist = std::abs(values[i] - palette[k]);
+                if (dist < bestDist) {
+                    bestDist = dist;
+                    best = k;
+                }
+            }
+            bits |= (uint64_t)best << (3 * i);
+        }
+    }
+
+    out[0] = hi;
+    out[1] = lo;
+    for (int i = 0; i < 6; ++i) out[2 + i] = (uint8_t)(bits >> (8 * i));
+}
+
+void encodeBC3Block(const uint8_t rgba[64], uint8_t out[16]) {
+    uint8_t alpha[16];
+    for (int i = 0; i < 16; ++i) alpha[i] = rgba[i * 4 + 3];
+    encodeBC4Block(alpha, out);
+    encodeBC1Block(rgba, out + 8);
+}
+
+vector<uint8_t> compressImage(BlockFormat format, const uint8_t* rgba, int width, int height) {
+    vector<uint8_t> result(compressedLevelSize(format, width, height));
+    size_t stride = blockBytes(format);
+    int blocksX = std::max(1, (width + 3) / 4);
+    int blocksY = std::max(1, (height + 3) / 4);
+
+    uint8_t block[64];
+    for (int by = 0; by < blocksY; ++by) {
+        for (int bx = 0; bx < blocksX; ++bx) {
+            for (int y = 0; y < 4; ++y) {
+                int sy = std::min(by * 4 + y, height - 1);
+                for (int x = 0; x < 4; ++x) {
+                    int sx = std::min(bx * 4 + x, width - 1);
+                    const uint8_t* src = rgba + ((size_t)sy * width + sx) * 4;
+                    std::copy(src, src + 4, block + (y * 4 + x) * 4);
+                }
+            }
+
+            uint8_t* dst = result.data() + ((size_t)by * blocksX + bx) * stride;
+            if (format == BlockFormat::BC1) encodeBC1Block(block, dst);
+            else encodeBC3Block(block, dst);
+        }
+    }
+    return result;
+}
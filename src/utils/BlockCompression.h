@@ -0,0 +1,20 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+enum class BlockFormat : uint32_t {
+    BC1 = 1,
+    BC3 = 3
+};
+
+size_t blockBytes(BlockFormat format);
+size_t compressedLevelSize(BlockFormat format, int width, int height);
+
+void encodeBC1Block(const uint8_t rgba[64], uint8_t out[8]);
+void encodeBC4Block(const uint8_t values[16], uint8_t out[8]);
+void encodeBC3Block(const uint8_t rgba[64], uint8_t out[16]);
+
+vector<uint8_t> compressImage(BlockFormat format, const uint8_t* rgba, int width, int height);
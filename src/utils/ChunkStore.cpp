@@ -0,0 +1,577 @@
+#include "ChunkStore.h"
+#include <cstring>
+#include <cstdio>
+#include "Logger.h"
+#include "Trace.h"
+#include <filesystem>
+
+struct ChunkStoreHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t metadataOffset;
+    uint64_t metadataSize;
+    uint32_t subMeshCount;
+    uint32_t chunkCount;
+    uint32_t vertexColors;
+    uint32_t points;
+    BoundingBox box;
+};
+
+static const uint32_t CHUNK_STORE_VERSION = 3;
+static const size_t CHUNK_VERTICES = 3 * 262144;
+static const size_t VERTEX_FLOATS = 8;
+
+static bool sourceStamp(const string& path, uint64_t& size, int64_t& time) {
+    std::error_code error;
+    std::filesystem::path source(path);
+    size = (uint64_t)std::filesystem::file_size(source, error);
+    if (error) return false;
+    time = (int64_t)std::filesystem::last_write_time(source, error).time_since_epoch().count();
+    return !error;
+}
+
+static void putBytes(vector<unsigned char>& out, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+template <typename T>
+static void put(vector<unsigned char>& out, const T& value) {
+    putBytes(out, &value, sizeof(T));
+}
+
+static void putString(vector<unsigned char>& out, const string& text) {
+    put(out, (uint32_t)text.size());
+    putBytes(out, text.data(), text.size());
+}
+
+struct MetadataReader {
+    const unsigned char* cursor;
+    const unsigned char* end;
+    bool ok = true;
+
+    void bytes(void* out, size_t size) {
+        if (!ok || (size_t)(end - cursor) < size) {
+            ok = false;
+            return;
+        }
+        memcpy(out, cursor, size);
+        cursor += size;
+    }
+
+    template <typename T>
+    void get(T& value) { bytes(&value, sizeof(T)); }
+
+    void getString(string& text) {
+        uint32_t length = 0;
+        get(length);
+        if (!ok || (size_t)(end - cursor) < length) {
+            ok = false;
+            return;
+        }
+        text.assign((const char*)cursor, length);
+        cursor += length;
+    }
+};
+
+static void putMaterial(vector<unsigned char>& out, const Material& material) {
+    putString(out, material.name);
+    put(out, material.ns);
+    put(out, material.ka);
+    put(out, material.kd);
+    put(out, material.ks);
+    put(out, material.ni);
+    put(out, material.d);
+    put(out, material.illum);
+    putString(out, material.textureMap);
+    putString(out, material.texturePath);
+}
+
+static void getMaterial(MetadataReader& in, Material& material) {
+    in.getString(material.name);
+    in.get(material.ns);
+    in.get(material.ka);
+    in.get(material.kd);
+    in.get(material.ks);
+    in.get(material.ni);
+    in.get(material.d);
+    in.get(material.illum);
+    in.getString(material.textureMap);
+    in.getString(material.texturePath);
+}
+
+CChunkStore::CChunkStore() {
+    static int nextId = 0;
+    id = nextId++;
+}
+
+string CChunkStore::cachePathFor(const string& path) const {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : path) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.chk", (unsigned long long)hash);
+    return cacheDirectory + "/" + name;
+}
+
+bool CChunkStore::open(const string& sourcePath, C3DFigure& figure) {
+    close();
+
+    uint64_t sourceSize = 0;
+    int64_t sourceTime = 0;
+    if (!sourceStamp(sourcePath, sourceSize, sourceTime)) return false;
+    if (!mapping.open(cachePathFor(sourcePath))) return false;
+
+    ChunkStoreHeader header;
+    bool valid = mapping.getSize() >= sizeof(header);
+    if (valid) {
+        memcpy(&header, mapping.getData(), sizeof(header));
+        valid = memcmp(header.magic, "CHK1", 4) == 0 && header.version == CHUNK_STORE_VERSION &&
+                header.sourceSize == sourceSize && header.sourceTime == sourceTime &&
+                header.metadataOffset <= mapping.getSize() &&
+                header.metadataSize <= mapping.getSize() - header.metadataOffset;
+    }
+    if (!valid) {
+        close();
+        return false;
+    }
+
+    MetadataReader in;
+    in.cursor = mapping.getData() + header.metadataOffset;
+    in.end = in.cursor + header.metadataSize;
+
+    uint32_t materialCount = 0;
+    in.get(materialCount);
+    vector<Material> materials;
+    if (in.ok && materialCount <= header.metadataSize) materials.resize(materialCount);
+    for (auto& material : materials) getMaterial(in, material);
+
+    vector<SubMesh> meshes(header.subMeshCount);
+    for (auto& mesh : meshes) {
+        in.getString(mesh.groupName);
+        in.get(mesh.material);
+        in.get(mesh.color);
+        in.get(mesh.offset);
+        in.get(mesh.bbox);
+        in.get(mesh.instanceOf);
+        in.get(mesh.instanceTranslation);
+        in.get(mesh.firstChunk);
+        in.get(mesh.chunkCount);
+    }
+
+    chunks.resize(header.chunkCount);
+    if (in.ok && header.chunkCount > 0) in.bytes(chunks.data(), chunks.size() * sizeof(ChunkRecord));
+
+    payloadBytes = 0;
+    for (const auto& chunk : chunks) {
+        uint64_t bytes = (uint64_t)chunk.vertexCount * VERTEX_FLOATS * sizeof(float);
+        if (chunk.offset < sizeof(header) || chunk.offset + bytes > header.metadataOffset || (!header.points && chunk.subMesh >= meshes.size())) {
+            in.ok = false;
+            break;
+        }
+        payloadBytes += bytes;
+    }
+    if (header.points) {
+        for (size_t c = 0; c + 1 < chunks.size(); ++c) {
+            if (chunks[c].vertexCount != chunks[0].vertexCount) in.ok = false;
+        }
+    }
+    for (const auto& mesh : meshes) {
+        if (mesh.firstChunk < 0 || mesh.chunkCount < 0 || mesh.firstChunk + mesh.chunkCount > (int)chunks.size() ||
+            mesh.instanceOf >= (int)meshes.size() || mesh.material < 0 || mesh.material >= (int)materials.size()) {
+            in.ok = false;
+        }
+    }
+    if (!in.ok) {
+        LOG_WARNING(LOG_GEOMETRY, "Cache de geometria corrupta, se reconstruira: %s", sourcePath.c_str());
+        close();
+        return false;
+    }
+
+    vertexColors = header.vertexColors != 0;
+    points = header.points != 0;
+    pointCount = points ? payloadBytes / (VERTEX_FLOATS * sizeof(float)) : 0;
+    figure.getMaterialsModifiable() = std::move(materials);
+    figure.getSubMeshesModifiable() = std::move(meshes);
+    figure.setBoundingBox(header.box);
+    return true;
+}
+
+bool CChunkStore::write(const string& sourcePath, C3DFigure& figure, const string& cachePath) {
+    ChunkStoreHeader header;
+    memset(&header, 0, sizeof(header));
+    if (!sourceStamp(sourcePath, header.sourceSize, header.sourceTime)) return false;
+
+    string tempPath = cachePath + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (!file) return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    uint64_t offset = sizeof(header);
+
+    const vector<vec3>& vertices = figure.getVertices();
+    const vector<vec3>& textures = figure.getTextures();
+    const vector<vec3>& colors = figure.getVertexColors();
+    const CFacePool& faces = figure.getFaces();
+    vector<SubMesh>& meshes = figure.getSubMeshesModifiable();
+
+    vector<float> buffer;
+    buffer.reserve(CHUNK_VERTICES * VERTEX_FLOATS);
+    ChunkRecord record;
+
+    auto flush = [&](int subMesh) {
+        if (buffer.empty()) return;
+        record.offset = offset;
+        record.vertexCount = (uint32_t)(buffer.size() / VERTEX_FLOATS);
+        record.subMesh = (uint32_t)subMesh;
+        ok = ok && fwrite(buffer.data(), sizeof(float), buffer.size(), file) == buffer.size();
+        offset += buffer.size() * sizeof(float);
+        chunks.push_back(record);
+        meshes[subMesh].chunkCount++;
+        buffer.clear();
+    };
+
+    auto flushPoints = [&]() {
+        if (buffer.empty()) return;
+        record.offset = offset;
+        record.vertexCount = (uint32_t)(buffer.size() / VERTEX_FLOATS);
+        record.subMesh = 0;
+        ok = ok && fwrite(buffer.data(), sizeof(float), buffer.size(), file) == buffer.size();
+        offset += buffer.size() * sizeof(float);
+        chunks.push_back(record);
+        buffer.clear();
+    };
+
+    chunks.clear();
+    for (int m = 0; m < (int)meshes.size() && ok; ++m) {
+        SubMesh& mesh = meshes[m];
+        mesh.firstChunk = (int)chunks.size();
+        mesh.chunkCount = 0;
+        if (mesh.instanceOf >= 0) continue;
+
+        for (int f = mesh.firstFace; f < mesh.firstFace + mesh.faceCount; ++f) {
+            bool valid = true;
+            for (int i = 0; i < 3; ++i) {
+                if (faces.vertex(f, i) < 0 || faces.vertex(f, i) >= (int)vertices.size()) valid = false;
+            }
+            if (!valid) continue;
+
+            if (buffer.empty()) {
+                record.min = vertices[faces.vertex(f, 0)];
+                record.max = record.min;
+            }
+            for (int i = 0; i < 3; ++i) {
+                int vIdx = faces.vertex(f, i);
+                vec3 position = vertices[vIdx];
+                vec3 color = vIdx < (int)colors.size() ? colors[vIdx] : mesh.color;
+                int tIdx = faces.texture(f, i);
+                vec3 uv = (tIdx >= 0 && tIdx < (int)textures.size()) ? textures[tIdx] : vec3(0.0f);
+                buffer.insert(buffer.end(), { position.x, position.y, position.z, color.r, color.g, color.b, uv.x, uv.y });
+                record.min = glm::min(record.min, position);
+                record.max = glm::max(record.max, position);
+            }
+            if (buffer.size() >= CHUNK_VERTICES * VERTEX_FLOATS) flush(m);
+            if (!ok) break;
+        }
+        flush(m);
+    }
+
+    if (meshes.empty()) {
+        vec3 fallback(0.85f);
+        for (size_t v = 0; v < vertices.size() && ok; ++v) {
+            if (buffer.empty()) {
+                record.min = vertices[v];
+                record.max = record.min;
+            }
+            vec3 color = v < colors.size() ? colors[v] : fallback;
+            buffer.insert(buffer.end(), { vertices[v].x, vertices[v].y, vertices[v].z, color.r, color.g, color.b, 0.0f, 0.0f });
+            record.min = glm::min(record.min, vertices[v]);
+            record.max = glm::max(record.max, vertices[v]);
+            if (buffer.size() >= CHUNK_VERTICES * VERTEX_FLOATS) flushPoints();
+        }
+        flushPoints();
+    }
+
+    for (auto& mesh : meshes) {
+        if (mesh.instanceOf < 0) continue;
+        mesh.firstChunk = meshes[mesh.instanceOf].firstChunk;
+        mesh.chunkCount = meshes[mesh.instanceOf].chunkCount;
+    }
+
+    vector<unsigned char> metadata;
+    const vector<Material>& materials = figure.getMaterials();
+    put(metadata, (uint32_t)materials.size());
+    for (const auto& material : materials) putMaterial(metadata, material);
+    for (const auto& mesh : meshes) {
+        putString(metadata, mesh.groupName);
+        put(metadata, mesh.material);
+        put(metadata, mesh.color);
+        put(metadata, mesh.offset);
+        put(metadata, mesh.bbox);
+        put(metadata, mesh.instanceOf);
+        put(metadata, mesh.instanceTranslation);
+        put(metadata, mesh.firstChunk);
+        put(metadata, mesh.chunkCount);
+    }
+    if (!chunks.empty()) putBytes(metadata, chunks.data(), chunks.size() * sizeof(ChunkRecord));
+
+    memcpy(header.magic, "CHK1", 4);
+    header.version = CHUNK_STORE_VERSION;
+    header.metadataOffset = offset;
+    header.metadataSize = metadata.size();
+    header.subMeshCount = (uint32_t)meshes.size();
+    header.chunkCount = (uint32_t)chunks.size();
+    header.vertexColors = figure.hasVertexColors() ? 1 : 0;
+    header.points = meshes.empty() ? 1 : 0;
+    header.box = figure.getBoundingBox();
+
+    ok = ok && fwrite(metadata.data(), 1, metadata.size(), file) == metadata.size();
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = (fclose(file) == 0) && ok;
+
+    std::error_code error;
+    if (ok) {
+        std::filesystem::rename(tempPath, cachePath, error);
+        if (!error) {
+            vertexColors = header.vertexColors != 0;
+            points = header.points != 0;
+            payloadBytes = offset - sizeof(header);
+            pointCount = points ? vertices.size() : 0;
+            return true;
+        }
+    }
+    std::filesystem::remove(tempPath, error);
+    chunks.clear();
+    return false;
+}
+
+bool CChunkStore::saveObject(const string& filename, C3DFigure& figure, vec3 globalPos, quat globalRot, vec3 scale, SaveProgress* progress) const {
+    TRACE_ZONE("saveChunkedObject");
+    if (filename.empty()) return false;
+
+    string objName = hasExtension(filename, ".obj") ? filename : filename + ".obj";
+    string mtlName = objName.substr(0, objName.length() - 4) + ".mtl";
+    size_t lastSlash = mtlName.find_last_of("/\\");
+    string mtlSimpleName = lastSlash != string::npos ? mtlName.substr(lastSlash + 1) : mtlName;
+
+    FILE* objFile = fopen(objName.c_str(), "wb");
+    FILE* mtlFile = fopen(mtlName.c_str(), "wb");
+    if (!objFile || !mtlFile) {
+        if (objFile) fclose(objFile);
+        if (mtlFile) fclose(mtlFile);
+        LOG_ERROR(LOG_IO, "Error salvando archivo: %s", objName.c_str());
+        return false;
+    }
+
+    const vector<SubMesh>& meshes = figure.getSubMeshes();
+    const vector<Material>& materials = figure.getMaterials();
+    if (progress) {
+        int total = 0;
+        for (const auto& mesh : meshes) total += mesh.chunkCount;
+        progress->total = total;
+    }
+
+    CTextWriter out;
+    out.append("# Generated by 3DViewer\n");
+    out.append("mtllib "); out.append(mtlSimpleName); out.append('\n');
+    bool ok = out.writeTo(objFile);
+
+    long long nextIndex = 1;
+    for (const auto& mesh : meshes) {
+        if (!ok || (progress && progress->cancel)) break;
+        bool textured = !materials[mesh.material].textureMap.empty();
+        out.clear();
+        out.append("usemtl "); out.append(mesh.groupName); out.append('\n');
+
+        for (int c = mesh.firstChunk; c < mesh.firstChunk + mesh.chunkCount && ok; ++c) {
+            if (progress && progress->cancel) break;
+            const float* vertex = getChunkData(c);
+            uint32_t count = chunks[c].vertexCount;
+            out.reserve(out.size() + (size_t)count * (textured ? 64 : 40) + (count / 3) * 40);
+
+            for (uint32_t v = 0; v < count; ++v, vertex += VERTEX_FLOATS) {
+                vec3 baked = vec3(vertex[0], vertex[1], vertex[2]) + mesh.instanceTranslation + mesh.offset;
+                baked = globalRot * (baked * scale) + globalPos;
+                out.append("v ");
+                out.appendFloat(baked.x); out.append(' ');
+                out.appendFloat(baked.y); out.append(' ');
+                out.appendFloat(baked.z);
+                if (vertexColors) {
+                    out.append(' '); out.appendFloat(vertex[3]);
+                    out.append(' '); out.appendFloat(vertex[4]);
+                    out.append(' '); out.appendFloat(vertex[5]);
+                }
+                out.append('\n');
+                if (textured) {
+                    out.append("vt ");
+                    out.appendFloat(vertex[6]); out.append(' ');
+                    out.appendFloat(vertex[7]); out.append('\n');
+                }
+            }
+            for (uint32_t v = 0; v + 2 < count; v += 3) {
+                out.append('f');
+                for (int i = 0; i < 3; ++i) {
+                    long long index = nextIndex + v + i;
+                    out.append(' ');
+                    out.appendInt(index);
+                    if (textured) {
+                        out.append('/');
+                        out.appendInt(index);
+                    }
+                }
+                out.append('\n');
+            }
+            nextIndex += count;
+
+            ok = out.writeTo(objFile);
+            out.clear();
+            if (progress) progress->completed++;
+        }
+    }
+
+    bool cancel = progress && progress->cancel;
+    if (ok && !cancel) {
+        out.clear();
+        figure.appendMaterialLibrary(out);
+        ok = out.writeTo(mtlFile);
+    }
+    ok = (fclose(objFile) == 0) && ok;
+    ok = (fclose(mtlFile) == 0) && ok;
+
+    if (cancel) {
+        remove(objName.c_str());
+        remove(mtlName.c_str());
+        LOG_INFO(LOG_IO, "Guardado cancelado: %s", objName.c_str());
+        return false;
+    }
+    if (!ok) {
+        LOG_ERROR(LOG_IO, "Error salvando archivo: %s", objName.c_str());
+        return false;
+    }
+    LOG_INFO(LOG_IO, "Guardado exitoso: %s", objName.c_str());
+    return true;
+}
+
+bool CChunkStore::build(const string& sourcePath, C3DFigure& figure) {
+    close();
+    if (figure.getSubMeshes().empty() && !figure.isPointCloud()) return false;
+
+    std::error_code error;
+    std::filesystem::create_directories(cacheDirectory, error);
+
+    string cachePath = cachePathFor(sourcePath);
+    if (!write(sourcePath, figure, cachePath) || !mapping.open(cachePath)) {
+        LOG_WARNING(LOG_GEOMETRY, "No se pudo crear la cache de geometria para %s", sourcePath.c_str());
+        close();
+        return false;
+    }
+
+    figure.releaseGeometry();
+    return true;
+}
+
+void CChunkStore::close() {
+    mapping.close();
+    chunks.clear();
+    vertexColors = false;
+    points = false;
+    pointCount = 0;
+    payloadBytes = 0;
+}
+
+const float* CChunkStore::getPoint(uint64_t index) const {
+    uint64_t perChunk = chunks[0].vertexCount;
+    const ChunkRecord& chunk = chunks[index / perChunk];
+    return (const float*)(mapping.getData() + chunk.offset) + (index % perChunk) * VERTEX_FLOATS;
+}
+
+CChunkCache::~CChunkCache() {
+    release();
+}
+
+void CChunkCache::beginFrame() {
+    frame++;
+    uploadedBytes = 0;
+    drawnChunks = 0;
+    deferredUploads = false;
+}
+
+void CChunkCache::evict(map<pair<int, int>, Entry>::iterator entry) {
+    if (entry->second.vbo) glDeleteBuffers(1, &entry->second.vbo);
+    if (entry->second.vao) glDeleteVertexArrays(1, &entry->second.vao);
+    residentBytes -= entry->second.bytes;
+    entries.erase(entry);
+}
+
+bool CChunkCache::evictOldest() {
+    auto oldest = entries.end();
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->second.lastUsed == frame) continue;
+        if (oldest == entries.end() || it->second.lastUsed < oldest->second.lastUsed) oldest = it;
+    }
+    if (oldest == entries.end()) return false;
+    evict(oldest);
+    return true;
+}
+
+GLuint CChunkCache::acquire(const CChunkStore& store, int chunk, bool allowUpload) {
+    pair<int, int> key(store.getId(), chunk);
+    auto found = entries.find(key);
+    if (found != entries.end()) {
+        found->second.lastUsed = frame;
+        drawnChunks++;
+        return found->second.vao;
+    }
+    if (!allowUpload) return 0;
+    if (uploadedBytes >= uploadBudget) {
+        deferredUploads = true;
+        return 0;
+    }
+
+    size_t bytes = (size_t)store.getChunk(chunk).vertexCount * VERTEX_FLOATS * sizeof(float);
+    while (residentBytes + bytes > budgetBytes) {
+        if (!evictOldest()) return 0;
+    }
+
+    Entry entry;
+    entry.bytes = bytes;
+    entry.lastUsed = frame;
+    glGenVertexArrays(1, &entry.vao);
+    glGenBuffers(1, &entry.vbo);
+    glBindVertexArray(entry.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, entry.vbo);
+    glBufferData(GL_ARRAY_BUFFER, bytes, store.getChunkData(chunk), GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_FLOATS * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, VERTEX_FLOATS * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, VERTEX_FLOATS * sizeof(float), (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(4);
+
+    uploadedBytes += bytes;
+    residentBytes += bytes;
+    drawnChunks++;
+    entries[key] = entry;
+    return entry.vao;
+}
+
+void CChunkCache::endFrame() {
+    while (residentBytes > budgetBytes && evictOldest()) {}
+}
+
+void CChunkCache::releaseStore(int storeId) {
+    for (auto it = entries.begin(); it != entries.end();) {
+        auto next = std::next(it);
+        if (it->first.first == storeId) evict(it);
+        it = next;
+    }
+}
+
+void CChunkCache::release() {
+    while (!entries.empty()) evict(entries.begin());
+}
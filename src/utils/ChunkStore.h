@@ -0,0 +1,94 @@
+#pragma once
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include "MappedFile.h"
+#include "3DFigure.h"
+
+using namespace std;
+
+struct ChunkRecord {
+    uint64_t offset = 0;
+    uint32_t vertexCount = 0;
+    uint32_t subMesh = 0;
+    vec3 min = vec3(0.0f);
+    vec3 max = vec3(0.0f);
+};
+
+class CChunkStore {
+    CMappedFile mapping;
+    vector<ChunkRecord> chunks;
+    string cacheDirectory = "geocache";
+    bool vertexColors = false;
+    bool points = false;
+    uint64_t pointCount = 0;
+    uint64_t payloadBytes = 0;
+    int id;
+
+    string cachePathFor(const string& path) const;
+    bool write(const string& sourcePath, C3DFigure& figure, const string& cachePath);
+
+public:
+    CChunkStore();
+    CChunkStore(const CChunkStore&) = delete;
+    CChunkStore& operator=(const CChunkStore&) = delete;
+
+    bool open(const string& sourcePath, C3DFigure& figure);
+    bool build(const string& sourcePath, C3DFigure& figure);
+    bool saveObject(const string& filename, C3DFigure& figure, vec3 globalPos, quat globalRot, vec3 scale, SaveProgress* progress = nullptr) const;
+    void close();
+
+    void setCacheDirectory(const string& directory) { cacheDirectory = directory; }
+
+    int getId() const { return id; }
+    int getChunkCount() const { return (int)chunks.size(); }
+    const ChunkRecord& getChunk(int index) const { return chunks[index]; }
+    const float* getChunkData(int index) const { return (const float*)(mapping.getData() + chunks[index].offset); }
+    const float* getPoint(uint64_t index) const;
+    bool hasVertexColors() const { return vertexColors; }
+    bool isPointCloud() const { return points; }
+    uint64_t getPointCount() const { return pointCount; }
+    uint64_t getPayloadBytes() const { return payloadBytes; }
+};
+
+class CChunkCache {
+    struct Entry {
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        size_t bytes = 0;
+        uint64_t lastUsed = 0;
+    };
+
+    map<pair<int, int>, Entry> entries;
+    uint64_t frame = 0;
+    size_t residentBytes = 0;
+    size_t budgetBytes = (size_t)1024 * 1024 * 1024;
+    size_t uploadBudget = (size_t)64 * 1024 * 1024;
+    size_t uploadedBytes = 0;
+    int drawnChunks = 0;
+    bool deferredUploads = false;
+
+    void evict(map<pair<int, int>, Entry>::iterator entry);
+    bool evictOldest();
+
+public:
+    CChunkCache() {}
+    ~CChunkCache();
+    CChunkCache(const CChunkCache&) = delete;
+    CChunkCache& operator=(const CChunkCache&) = delete;
+
+    void beginFrame();
+    GLuint acquire(const CChunkStore& store, int chunk, bool allowUpload);
+    void endFrame();
+    void releaseStore(int storeId);
+    void release();
+
+    void setBudget(size_t bytes) { budgetBytes = bytes; }
+    size_t getBudget() const { return budgetBytes; }
+    size_t getResidentBytes() const { return residentBytes; }
+    int getResidentChunks() const { return (int)entries.size(); }
+    int getDrawnChunks() const { return drawnChunks; }
+    bool hasDeferredUploads() const { return deferredUploads; }
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include <vector>
+#include <memory>
+
+using namespace std;
+
+template <typename T>
+class CCowArray {
+    shared_ptr<vector<T>> items;
+
+public:
+    CCowArray() : items(make_shared<vector<T>>()) {}
+
+    size_t size() const { return items->size(); }
+    bool empty() const { return items->empty(); }
+    const T& operator[](size_t index) const { return (*items)[index]; }
+    typename vector<T>::const_iterator begin() const { return items->cbegin(); }
+    typename vector<T>::const_iterator end() const { return items->cend(); }
+
+    const vector<T>& get() const { return *items; }
+
+    vector<T>& edit() {
+        if (items.use_count() > 1) items = make_shared<vector<T>>(*items);
+        return *items;
+    }
+
+    bool isShared() const { return items.use_count() > 1; }
+};
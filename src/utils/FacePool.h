@@ -0,0 +1,84 @@
+#pragma once
+#include <vector>
+#include "CowArray.h"
+
+using namespace std;
+
+static const int ABSENT_INDEX = -1;
+
+struct FaceElement{
+    int vertexIndices[3];
+    int textureIndices[3];
+    int normalIndices[3];
+};
+
+class CFacePool {
+    CCowArray<int> vertexStream;
+    CCowArray<int> textureStream;
+    CCowArray<int> normalStream;
+
+    static bool anyPresent(const int indices[3]) {
+        return indices[0] != ABSENT_INDEX || indices[1] != ABSENT_INDEX || indices[2] != ABSENT_INDEX;
+    }
+
+    static void append(CCowArray<int>& stream, size_t faceCount, const int indices[3]) {
+        vector<int>& data = stream.edit();
+        if (data.empty()) data.assign(faceCount * 3, ABSENT_INDEX);
+        data.insert(data.end(), indices, indices + 3);
+    }
+
+public:
+    size_t size() const { return vertexStream.size() / 3; }
+    bool empty() const { return vertexStream.empty(); }
+    bool hasTextures() const { return !textureStream.empty(); }
+    bool hasNormals() const { return !normalStream.empty(); }
+
+    int vertex(size_t face, int corner) const { return vertexStream[face * 3 + corner]; }
+    int texture(size_t face, int corner) const { return textureStream.empty() ? ABSENT_INDEX : textureStream[face * 3 + corner]; }
+    int normal(size_t face, int corner) const { return normalStream.empty() ? ABSENT_INDEX : normalStream[face * 3 + corner]; }
+
+    FaceElement get(size_t face) const {
+        FaceElement element;
+        for (int k = 0; k < 3; ++k) {
+            element.vertexIndices[k] = vertex(face, k);
+            element.textureIndices[k] = texture(face, k);
+            element.normalIndices[k] = normal(face, k);
+        }
+        return element;
+    }
+
+    void reserve(size_t faces) {
+        vertexStream.edit().reserve(faces * 3);
+    }
+
+    void push(const FaceElement& face) {
+        size_t count = size();
+        if (!textureStream.empty() || anyPresent(face.textureIndices)) append(textureStream, count, face.textureIndices);
+        if (!normalStream.empty() || anyPresent(face.normalIndices)) append(normalStream, count, face.normalIndices);
+        vector<int>& data = vertexStream.edit();
+        data.insert(data.end(), face.vertexIndices, face.vertexIndices + 3);
+    }
+
+    void setNormal(size_t face, int corner, int index) {
+        vector<int>& data = normalStream.edit();
+        if (data.empty()) data.assign(size() * 3, ABSENT_INDEX);
+        data[face * 3 + corner] = index;
+    }
+
+    void assign(vector<int> vertices, vector<int> textures, vector<int> normals) {
+        vertexStream.edit() = std::move(vertices);
+        textureStream.edit() = std::move(textures);
+        normalStream.edit() = std::move(normals);
+    }
+
+    void clear() {
+        vertexStream = CCowArray<int>();
+        textureStream = CCowArray<int>();
+        normalStream = CCowArray<int>();
+    }
+
+    const vector<int>& getVertexStream() const { return vertexStream.get(); }
+    const vector<int>& getTextureStream() const { return textureStream.get(); }
+    const vector<int>& getNormalStream() const { return normalStream.get(); }
+    size_t getBytes() const { return (vertexStream.size() + textureStream.size() + normalStream.size()) * sizeof(int); }
+};
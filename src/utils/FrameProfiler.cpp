@@ -0,0 +1,109 @@
+#include "FrameProfiler.h"
+#include <algorithm>
+
+CFrameProfiler::~CFrameProfiler() {
+    release();
+}
+
+int CFrameProfiler::addSection(const string& name, bool gpu) {
+    Section section;
+    section.name = name;
+    section.gpu = gpu;
+    section.cpuTime.samples.assign(historySize, 0.0f);
+    section.gpuTime.samples.assign(historySize, 0.0f);
+    sections.push_back(section);
+    scratch.reserve(historySize);
+    return (int)sections.size() - 1;
+}
+
+void CFrameProfiler::push(History& history, float value) {
+    history.samples[history.head] = value;
+    history.head = (history.head + 1) % historySize;
+    if (history.count < historySize) history.count++;
+}
+
+bool CFrameProfiler::readQuery(Section& section, int slot) {
+    GLint available = 0;
+    glGetQueryObjectiv(section.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) return false;
+
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(section.queries[slot], GL_QUERY_RESULT, &elapsed);
+    if (section.warmedUp) push(section.gpuTime, (float)(elapsed / 1.0e6));
+    section.warmedUp = true;
+    section.pending[slot] = false;
+    return true;
+}
+
+void CFrameProfiler::begin(int index) {
+    if (!enabled) return;
+    Section& section = sections[index];
+    section.start = chrono::steady_clock::now();
+    section.active = true;
+
+    if (!section.gpu || open) return;
+    if (!section.queries[0]) glGenQueries(2, section.queries);
+    if (section.pending[section.slot] && !readQuery(section, section.slot)) return;
+
+    glBeginQuery(GL_TIME_ELAPSED, section.queries[section.slot]);
+    section.queryOpen = true;
+    open = true;
+}
+
+void CFrameProfiler::end(int index) {
+    Section& section = sections[index];
+    if (!section.active) return;
+    section.active = false;
+    push(section.cpuTime, chrono::duration<float, milli>(chrono::steady_clock::now() - section.start).count());
+
+    if (!section.queryOpen) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    section.pending[section.slot] = true;
+    section.slot ^= 1;
+    section.queryOpen = false;
+    open = false;
+}
+
+void CFrameProfiler::collect() {
+    for (auto& section : sections) {
+        for (int slot : { section.slot ^ 1, section.slot }) {
+            if (section.pending[slot]) readQuery(section, slot);
+        }
+    }
+}
+
+void CFrameProfiler::release() {
+    for (auto& section : sections) {
+        if (section.queries[0]) glDeleteQueries(2, section.queries);
+        section.queries[0] = section.queries[1] = 0;
+        section.pending[0] = section.pending[1] = false;
+        section.active = false;
+        section.queryOpen = false;
+    }
+    open = false;
+}
+
+const float* CFrameProfiler::getSamples(int index, bool gpu, int& count, int& offset) const {
+    const History& history = gpu ? sections[index].gpuTime : sections[index].cpuTime;
+    count = history.count;
+    offset = history.count < historySize ? 0 : history.head;
+    return history.samples.data();
+}
+
+float CFrameProfiler::getLast(int index, bool gpu) const {
+    const History& history = gpu ? sections[index].gpuTime : sections[index].cpuTime;
+    if (history.count == 0) return 0.0f;
+    return history.samples[(history.head + historySize - 1) % historySize];
+}
+
+float sortedPercentile(const vector<float>& sorted, float percentile) {
+    if (sorted.empty()) return 0.0f;
+    return sorted[std::min(sorted.size() - 1, (size_t)(percentile / 100.0f * sorted.size()))];
+}
+
+float CFrameProfiler::getPercentile(int index, bool gpu, float percentile) {
+    const History& history = gpu ? sections[index].gpuTime : sections[index].cpuTime;
+    scratch.assign(history.samples.begin(), history.samples.begin() + history.count);
+    std::sort(scratch.begin(), scratch.end());
+    return sortedPercentile(scratch, percentile);
+}
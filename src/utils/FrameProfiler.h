@@ -0,0 +1,73 @@
+#pragma once
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <chrono>
+
+using namespace std;
+
+float sortedPercentile(const vector<float>& sorted, float percentile);
+
+class CFrameProfiler {
+    struct History {
+        vector<float> samples;
+        int head = 0;
+        int count = 0;
+    };
+
+    struct Section {
+        string name;
+        bool gpu = true;
+        GLuint queries[2] = { 0, 0 };
+        bool pending[2] = { false, false };
+        int slot = 0;
+        bool active = false;
+        bool warmedUp = false;
+        bool queryOpen = false;
+        chrono::steady_clock::time_point start;
+        History cpuTime;
+        History gpuTime;
+    };
+
+    vector<Section> sections;
+    vector<float> scratch;
+    int historySize = 240;
+    bool enabled = true;
+    bool open = false;
+
+    void push(History& history, float value);
+    bool readQuery(Section& section, int slot);
+
+public:
+    CFrameProfiler() {}
+    ~CFrameProfiler();
+    CFrameProfiler(const CFrameProfiler&) = delete;
+    CFrameProfiler& operator=(const CFrameProfiler&) = delete;
+
+    int addSection(const string& name, bool gpu);
+    void begin(int section);
+    void end(int section);
+    void collect();
+    void release();
+
+    void setEnabled(bool value) { enabled = value; }
+    bool isEnabled() const { return enabled; }
+
+    int getSectionCount() const { return (int)sections.size(); }
+    const string& getName(int section) const { return sections[section].name; }
+    bool hasGpu(int section) const { return sections[section].gpu; }
+    const float* getSamples(int section, bool gpu, int& count, int& offset) const;
+    float getLast(int section, bool gpu) const;
+    float getPercentile(int section, bool gpu, float percentile);
+};
+
+class CProfileScope {
+    CFrameProfiler& profiler;
+    int section;
+
+public:
+    CProfileScope(CFrameProfiler& profiler, int section) : profiler(profiler), section(section) { profiler.begin(section); }
+    ~CProfileScope() { profiler.end(section); }
+    CProfileScope(const CProfileScope&) = delete;
+    CProfileScope& operator=(const CProfileScope&) = delete;
+};
@@ -0,0 +1,52 @@
+#include "GeometryPool.h"
+#include <algorithm>
+
+CGeometryPool::CGeometryPool(int floatsPerVertex) : floatsPerVertex(floatsPerVertex) {}
+
+CGeometryPool::~CGeometryPool() {
+    release();
+}
+
+void CGeometryPool::clear() {
+    usedBytes = 0;
+}
+
+void CGeometryPool::release() {
+    if (vbo) glDeleteBuffers(1, &vbo);
+    vbo = 0;
+    usedBytes = 0;
+    capacityBytes = 0;
+}
+
+void CGeometryPool::grow(size_t requiredBytes) {
+    size_t newCapacity = std::max(requiredBytes, capacityBytes + capacityBytes / 2);
+
+    GLuint newVbo = 0;
+    glGenBuffers(1, &newVbo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newVbo);
+    glBufferData(GL_COPY_WRITE_BUFFER, newCapacity, nullptr, GL_STATIC_DRAW);
+
+    if (vbo && usedBytes > 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, vbo);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    if (vbo) glDeleteBuffers(1, &vbo);
+    vbo = newVbo;
+    capacityBytes = newCapacity;
+}
+
+int CGeometryPool::append(const vector<float>& data) {
+    int baseVertex = getVertexCount();
+    size_t bytes = data.size() * sizeof(float);
+    if (bytes == 0) return baseVertex;
+
+    if (usedBytes + bytes > capacityBytes) grow(usedBytes + bytes);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, usedBytes, bytes, data.data());
+    usedBytes += bytes;
+    return baseVertex;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <glad/glad.h>
+#include <vector>
+
+using namespace std;
+
+class CGeometryPool {
+    GLuint vbo = 0;
+    size_t usedBytes = 0;
+    size_t capacityBytes = 0;
+    int floatsPerVertex;
+
+    void grow(size_t requiredBytes);
+
+public:
+    explicit CGeometryPool(int floatsPerVertex);
+    ~CGeometryPool();
+
+    void clear();
+    void release();
+    int append(const vector<float>& data);
+
+    GLuint getBuffer() const { return vbo; }
+    int getVertexCount() const { return (int)(usedBytes / (floatsPerVertex * sizeof(float))); }
+    size_t getCapacityBytes() const { return capacityBytes; }
+};
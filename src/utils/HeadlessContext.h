@@ -0,0 +1,33 @@
+#pragma once
+#include <glad/glad.h>
+#include <vector>
+
+using namespace std;
+
+class CHeadlessContext {
+    void* display = nullptr;
+    void* context = nullptr;
+    void* surface = nullptr;
+    void* window = nullptr;
+    GLuint framebuffer = 0;
+    GLuint colorBuffer = 0;
+    GLuint depthBuffer = 0;
+    int width = 0;
+    int height = 0;
+
+public:
+    CHeadlessContext() {}
+    ~CHeadlessContext();
+    CHeadlessContext(const CHeadlessContext&) = delete;
+    CHeadlessContext& operator=(const CHeadlessContext&) = delete;
+
+    bool create();
+    bool createTarget(int width, int height);
+    void bindTarget();
+    bool readPixels(vector<unsigned char>& rgb);
+    void release();
+
+    bool isCreated() const { return context != nullptr || window != nullptr; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+};
@@ -0,0 +1,40 @@
+#include "ImageFile.h"
+#include <cstdio>
+#include <cstdlib>
+
+bool CImageFile::writePpm(const string& path, int width, int height, const vector<unsigned char>& rgb) {
+    if (rgb.size() != (size_t)width * height * 3) return false;
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+    bool ok = fprintf(file, "P6\n%d %d\n255\n", width, height) > 0;
+    ok = ok && fwrite(rgb.data(), 1, rgb.size(), file) == rgb.size();
+    return (fclose(file) == 0) && ok;
+}
+
+bool CImageFile::readPpm(const string& path, int& width, int& height, vector<unsigned char>& rgb) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    int maxValue = 0;
+    bool ok = fscanf(file, "P6 %d %d %d", &width, &height, &maxValue) == 3 && maxValue == 255 && width > 0 && height > 0;
+    ok = ok && fgetc(file) != EOF;
+    if (ok) {
+        rgb.resize((size_t)width * height * 3);
+        ok = fread(rgb.data(), 1, rgb.size(), file) == rgb.size();
+    }
+    fclose(file);
+    return ok;
+}
+
+size_t CImageFile::countDifferences(const vector<unsigned char>& a, const vector<unsigned char>& b, int tolerance) {
+    if (a.size() != b.size()) return a.size() / 3;
+    size_t different = 0;
+    for (size_t i = 0; i + 2 < a.size(); i += 3) {
+        for (int c = 0; c < 3; ++c) {
+            if (abs((int)a[i + c] - (int)b[i + c]) > tolerance) {
+                different++;
+                break;
+            }
+        }
+    }
+    return different;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class CImageFile {
+public:
+    static bool writePpm(const string& path, int width, int height, const vector<unsigned char>& rgb);
+    static bool readPpm(const string& path, int& width, int& height, vector<unsigned char>& rgb);
+    static size_t countDifferences(const vector<unsigned char>& a, const vector<unsigned char>& b, int tolerance);
+};
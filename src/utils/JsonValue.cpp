@@ -0,0 +1,204 @@
+#include "JsonValue.h"
+#include <charconv>
+
+class CJsonParser {
+    const char* cursor;
+    const char* end;
+    int depth = 0;
+
+    void skipSpace() {
+        while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r')) cursor++;
+    }
+
+    bool literal(const char* word) {
+        const char* p = cursor;
+        while (*word) {
+            if (p >= end || *p != *word) return false;
+            p++;
+            word++;
+        }
+        cursor = p;
+        return true;
+    }
+
+    static void appendUtf8(string& out, unsigned int code) {
+        if (code < 0x80) {
+            out += (char)code;
+        } else if (code < 0x800) {
+            out += (char)(0xC0 | (code >> 6));
+            out += (char)(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += (char)(0xE0 | (code >> 12));
+            out += (char)(0x80 | ((code >> 6) & 0x3F));
+            out += (char)(0x80 | (code & 0x3F));
+        } else {
+            out += (char)(0xF0 | (code >> 18));
+            out += (char)(0x80 | ((code >> 12) & 0x3F));
+            out += (char)(0x80 | ((code >> 6) & 0x3F));
+            out += (char)(0x80 | (code & 0x3F));
+        }
+    }
+
+    bool hex4(unsigned int& code) {
+        if (end - cursor < 4) return false;
+        code = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = *cursor++;
+            code <<= 4;
+            if (c >= '0' && c <= '9') code |= c - '0';
+            else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+            else return false;
+        }
+        return true;
+    }
+
+    bool parseString(string& out) {
+        if (cursor >= end || *cursor != '"') return false;
+        cursor++;
+        while (cursor < end && *cursor != '"') {
+            char c = *cursor++;
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (cursor >= end) return false;
+            char e = *cursor++;
+            switch (e) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                unsigned int code;
+                if (!hex4(code)) return false;
+                if (code >= 0xD800 && code < 0xDC00 && end - cursor >= 6 && cursor[0] == '\\' && cursor[1] == 'u') {
+                    cursor += 2;
+                    unsigned int low;
+                    if (!hex4(low)) return false;
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                appendUtf8(out, code);
+                break;
+            }
+            default: return false;
+            }
+        }
+        if (cursor >= end) return false;
+        cursor++;
+        return true;
+    }
+
+    bool parseValue(CJsonValue& value) {
+        if (++depth > 256) return false;
+        skipSpace();
+        if (cursor >= end) return false;
+
+        bool ok = true;
+        char c = *cursor;
+        if (c == '{') {
+            value.type = CJsonValue::Type::Object;
+            cursor++;
+            skipSpace();
+            if (cursor < end && *cursor == '}') {
+                cursor++;
+            } else {
+                while (ok) {
+                    skipSpace();
+                    string key;
+                    if (!parseString(key)) return false;
+                    skipSpace();
+                    if (cursor >= end || *cursor != ':') return false;
+                    cursor++;
+                    value.keys.push_back(key);
+                    value.items.emplace_back();
+                    if (!parseValue(value.items.back())) return false;
+                    skipSpace();
+                    if (cursor < end && *cursor == ',') { cursor++; continue; }
+                    if (cursor < end && *cursor == '}') { cursor++; break; }
+                    ok = false;
+                }
+            }
+        } else if (c == '[') {
+            value.type = CJsonValue::Type::Array;
+            cursor++;
+            skipSpace();
+            if (cursor < end && *cursor == ']') {
+                cursor++;
+            } else {
+                while (ok) {
+                    value.items.emplace_back();
+                    if (!parseValue(value.items.back())) return false;
+                    skipSpace();
+                    if (cursor < end && *cursor == ',') { cursor++; continue; }
+                    if (cursor < end && *cursor == ']') { cursor++; break; }
+                    ok = false;
+                }
+            }
+        } else if (c == '"') {
+            value.type = CJsonValue::Type::String;
+            ok = parseString(value.text);
+        } else if (literal("true")) {
+            value.type = CJsonValue::Type::Bool;
+            value.boolean = true;
+        } else if (literal("false")) {
+            value.type = CJsonValue::Type::Bool;
+            value.boolean = false;
+        } else if (literal("null")) {
+            value.type = CJsonValue::Type::Null;
+        } else {
+            value.type = CJsonValue::Type::Number;
+            const char* start = cursor;
+            if (*start == '+') return false;
+            std::from_chars_result result = std::from_chars(start, end, value.number);
+            ok = result.ec == std::errc() && result.ptr != start;
+            cursor = result.ptr;
+        }
+
+        depth--;
+        return ok;
+    }
+
+public:
+    CJsonParser(const char* text, size_t length) : cursor(text), end(text + length) {}
+
+    bool run(CJsonValue& out) {
+        if (!parseValue(out)) return false;
+        skipSpace();
+        while (cursor < end && *cursor == '\0') cursor++;
+        return cursor == end;
+    }
+};
+
+bool CJsonValue::parse(const char* text, size_t length, CJsonValue& out) {
+    out = CJsonValue();
+    CJsonParser parser(text, length);
+    return parser.run(out);
+}
+
+bool CJsonValue::has(const string& key) const {
+    if (type != Type::Object) return false;
+    for (const auto& k : keys) {
+        if (k == key) return true;
+    }
+    return false;
+}
+
+const CJsonValue& CJsonValue::operator[](const string& key) const {
+    static const CJsonValue nullValue;
+    if (type != Type::Object) return nullValue;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (keys[i] == key) return items[i];
+    }
+    return nullValue;
+}
+
+const CJsonValue& CJsonValue::operator[](size_t index) const {
+    static const CJsonValue nullValue;
+    if (type != Type::Array || index >= items.size()) return nullValue;
+    return items[index];
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class CJsonValue {
+public:
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    static bool parse(const char* text, size_t length, CJsonValue& out);
+
+    Type getType() const { return type; }
+    bool isNull() const { return type == Type::Null; }
+    bool isArray() const { return type == Type::Array; }
+    bool isObject() const { return type == Type::Object; }
+    bool has(const string& key) const;
+
+    const CJsonValue& operator[](const string& key) const;
+    const CJsonValue& operator[](size_t index) const;
+    size_t size() const { return items.size(); }
+
+    double asNumber(double fallback = 0.0) const { return type == Type::Number ? number : fallback; }
+    int asInt(int fallback = 0) const { return type == Type::Number ? (int)number : fallback; }
+    bool asBool(bool fallback = false) const { return type == Type::Bool ? boolean : fallback; }
+    const string& asString() const { return text; }
+
+private:
+    Type type = Type::Null;
+    double number = 0.0;
+    bool boolean = false;
+    string text;
+    vector<string> keys;
+    vector<CJsonValue> items;
+
+    friend class CJsonParser;
+};
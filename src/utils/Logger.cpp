@@ -0,0 +1,227 @@
+#include "Logger.h"
+#include "Trace.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+static const size_t LOG_CAPACITY = 1024;
+static const size_t LOG_MESSAGE_SIZE = 240;
+
+struct LogSlot {
+    atomic<uint64_t> sequence;
+    LogLevel level;
+    LogCategory category;
+    double time;
+    char text[LOG_MESSAGE_SIZE];
+};
+
+class CLogQueue {
+    LogSlot slots[LOG_CAPACITY];
+    atomic<uint64_t> enqueuePos;
+    uint64_t dequeuePos = 0;
+    atomic<uint64_t> processed;
+    atomic<uint64_t> dropped;
+    uint64_t reportedDropped = 0;
+    atomic<int> level;
+    atomic<bool> categories[LOG_CATEGORY_COUNT];
+    chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+
+    mutex wakeMutex;
+    condition_variable wake;
+    thread consumer;
+    once_flag started;
+    atomic<bool> stopping;
+
+    bool drainOne();
+    void reportDropped();
+    void writeDirect(LogLevel messageLevel, const char* format, va_list args);
+    void consumerLoop();
+
+public:
+    CLogQueue();
+    ~CLogQueue();
+
+    void push(LogLevel messageLevel, LogCategory category, const char* format, va_list args, bool blocking);
+    void flush();
+    void shutdown();
+
+    void setLevel(LogLevel value) { level = value; }
+    LogLevel getLevel() const { return (LogLevel)level.load(); }
+    void setCategoryEnabled(LogCategory category, bool enabled) { categories[category] = enabled; }
+    uint64_t getDropped() const { return dropped; }
+};
+
+CLogQueue::CLogQueue() : enqueuePos(0), processed(0), dropped(0), level(VIEWER_LOG_LEVEL), stopping(false) {
+    for (size_t i = 0; i < LOG_CAPACITY; ++i) slots[i].sequence.store(i, memory_order_relaxed);
+    for (auto& enabled : categories) enabled = true;
+}
+
+CLogQueue::~CLogQueue() {
+    shutdown();
+}
+
+void CLogQueue::push(LogLevel messageLevel, LogCategory category, const char* format, va_list args, bool blocking) {
+    if (messageLevel < level.load(memory_order_relaxed) || !categories[category].load(memory_order_relaxed)) return;
+    if (stopping) {
+        writeDirect(messageLevel, format, args);
+        return;
+    }
+    call_once(started, [this]() { consumer = thread(&CLogQueue::consumerLoop, this); });
+
+    uint64_t pos = enqueuePos.load(memory_order_relaxed);
+    LogSlot* slot;
+    for (;;) {
+        slot = &slots[pos & (LOG_CAPACITY - 1)];
+        uint64_t sequence = slot->sequence.load(memory_order_acquire);
+        int64_t diff = (int64_t)sequence - (int64_t)pos;
+        if (diff == 0) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            if (blocking && !stopping) {
+                wake.notify_one();
+                this_thread::yield();
+                pos = enqueuePos.load(memory_order_relaxed);
+                continue;
+            }
+            if (blocking || messageLevel >= LOG_LEVEL_WARNING) writeDirect(messageLevel, format, args);
+            else dropped.fetch_add(1, memory_order_relaxed);
+            return;
+        } else {
+            pos = enqueuePos.load(memory_order_relaxed);
+        }
+    }
+
+    slot->level = messageLevel;
+    slot->category = category;
+    slot->time = chrono::duration<double>(chrono::steady_clock::now() - epoch).count();
+    vsnprintf(slot->text, LOG_MESSAGE_SIZE, format, args);
+    slot->sequence.store(pos + 1, memory_order_release);
+
+    if (messageLevel >= LOG_LEVEL_WARNING || pos + 1 - processed.load(memory_order_relaxed) > LOG_CAPACITY / 2) wake.notify_one();
+}
+
+void CLogQueue::writeDirect(LogLevel messageLevel, const char* format, va_list args) {
+    FILE* stream = messageLevel >= LOG_LEVEL_WARNING ? stderr : stdout;
+    vfprintf(stream, format, args);
+    fputc('\n', stream);
+}
+
+bool CLogQueue::drainOne() {
+    LogSlot& slot = slots[dequeuePos & (LOG_CAPACITY - 1)];
+    if (slot.sequence.load(memory_order_acquire) != dequeuePos + 1) return false;
+
+    FILE* stream = slot.level >= LOG_LEVEL_WARNING ? stderr : stdout;
+    fprintf(stream, "[%9.3f] %-7s %-9s %s\n", slot.time, CLogger::getLevelName(slot.level),
+            CLogger::getCategoryName(slot.category), slot.text);
+
+    slot.sequence.store(dequeuePos + LOG_CAPACITY, memory_order_release);
+    dequeuePos++;
+    processed.store(dequeuePos, memory_order_release);
+    return true;
+}
+
+void CLogQueue::reportDropped() {
+    uint64_t total = dropped.load(memory_order_relaxed);
+    if (total == reportedDropped) return;
+    double time = chrono::duration<double>(chrono::steady_clock::now() - epoch).count();
+    fprintf(stderr, "[%9.3f] %-7s %-9s %llu mensajes descartados (cola llena)\n", time, CLogger::getLevelName(LOG_LEVEL_WARNING),
+            CLogger::getCategoryName(LOG_GENERAL), (unsigned long long)(total - reportedDropped));
+    reportedDropped = total;
+}
+
+void CLogQueue::consumerLoop() {
+    TRACE_THREAD_NAME("Registro");
+    for (;;) {
+        bool any = false;
+        while (drainOne()) any = true;
+        if (any) {
+            reportDropped();
+            fflush(stdout);
+            fflush(stderr);
+        }
+        if (stopping) {
+            while (drainOne()) {}
+            reportDropped();
+            fflush(stdout);
+            fflush(stderr);
+            return;
+        }
+        unique_lock<mutex> lock(wakeMutex);
+        wake.wait_for(lock, chrono::milliseconds(20));
+    }
+}
+
+void CLogQueue::flush() {
+    uint64_t target = enqueuePos.load(memory_order_acquire);
+    if (!consumer.joinable()) return;
+    while (processed.load(memory_order_acquire) < target && !stopping) {
+        wake.notify_one();
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+}
+
+void CLogQueue::shutdown() {
+    if (!consumer.joinable()) return;
+    stopping = true;
+    wake.notify_one();
+    consumer.join();
+}
+
+static CLogQueue& queue() {
+    static CLogQueue instance;
+    return instance;
+}
+
+void CLogger::write(LogLevel level, LogCategory category, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    queue().push(level, category, format, args, false);
+    va_end(args);
+}
+
+void CLogger::writeBlocking(LogLevel level, LogCategory category, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    queue().push(level, category, format, args, true);
+    va_end(args);
+}
+
+void CLogger::setLevel(LogLevel level) {
+    queue().setLevel(level);
+}
+
+LogLevel CLogger::getLevel() {
+    return queue().getLevel();
+}
+
+void CLogger::setCategoryEnabled(LogCategory category, bool enabled) {
+    queue().setCategoryEnabled(category, enabled);
+}
+
+void CLogger::flush() {
+    queue().flush();
+}
+
+void CLogger::shutdown() {
+    queue().shutdown();
+}
+
+uint64_t CLogger::getDropped() {
+    return queue().getDropped();
+}
+
+const char* CLogger::getLevelName(int level) {
+    static const char* names[] = { "TRAZA", "DEPURAR", "INFO", "AVISO", "ERROR" };
+    return level >= 0 && level <= LOG_LEVEL_ERROR ? names[level] : "?";
+}
+
+const char* CLogger::getCategoryName(int category) {
+    static const char* names[LOG_CATEGORY_COUNT] = { "General", "Entrada", "Render", "E/S", "Geometria", "Texturas" };
+    return category >= 0 && category < LOG_CATEGORY_COUNT ? names[category] : "?";
+}
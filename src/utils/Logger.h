@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+
+enum LogLevel {
+    LOG_LEVEL_TRACE,
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARNING,
+    LOG_LEVEL_ERROR
+};
+
+enum LogCategory {
+    LOG_GENERAL,
+    LOG_INPUT,
+    LOG_RENDER,
+    LOG_IO,
+    LOG_GEOMETRY,
+    LOG_TEXTURES,
+    LOG_CATEGORY_COUNT
+};
+
+#ifndef VIEWER_LOG_LEVEL
+#ifdef _DEBUG
+#define VIEWER_LOG_LEVEL 1
+#else
+#define VIEWER_LOG_LEVEL 2
+#endif
+#endif
+
+class CLogger {
+public:
+    static void write(LogLevel level, LogCategory category, const char* format, ...);
+    static void writeBlocking(LogLevel level, LogCategory category, const char* format, ...);
+    static void setLevel(LogLevel level);
+    static LogLevel getLevel();
+    static void setCategoryEnabled(LogCategory category, bool enabled);
+    static void flush();
+    static void shutdown();
+    static uint64_t getDropped();
+    static const char* getLevelName(int level);
+    static const char* getCategoryName(int category);
+};
+
+#if VIEWER_LOG_LEVEL <= 0
+#define LOG_TRACE(category, ...) CLogger::write(LOG_LEVEL_TRACE, category, __VA_ARGS__)
+#else
+#define LOG_TRACE(category, ...) ((void)0)
+#endif
+
+#if VIEWER_LOG_LEVEL <= 1
+#define LOG_DEBUG(category, ...) CLogger::write(LOG_LEVEL_DEBUG, category, __VA_ARGS__)
+#else
+#define LOG_DEBUG(category, ...) ((void)0)
+#endif
+
+#if VIEWER_LOG_LEVEL <= 2
+#define LOG_INFO(category, ...) CLogger::write(LOG_LEVEL_INFO, category, __VA_ARGS__)
+#else
+#define LOG_INFO(category, ...) ((void)0)
+#endif
+
+#if VIEWER_LOG_LEVEL <= 3
+#define LOG_WARNING(category, ...) CLogger::write(LOG_LEVEL_WARNING, category, __VA_ARGS__)
+#else
+#define LOG_WARNING(category, ...) ((void)0)
+#endif
+
+#define LOG_ERROR(category, ...) CLogger::write(LOG_LEVEL_ERROR, category, __VA_ARGS__)
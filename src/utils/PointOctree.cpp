@@ -0,0 +1,313 @@
+#include "PointOctree.h"
+#include "ChunkStore.h"
+#include <algorithm>
+#include <cstdio>
+#include <cmath>
+#include <cstddef>
+#include "../glm/glm.hpp"
+
+static const int GRID = 32;
+static const uint32_t LEAF_CAPACITY = 16384;
+static const int MAX_DEPTH = 20;
+
+CPointOctree::~CPointOctree() {
+    release();
+}
+
+static uint32_t packColor(vec3 color) {
+    color = glm::clamp(color, vec3(0.0f), vec3(1.0f));
+    uint32_t r = (uint32_t)lround(color.r * 255.0f);
+    uint32_t g = (uint32_t)lround(color.g * 255.0f);
+    uint32_t b = (uint32_t)lround(color.b * 255.0f);
+    return r | (g << 8) | (b << 16) | (255u << 24);
+}
+
+template <typename Pred>
+static uint32_t partitionRange(vector<uint32_t>& order, uint32_t begin, uint32_t end, Pred pred) {
+    uint32_t split = begin;
+    for (uint32_t i = begin; i < end; ++i) {
+        if (pred(order[i])) std::swap(order[split++], order[i]);
+    }
+    return split;
+}
+
+struct VectorPoints {
+    const vector<vec3>& positions;
+    const vector<vec3>& colors;
+    uint32_t fallback;
+
+    size_t size() const { return positions.size(); }
+    vec3 position(uint32_t i) const { return positions[i]; }
+    uint32_t color(uint32_t i) const { return i < colors.size() ? packColor(colors[i]) : fallback; }
+};
+
+struct StorePoints {
+    const CChunkStore& store;
+    uint32_t fallback;
+
+    size_t size() const { return (size_t)store.getPointCount(); }
+    vec3 position(uint32_t i) const {
+        const float* point = store.getPoint(i);
+        return vec3(point[0], point[1], point[2]);
+    }
+    uint32_t color(uint32_t i) const {
+        if (!store.hasVertexColors()) return fallback;
+        const float* point = store.getPoint(i);
+        return packColor(vec3(point[3], point[4], point[5]));
+    }
+};
+
+template <typename Source>
+int CPointOctree::buildNode(vector<uint32_t>& order, const Source& source, uint32_t begin, uint32_t end, vec3 min, float size, int depth, vector<uint8_t>& cells) {
+    int index = (int)nodes.size();
+    nodes.push_back(PointOctreeNode());
+    nodes[index].min = min;
+    nodes[index].max = min + vec3(size);
+    nodes[index].spacing = size / GRID;
+    nodes[index].firstPoint = begin;
+    if (cancelled) return index;
+
+    if (end - begin <= LEAF_CAPACITY || depth >= MAX_DEPTH) {
+        nodes[index].pointCount = end - begin;
+        nodes[index].spacing = size / std::max(1.0f, cbrtf((float)(end - begin)));
+        builtPoints += end - begin;
+        return index;
+    }
+
+    std::fill(cells.begin(), cells.end(), 0);
+    float cellScale = GRID / size;
+    uint32_t sampled = partitionRange(order, begin, end, [&](uint32_t i) {
+        ivec3 c = glm::clamp(ivec3((source.position(i) - min) * cellScale), ivec3(0), ivec3(GRID - 1));
+        uint8_t& cell = cells[(c.z * GRID + c.y) * GRID + c.x];
+        if (cell) return false;
+        cell = 1;
+        return true;
+    });
+    nodes[index].pointCount = sampled - begin;
+    builtPoints += sampled - begin;
+
+    float half = size * 0.5f;
+    vec3 center = min + vec3(half);
+    uint32_t bounds[9];
+    bounds[0] = sampled;
+    bounds[8] = end;
+    bounds[4] = partitionRange(order, bounds[0], bounds[8], [&](uint32_t i) { return source.position(i).x < center.x; });
+    bounds[2] = partitionRange(order, bounds[0], bounds[4], [&](uint32_t i) { return source.position(i).y < center.y; });
+    bounds[6] = partitionRange(order, bounds[4], bounds[8], [&](uint32_t i) { return source.position(i).y < center.y; });
+    for (int q = 0; q < 8; q += 2) {
+        bounds[q + 1] = partitionRange(order, bounds[q], bounds[q + 2], [&](uint32_t i) { return source.position(i).z < center.z; });
+    }
+
+    for (int child = 0; child < 8; ++child) {
+        if (bounds[child] == bounds[child + 1]) continue;
+        vec3 childMin = min + vec3((child & 4) ? half : 0.0f, (child & 2) ? half : 0.0f, (child & 1) ? half : 0.0f);
+        int childIndex = buildNode(order, source, bounds[child], bounds[child + 1], childMin, half, depth + 1, cells);
+        nodes[index].children[child] = childIndex;
+    }
+    return index;
+}
+
+template <typename Source>
+bool CPointOctree::buildFrom(const Source& source, const string& path) {
+    size_t count = source.size();
+    if (count == 0 || cancelled) return false;
+    totalPoints = count;
+
+    vec3 boxMin = source.position(0), boxMax = boxMin;
+    for (uint32_t i = 1; i < (uint32_t)count; ++i) {
+        vec3 p = source.position(i);
+        boxMin = glm::min(boxMin, p);
+        boxMax = glm::max(boxMax, p);
+    }
+    vec3 extent = boxMax - boxMin;
+    float size = std::max({ extent.x, extent.y, extent.z, 1e-6f }) * 1.0001f;
+
+    vector<uint32_t> order(count);
+    for (uint32_t i = 0; i < (uint32_t)order.size(); ++i) order[i] = i;
+
+    vector<uint8_t> cells(GRID * GRID * GRID);
+    buildNode(order, source, 0, (uint32_t)order.size(), boxMin, size, 0, cells);
+    if (cancelled) return false;
+
+    auto pack = [&](uint32_t i) {
+        PackedPoint point;
+        point.position = source.position(i);
+        point.color = source.color(i);
+        return point;
+    };
+
+    FILE* file = path.empty() ? nullptr : fopen(path.c_str(), "wb");
+    bool written = file != nullptr;
+    if (file) {
+        vector<PackedPoint> chunk;
+        chunk.reserve(1 << 20);
+        for (size_t i = 0; i < order.size() && written && !cancelled; i += chunk.capacity()) {
+            chunk.clear();
+            size_t end = std::min(order.size(), i + chunk.capacity());
+            for (size_t k = i; k < end; ++k) chunk.push_back(pack(order[k]));
+            written = fwrite(chunk.data(), sizeof(PackedPoint), chunk.size(), file) == chunk.size();
+            builtPoints += chunk.size();
+        }
+        written = (fclose(file) == 0) && written && !cancelled;
+    }
+
+    if (written && mapping.open(path)) {
+        cachePath = path;
+        points = (const PackedPoint*)mapping.getData();
+    } else {
+        if (file) remove(path.c_str());
+        if (cancelled) return false;
+        memoryPoints.resize(order.size());
+        for (size_t k = 0; k < order.size(); ++k) memoryPoints[k] = pack(order[k]);
+        points = memoryPoints.data();
+        builtPoints = 2 * count;
+    }
+
+    gpu.assign(nodes.size(), GpuNode());
+    ready = true;
+    return true;
+}
+
+bool CPointOctree::build(const vector<vec3>& positions, const vector<vec3>& colors, vec3 defaultColor, const string& path) {
+    bool ok = buildFrom(VectorPoints{ positions, colors, packColor(defaultColor) }, path);
+    finished = true;
+    return ok;
+}
+
+bool CPointOctree::build(const CChunkStore& store, vec3 defaultColor, const string& path) {
+    bool ok = buildFrom(StorePoints{ store, packColor(defaultColor) }, path);
+    finished = true;
+    return ok;
+}
+
+bool CPointOctree::upload(int node) {
+    const PointOctreeNode& n = nodes[node];
+    GpuNode& g = gpu[node];
+
+    glGenVertexArrays(1, &g.vao);
+    glGenBuffers(1, &g.vbo);
+    glBindVertexArray(g.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, g.vbo);
+    glBufferData(GL_ARRAY_BUFFER, n.pointCount * sizeof(PackedPoint), points + n.firstPoint, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PackedPoint), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PackedPoint), (void*)offsetof(PackedPoint, color));
+    glEnableVertexAttribArray(1);
+
+    residentPoints += n.pointCount;
+    return true;
+}
+
+void CPointOctree::evict(int node) {
+    GpuNode& g = gpu[node];
+    if (g.vbo) glDeleteBuffers(1, &g.vbo);
+    if (g.vao) glDeleteVertexArrays(1, &g.vao);
+    g.vbo = 0;
+    g.vao = 0;
+    residentPoints -= nodes[node].pointCount;
+}
+
+static bool boxVisible(const vec4 planes[6], vec3 min, vec3 max) {
+    for (int p = 0; p < 6; ++p) {
+        vec3 positive(planes[p].x >= 0.0f ? max.x : min.x,
+                      planes[p].y >= 0.0f ? max.y : min.y,
+                      planes[p].z >= 0.0f ? max.z : min.z);
+        if (glm::dot(vec3(planes[p]), positive) + planes[p].w < 0.0f) return false;
+    }
+    return true;
+}
+
+void CPointOctree::render(const mat4& mvp, vec3 cameraPosition, float pixelsPerUnit, float errorPixels) {
+    renderedPoints = 0;
+    renderedNodes = 0;
+    deferredUploads = false;
+    if (!ready || nodes.empty()) return;
+    frame++;
+
+    mat4 m = glm::transpose(mvp);
+    vec4 planes[6] = { m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[3] + m[2], m[3] - m[2] };
+
+    auto priority = [&](int node) {
+        vec3 center = (nodes[node].min + nodes[node].max) * 0.5f;
+        float radius = glm::length(nodes[node].max - center);
+        float distance = glm::length(center - cameraPosition);
+        if (distance <= radius) return 1e30f;
+        return radius / distance * pixelsPerUnit;
+    };
+
+    queue.clear();
+    if (boxVisible(planes, nodes[0].min, nodes[0].max)) queue.push_back(make_pair(priority(0), 0));
+
+    size_t uploaded = 0;
+    while (!queue.empty()) {
+        std::pop_heap(queue.begin(), queue.end());
+        int node = queue.back().second;
+        queue.pop_back();
+        const PointOctreeNode& n = nodes[node];
+        if (renderedPoints + n.pointCount > pointBudget) break;
+
+        GpuNode& g = gpu[node];
+        if (!g.vao) {
+            if (uploaded >= uploadBudget) {
+                deferredUploads = true;
+                continue;
+            }
+            upload(node);
+            uploaded += n.pointCount;
+        }
+        g.lastUsed = frame;
+
+        glBindVertexArray(g.vao);
+        glDrawArrays(GL_POINTS, 0, (GLsizei)n.pointCount);
+        renderedPoints += n.pointCount;
+        renderedNodes++;
+
+        vec3 center = (n.min + n.max) * 0.5f;
+        float distance = std::max(glm::length(center - cameraPosition), 1e-4f);
+        if (n.spacing / distance * pixelsPerUnit <= errorPixels) continue;
+
+        for (int child : n.children) {
+            if (child < 0 || !boxVisible(planes, nodes[child].min, nodes[child].max)) continue;
+            queue.push_back(make_pair(priority(child), child));
+            std::push_heap(queue.begin(), queue.end());
+        }
+    }
+    glBindVertexArray(0);
+
+    while (residentPoints > gpuPointBudget) {
+        int oldest = -1;
+        for (int i = 0; i < (int)gpu.size(); ++i) {
+            if (!gpu[i].vao || gpu[i].lastUsed == frame) continue;
+            if (oldest < 0 || gpu[i].lastUsed < gpu[oldest].lastUsed) oldest = i;
+        }
+        if (oldest < 0) break;
+        evict(oldest);
+    }
+}
+
+void CPointOctree::releaseGpu() {
+    if (!ready) return;
+    for (int i = 0; i < (int)gpu.size(); ++i) {
+        if (gpu[i].vao) evict(i);
+    }
+}
+
+void CPointOctree::release() {
+    releaseGpu();
+    ready = false;
+    gpu.clear();
+    nodes.clear();
+    queue.clear();
+    memoryPoints.clear();
+    memoryPoints.shrink_to_fit();
+    points = nullptr;
+    mapping.close();
+    if (!cachePath.empty()) remove(cachePath.c_str());
+    cachePath.clear();
+    totalPoints = 0;
+    builtPoints = 0;
+    residentPoints = 0;
+    renderedPoints = 0;
+    renderedNodes = 0;
+}
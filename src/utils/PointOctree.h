@@ -0,0 +1,92 @@
+#pragma once
+#include <glad/glad.h>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <utility>
+#include <atomic>
+#include "MappedFile.h"
+#include "../glm/vec3.hpp"
+#include "../glm/mat4x4.hpp"
+
+using namespace std;
+using namespace glm;
+
+class CChunkStore;
+
+struct PackedPoint {
+    vec3 position;
+    uint32_t color;
+};
+
+struct PointOctreeNode {
+    vec3 min;
+    vec3 max;
+    float spacing = 0.0f;
+    uint32_t firstPoint = 0;
+    uint32_t pointCount = 0;
+    int children[8] = { -1, -1, -1, -1, -1, -1, -1, -1 };
+};
+
+class CPointOctree {
+    struct GpuNode {
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        uint64_t lastUsed = 0;
+    };
+
+    vector<PointOctreeNode> nodes;
+    vector<GpuNode> gpu;
+    vector<pair<float, int>> queue;
+    CMappedFile mapping;
+    vector<PackedPoint> memoryPoints;
+    const PackedPoint* points = nullptr;
+    string cachePath;
+    atomic<size_t> totalPoints{0};
+    atomic<size_t> builtPoints{0};
+    atomic<bool> ready{false};
+    atomic<bool> finished{false};
+    atomic<bool> cancelled{false};
+
+    uint64_t frame = 0;
+    size_t residentPoints = 0;
+    size_t renderedPoints = 0;
+    int renderedNodes = 0;
+    bool deferredUploads = false;
+
+    size_t pointBudget = 5000000;
+    size_t gpuPointBudget = 10000000;
+    size_t uploadBudget = 2000000;
+
+    template <typename Source>
+    int buildNode(vector<uint32_t>& order, const Source& source, uint32_t begin, uint32_t end, vec3 min, float size, int depth, vector<uint8_t>& cells);
+    template <typename Source>
+    bool buildFrom(const Source& source, const string& path);
+    bool upload(int node);
+    void evict(int node);
+
+public:
+    CPointOctree() {}
+    ~CPointOctree();
+    CPointOctree(const CPointOctree&) = delete;
+    CPointOctree& operator=(const CPointOctree&) = delete;
+
+    bool build(const vector<vec3>& positions, const vector<vec3>& colors, vec3 defaultColor, const string& path);
+    bool build(const CChunkStore& store, vec3 defaultColor, const string& path);
+    void cancel() { cancelled = true; }
+    void render(const mat4& mvp, vec3 cameraPosition, float pixelsPerUnit, float errorPixels);
+    void releaseGpu();
+    void release();
+
+    void setBudgets(size_t points, size_t gpuPoints) { pointBudget = points; gpuPointBudget = gpuPoints; }
+
+    bool isReady() const { return ready; }
+    bool isBuilding() const { return !finished; }
+    float getBuildProgress() const { return totalPoints ? (float)builtPoints / (2.0f * totalPoints) : 0.0f; }
+    size_t getTotalPoints() const { return totalPoints; }
+    int getNodeCount() const { return (int)nodes.size(); }
+    size_t getRenderedPoints() const { return renderedPoints; }
+    int getRenderedNodes() const { return renderedNodes; }
+    bool hasDeferredUploads() const { return deferredUploads; }
+    size_t getResidentPoints() const { return residentPoints; }
+};
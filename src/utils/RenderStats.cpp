@@ -0,0 +1,281 @@
+#include "RenderStats.h"
+#include <cstdio>
+#include <ctime>
+#include "Logger.h"
+#include <filesystem>
+
+static CRenderStats* activeStats = nullptr;
+
+static PFNGLDRAWARRAYSPROC realDrawArrays;
+static PFNGLDRAWARRAYSINSTANCEDPROC realDrawArraysInstanced;
+static PFNGLUNIFORM1IPROC realUniform1i;
+static PFNGLUNIFORM1FPROC realUniform1f;
+static PFNGLUNIFORM3FPROC realUniform3f;
+static PFNGLUNIFORM3FVPROC realUniform3fv;
+static PFNGLUNIFORMMATRIX4FVPROC realUniformMatrix4fv;
+static PFNGLBINDTEXTUREPROC realBindTexture;
+static PFNGLBINDVERTEXARRAYPROC realBindVertexArray;
+static PFNGLUSEPROGRAMPROC realUseProgram;
+static PFNGLPOLYGONMODEPROC realPolygonMode;
+static PFNGLENABLEPROC realEnable;
+static PFNGLDISABLEPROC realDisable;
+static PFNGLPOINTSIZEPROC realPointSize;
+static PFNGLLINEWIDTHPROC realLineWidth;
+static PFNGLBUFFERDATAPROC realBufferData;
+static PFNGLBUFFERSUBDATAPROC realBufferSubData;
+
+void RenderCounters::add(const RenderCounters& other) {
+    drawCalls += other.drawCalls;
+    triangles += other.triangles;
+    lines += other.lines;
+    points += other.points;
+    stateChanges += other.stateChanges;
+    uniformUploads += other.uniformUploads;
+    bufferBytes += other.bufferBytes;
+    drawnSubMeshes += other.drawnSubMeshes;
+    culledSubMeshes += other.culledSubMeshes;
+}
+
+static void countDraw(GLenum mode, GLsizei count, GLsizei instances) {
+    RenderCounters& c = activeStats->counters();
+    c.drawCalls++;
+    uint64_t total = (uint64_t)count * (uint64_t)instances;
+    if (mode == GL_TRIANGLES) c.triangles += total / 3;
+    else if (mode == GL_LINES) c.lines += total / 2;
+    else if (mode == GL_POINTS) c.points += total;
+}
+
+static void APIENTRY hookDrawArrays(GLenum mode, GLint first, GLsizei count) {
+    countDraw(mode, count, 1);
+    realDrawArrays(mode, first, count);
+}
+
+static void APIENTRY hookDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances) {
+    countDraw(mode, count, instances);
+    realDrawArraysInstanced(mode, first, count, instances);
+}
+
+static void APIENTRY hookUniform1i(GLint location, GLint v0) {
+    activeStats->counters().uniformUploads++;
+    realUniform1i(location, v0);
+}
+
+static void APIENTRY hookUniform1f(GLint location, GLfloat v0) {
+    activeStats->counters().uniformUploads++;
+    realUniform1f(location, v0);
+}
+
+static void APIENTRY hookUniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2) {
+    activeStats->counters().uniformUploads++;
+    realUniform3f(location, v0, v1, v2);
+}
+
+static void APIENTRY hookUniform3fv(GLint location, GLsizei count, const GLfloat* value) {
+    activeStats->counters().uniformUploads++;
+    realUniform3fv(location, count, value);
+}
+
+static void APIENTRY hookUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+    activeStats->counters().uniformUploads++;
+    realUniformMatrix4fv(location, count, transpose, value);
+}
+
+static void APIENTRY hookBindTexture(GLenum target, GLuint texture) {
+    activeStats->counters().stateChanges++;
+    realBindTexture(target, texture);
+}
+
+static void APIENTRY hookBindVertexArray(GLuint array) {
+    activeStats->counters().stateChanges++;
+    realBindVertexArray(array);
+}
+
+static void APIENTRY hookUseProgram(GLuint program) {
+    activeStats->counters().stateChanges++;
+    realUseProgram(program);
+}
+
+static void APIENTRY hookPolygonMode(GLenum face, GLenum mode) {
+    activeStats->counters().stateChanges++;
+    realPolygonMode(face, mode);
+}
+
+static void APIENTRY hookEnable(GLenum cap) {
+    activeStats->counters().stateChanges++;
+    realEnable(cap);
+}
+
+static void APIENTRY hookDisable(GLenum cap) {
+    activeStats->counters().stateChanges++;
+    realDisable(cap);
+}
+
+static void APIENTRY hookPointSize(GLfloat size) {
+    activeStats->counters().stateChanges++;
+    realPointSize(size);
+}
+
+static void APIENTRY hookLineWidth(GLfloat width) {
+    activeStats->counters().stateChanges++;
+    realLineWidth(width);
+}
+
+static void APIENTRY hookBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+    if (data) activeStats->counters().bufferBytes += (uint64_t)size;
+    realBufferData(target, size, data, usage);
+}
+
+static void APIENTRY hookBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+    activeStats->counters().bufferBytes += (uint64_t)size;
+    realBufferSubData(target, offset, size, data);
+}
+
+template <typename T>
+static void hook(T& function, T& real, T replacement) {
+    real = function;
+    if (function) function = replacement;
+}
+
+CRenderStats::~CRenderStats() {
+    uninstall();
+}
+
+void CRenderStats::install() {
+    if (installed || activeStats) return;
+    activeStats = this;
+    installed = true;
+
+    hook(glad_glDrawArrays, realDrawArrays, hookDrawArrays);
+    hook(glad_glDrawArraysInstanced, realDrawArraysInstanced, hookDrawArraysInstanced);
+    hook(glad_glUniform1i, realUniform1i, hookUniform1i);
+    hook(glad_glUniform1f, realUniform1f, hookUniform1f);
+    hook(glad_glUniform3f, realUniform3f, hookUniform3f);
+    hook(glad_glUniform3fv, realUniform3fv, hookUniform3fv);
+    hook(glad_glUniformMatrix4fv, realUniformMatrix4fv, hookUniformMatrix4fv);
+    hook(glad_glBindTexture, realBindTexture, hookBindTexture);
+    hook(glad_glBindVertexArray, realBindVertexArray, hookBindVertexArray);
+    hook(glad_glUseProgram, realUseProgram, hookUseProgram);
+    hook(glad_glPolygonMode, realPolygonMode, hookPolygonMode);
+    hook(glad_glEnable, realEnable, hookEnable);
+    hook(glad_glDisable, realDisable, hookDisable);
+    hook(glad_glPointSize, realPointSize, hookPointSize);
+    hook(glad_glLineWidth, realLineWidth, hookLineWidth);
+    hook(glad_glBufferData, realBufferData, hookBufferData);
+    hook(glad_glBufferSubData, realBufferSubData, hookBufferSubData);
+}
+
+void CRenderStats::uninstall() {
+    if (!installed) return;
+
+    glad_glDrawArrays = realDrawArrays;
+    glad_glDrawArraysInstanced = realDrawArraysInstanced;
+    glad_glUniform1i = realUniform1i;
+    glad_glUniform1f = realUniform1f;
+    glad_glUniform3f = realUniform3f;
+    glad_glUniform3fv = realUniform3fv;
+    glad_glUniformMatrix4fv = realUniformMatrix4fv;
+    glad_glBindTexture = realBindTexture;
+    glad_glBindVertexArray = realBindVertexArray;
+    glad_glUseProgram = realUseProgram;
+    glad_glPolygonMode = realPolygonMode;
+    glad_glEnable = realEnable;
+    glad_glDisable = realDisable;
+    glad_glPointSize = realPointSize;
+    glad_glLineWidth = realLineWidth;
+    glad_glBufferData = realBufferData;
+    glad_glBufferSubData = realBufferSubData;
+
+    installed = false;
+    activeStats = nullptr;
+}
+
+void CRenderStats::endFrame() {
+    last = current;
+    interval.add(current);
+    total.add(current);
+    frames++;
+    intervalFrames++;
+    current = RenderCounters();
+}
+
+void CRenderStats::poll(double now) {
+    if (!output) return;
+    if (lastWrite < 0.0) {
+        lastWrite = now;
+        return;
+    }
+    if (now - lastWrite < period) return;
+    lastWrite = now;
+
+    RenderCounters average;
+    if (intervalFrames > 0) {
+        uint64_t RenderCounters::* const fields[] = {
+            &RenderCounters::drawCalls, &RenderCounters::triangles, &RenderCounters::lines, &RenderCounters::points,
+            &RenderCounters::stateChanges, &RenderCounters::uniformUploads, &RenderCounters::bufferBytes,
+            &RenderCounters::drawnSubMeshes, &RenderCounters::culledSubMeshes
+        };
+        for (auto field : fields) average.*field = interval.*field / intervalFrames;
+    }
+
+    bool ok = format == METRICS_PROMETHEUS ? writePrometheus(average) : writeCsv(average);
+    if (!ok) {
+        LOG_ERROR(LOG_IO, "Error escribiendo metricas: %s", outputPath.c_str());
+        output = false;
+    }
+    interval = RenderCounters();
+    intervalFrames = 0;
+}
+
+bool CRenderStats::writeCsv(const RenderCounters& average) {
+    FILE* probe = fopen(outputPath.c_str(), "rb");
+    bool exists = probe != nullptr;
+    if (probe) fclose(probe);
+
+    FILE* file = fopen(outputPath.c_str(), "ab");
+    if (!file) return false;
+    if (!exists) {
+        fprintf(file, "timestamp,frames,draw_calls,triangles,lines,points,state_changes,uniform_uploads,buffer_bytes,drawn_submeshes,culled_submeshes\n");
+    }
+    fprintf(file, "%lld,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n", (long long)time(nullptr),
+            (unsigned long long)intervalFrames, (unsigned long long)average.drawCalls, (unsigned long long)average.triangles,
+            (unsigned long long)average.lines, (unsigned long long)average.points, (unsigned long long)average.stateChanges,
+            (unsigned long long)average.uniformUploads, (unsigned long long)average.bufferBytes,
+            (unsigned long long)average.drawnSubMeshes, (unsigned long long)average.culledSubMeshes);
+    return fclose(file) == 0;
+}
+
+bool CRenderStats::writePrometheus(const RenderCounters& average) {
+    string temporary = outputPath + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (!file) return false;
+
+    struct Gauge {
+        const char* name;
+        const char* help;
+        uint64_t value;
+    };
+    const Gauge gauges[] = {
+        { "viewer_draw_calls", "Draw calls por frame", average.drawCalls },
+        { "viewer_triangles", "Triangulos enviados por frame", average.triangles },
+        { "viewer_lines", "Lineas enviadas por frame", average.lines },
+        { "viewer_points", "Puntos enviados por frame", average.points },
+        { "viewer_state_changes", "Cambios de estado GL por frame", average.stateChanges },
+        { "viewer_uniform_uploads", "Uniforms subidos por frame", average.uniformUploads },
+        { "viewer_buffer_bytes", "Bytes subidos a buffers por frame", average.bufferBytes },
+        { "viewer_drawn_submeshes", "Sub-mallas dibujadas por frame", average.drawnSubMeshes },
+        { "viewer_culled_submeshes", "Sub-mallas descartadas por frame", average.culledSubMeshes },
+        { "viewer_interval_frames", "Frames en el ultimo intervalo", intervalFrames },
+    };
+    for (const auto& gauge : gauges) {
+        fprintf(file, "# HELP %s %s\n# TYPE %s gauge\n%s %llu\n", gauge.name, gauge.help, gauge.name, gauge.name, (unsigned long long)gauge.value);
+    }
+    fprintf(file, "# HELP viewer_frames_total Frames renderizados\n# TYPE viewer_frames_total counter\nviewer_frames_total %llu\n", (unsigned long long)frames);
+    fprintf(file, "# HELP viewer_draw_calls_total Draw calls acumulados\n# TYPE viewer_draw_calls_total counter\nviewer_draw_calls_total %llu\n", (unsigned long long)total.drawCalls);
+
+    bool ok = fclose(file) == 0;
+    std::error_code error;
+    if (ok) std::filesystem::rename(temporary, outputPath, error);
+    ok = ok && !error;
+    if (!ok) std::filesystem::remove(temporary, error);
+    return ok;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <glad/glad.h>
+#include <string>
+#include <cstdint>
+
+using namespace std;
+
+struct RenderCounters {
+    uint64_t drawCalls = 0;
+    uint64_t triangles = 0;
+    uint64_t lines = 0;
+    uint64_t points = 0;
+    uint64_t stateChanges = 0;
+    uint64_t uniformUploads = 0;
+    uint64_t bufferBytes = 0;
+    uint64_t drawnSubMeshes = 0;
+    uint64_t culledSubMeshes = 0;
+
+    void add(const RenderCounters& other);
+};
+
+enum MetricsFormat {
+    METRICS_CSV,
+    METRICS_PROMETHEUS
+};
+
+class CRenderStats {
+    RenderCounters current;
+    RenderCounters last;
+    RenderCounters interval;
+    RenderCounters total;
+    uint64_t frames = 0;
+    uint64_t intervalFrames = 0;
+    bool installed = false;
+
+    string outputPath = "render_metrics.csv";
+    MetricsFormat format = METRICS_CSV;
+    double period = 10.0;
+    double lastWrite = -1.0;
+    bool output = false;
+
+    bool writeCsv(const RenderCounters& average);
+    bool writePrometheus(const RenderCounters& average);
+
+public:
+    CRenderStats() {}
+    ~CRenderStats();
+    CRenderStats(const CRenderStats&) = delete;
+    CRenderStats& operator=(const CRenderStats&) = delete;
+
+    void install();
+    void uninstall();
+    void endFrame();
+    void poll(double now);
+
+    RenderCounters& counters() { return current; }
+    void subMesh(bool drawn) { if (drawn) current.drawnSubMeshes++; else current.culledSubMeshes++; }
+
+    const RenderCounters& getLastFrame() const { return last; }
+    const RenderCounters& getTotal() const { return total; }
+    uint64_t getFrames() const { return frames; }
+
+    void setOutput(bool enabled) { output = enabled; lastWrite = -1.0; }
+    void setOutputPath(const string& path) { outputPath = path; }
+    void setFormat(MetricsFormat value) { format = value; }
+    void setPeriod(double seconds) { period = seconds; }
+    bool isOutputEnabled() const { return output; }
+    const string& getOutputPath() const { return outputPath; }
+    MetricsFormat getFormat() const { return format; }
+    double getPeriod() const { return period; }
+};
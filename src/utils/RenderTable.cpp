@@ -0,0 +1,44 @@
+#include "RenderTable.h"
+
+void CRenderTable::build(const vector<SubMesh>& meshes) {
+    size_t count = meshes.size();
+    size_t words = (count + 63) / 64;
+    startVertex.resize(count);
+    vertexCount.resize(count);
+    material.resize(count);
+    offset.resize(count);
+    color.resize(count);
+    faceBits.assign(words, 0);
+    wireframeBits.assign(words, 0);
+    vertexBits.assign(words, 0);
+    normalBits.assign(words, 0);
+
+    for (int i = 0; i < (int)count; ++i) update(meshes, i);
+}
+
+void CRenderTable::update(const vector<SubMesh>& meshes, int index) {
+    if (index < 0 || index >= size() || index >= (int)meshes.size()) return;
+
+    const SubMesh& mesh = meshes[index];
+    startVertex[index] = mesh.startVertex;
+    vertexCount[index] = mesh.vertexCount;
+    material[index] = mesh.material;
+    offset[index] = mesh.offset + mesh.instanceTranslation;
+    color[index] = mesh.color;
+    setBit(faceBits, index, mesh.showFaces);
+    setBit(wireframeBits, index, mesh.showWireframe);
+    setBit(vertexBits, index, mesh.showVertices);
+    setBit(normalBits, index, mesh.showNormals);
+}
+
+void CRenderTable::clear() {
+    startVertex.clear();
+    vertexCount.clear();
+    material.clear();
+    offset.clear();
+    color.clear();
+    faceBits.clear();
+    wireframeBits.clear();
+    vertexBits.clear();
+    normalBits.clear();
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "3DFigure.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+static inline int lowestSetBit(uint64_t word) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return (int)index;
+#else
+    return __builtin_ctzll(word);
+#endif
+}
+
+class CRenderTable {
+    vector<int> startVertex;
+    vector<int> vertexCount;
+    vector<int> material;
+    vector<vec3> offset;
+    vector<vec3> color;
+    vector<uint64_t> faceBits;
+    vector<uint64_t> wireframeBits;
+    vector<uint64_t> vertexBits;
+    vector<uint64_t> normalBits;
+
+    static void setBit(vector<uint64_t>& bits, int index, bool value) {
+        uint64_t mask = (uint64_t)1 << (index & 63);
+        if (value) bits[index >> 6] |= mask;
+        else bits[index >> 6] &= ~mask;
+    }
+
+    static bool testBit(const vector<uint64_t>& bits, int index) {
+        return (bits[index >> 6] >> (index & 63)) & 1;
+    }
+
+public:
+    void build(const vector<SubMesh>& meshes);
+    void update(const vector<SubMesh>& meshes, int index);
+    void clear();
+
+    int size() const { return (int)startVertex.size(); }
+    int getStartVertex(int index) const { return startVertex[index]; }
+    int getVertexCount(int index) const { return vertexCount[index]; }
+    int getMaterial(int index) const { return material[index]; }
+    const vec3& getOffset(int index) const { return offset[index]; }
+    const vec3& getColor(int index) const { return color[index]; }
+
+    bool showsFaces(int index) const { return testBit(faceBits, index); }
+    bool showsWireframe(int index) const { return testBit(wireframeBits, index); }
+    bool showsVertices(int index) const { return testBit(vertexBits, index); }
+    bool showsNormals(int index) const { return testBit(normalBits, index); }
+
+    const vector<uint64_t>& getFaceBits() const { return faceBits; }
+    const vector<uint64_t>& getWireframeBits() const { return wireframeBits; }
+    const vector<uint64_t>& getVertexBits() const { return vertexBits; }
+    const vector<uint64_t>& getNormalBits() const { return normalBits; }
+
+    template <typename F>
+    static void forEachSet(const vector<uint64_t>& bits, F f) {
+        for (size_t word = 0; word < bits.size(); ++word) {
+            uint64_t remaining = bits[word];
+            while (remaining) {
+                f((int)(word * 64) + lowestSetBit(remaining));
+                remaining &= remaining - 1;
+            }
+        }
+    }
+};
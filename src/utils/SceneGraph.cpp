@@ -0,0 +1,73 @@
+#include "SceneGraph.h"
+#include <algorithm>
+#include "../glm/gtc/matrix_transform.hpp"
+#include "../glm/gtx/quaternion.hpp"
+
+void CSceneGraph::clear() {
+    parents.clear();
+    positions.clear();
+    rotations.clear();
+    scales.clear();
+    worlds.clear();
+    dirty.clear();
+    hasDirty = false;
+}
+
+void CSceneGraph::reserve(size_t count) {
+    parents.reserve(count);
+    positions.reserve(count);
+    rotations.reserve(count);
+    scales.reserve(count);
+    worlds.reserve(count);
+    dirty.reserve(count);
+}
+
+int CSceneGraph::addNode(int parent, vec3 position, quat rotation, vec3 scale) {
+    int node = (int)parents.size();
+    if (parent >= node) parent = -1;
+
+    parents.push_back(parent);
+    positions.push_back(position);
+    rotations.push_back(rotation);
+    scales.push_back(scale);
+    worlds.push_back(mat4(1.0f));
+    dirty.push_back(1);
+    hasDirty = true;
+    return node;
+}
+
+void CSceneGraph::setLocal(int node, vec3 position, quat rotation, vec3 scale) {
+    if (positions[node] == position && rotations[node] == rotation && scales[node] == scale) return;
+    positions[node] = position;
+    rotations[node] = rotation;
+    scales[node] = scale;
+    dirty[node] = 1;
+    hasDirty = true;
+}
+
+void CSceneGraph::setPosition(int node, vec3 position) {
+    if (positions[node] == position) return;
+    positions[node] = position;
+    dirty[node] = 1;
+    hasDirty = true;
+}
+
+void CSceneGraph::update() {
+    if (!hasDirty) return;
+    const int count = (int)parents.size();
+
+    for (int i = 0; i < count; ++i) {
+        int parent = parents[i];
+        if (parent >= 0 && dirty[parent]) dirty[i] = 1;
+        if (!dirty[i]) continue;
+
+        mat4 local = glm::translate(mat4(1.0f), positions[i]);
+        local = local * glm::mat4_cast(rotations[i]);
+        local = glm::scale(local, scales[i]);
+
+        worlds[i] = parent >= 0 ? worlds[parent] * local : local;
+    }
+
+    std::fill(dirty.begin(), dirty.end(), 0);
+    hasDirty = false;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#define GLM_ENABLE_EXPERIMENTAL
+#include "../glm/vec3.hpp"
+#include "../glm/mat4x4.hpp"
+#include "../glm/gtc/quaternion.hpp"
+
+using namespace std;
+using namespace glm;
+
+class CSceneGraph {
+    vector<int> parents;
+    vector<vec3> positions;
+    vector<quat> rotations;
+    vector<vec3> scales;
+    vector<mat4> worlds;
+    vector<uint8_t> dirty;
+    bool hasDirty = false;
+
+public:
+    void clear();
+    void reserve(size_t count);
+    int addNode(int parent, vec3 position = vec3(0.0f), quat rotation = quat(1.0f, 0.0f, 0.0f, 0.0f), vec3 scale = vec3(1.0f));
+
+    void setLocal(int node, vec3 position, quat rotation, vec3 scale);
+    void setPosition(int node, vec3 position);
+
+    void update();
+
+    int size() const { return (int)parents.size(); }
+    int getParent(int node) const { return parents[node]; }
+    const mat4& getWorld(int node) const { return worlds[node]; }
+};
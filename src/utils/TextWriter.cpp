@@ -0,0 +1,37 @@
+#include "TextWriter.h"
+#include <charconv>
+#include <cstring>
+
+void CTextWriter::append(const char* text) {
+    buffer.insert(buffer.end(), text, text + strlen(text));
+}
+
+void CTextWriter::append(const string& text) {
+    buffer.insert(buffer.end(), text.begin(), text.end());
+}
+
+void CTextWriter::appendQuoted(const char* text) {
+    buffer.push_back('"');
+    for (const char* c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') buffer.push_back('\\');
+        if ((unsigned char)*c >= 0x20) buffer.push_back(*c);
+    }
+    buffer.push_back('"');
+}
+
+void CTextWriter::appendInt(long long value) {
+    char digits[24];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+    buffer.insert(buffer.end(), digits, result.ptr);
+}
+
+void CTextWriter::appendFloat(float value) {
+    char digits[32];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+    buffer.insert(buffer.end(), digits, result.ptr);
+}
+
+bool CTextWriter::writeTo(FILE* file) const {
+    if (buffer.empty()) return true;
+    return fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdio>
+
+using namespace std;
+
+class CTextWriter {
+    vector<char> buffer;
+
+public:
+    void reserve(size_t bytes) { buffer.reserve(bytes); }
+    void clear() { buffer.clear(); }
+
+    void append(char c) { buffer.push_back(c); }
+    void append(const char* text);
+    void append(const string& text);
+    void appendQuoted(const char* text);
+    void appendInt(long long value);
+    void appendFloat(float value);
+
+    const char* data() const { return buffer.data(); }
+    size_t size() const { return buffer.size(); }
+    bool writeTo(FILE* file) const;
+};
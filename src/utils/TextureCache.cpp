@@ -0,0 +1,450 @@
+#include "TextureCache.h"
+#include "AllocationTracker.h"
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include "Logger.h"
+#include <filesystem>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb/stb_image.h"
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+struct CompressedCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+};
+
+static const uint32_t COMPRESSED_CACHE_VERSION = 2;
+
+static GLenum glFormatFor(BlockFormat format) {
+    return format == BlockFormat::BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+static bool sourceStamp(const string& path, uint64_t& size, int64_t& time) {
+    std::error_code error;
+    std::filesystem::path source(path);
+    size = (uint64_t)std::filesystem::file_size(source, error);
+    if (error) return false;
+    time = (int64_t)std::filesystem::last_write_time(source, error).time_since_epoch().count();
+    return !error;
+}
+
+static bool hasGLExtension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && strcmp(extension, name) == 0) return true;
+    }
+    return false;
+}
+
+static void flipRows(unsigned char* pixels, int width, int height) {
+    size_t rowBytes = (size_t)width * 4;
+    vector<unsigned char> row(rowBytes);
+    for (int y = 0; y < height / 2; ++y) {
+        unsigned char* top = pixels + y * rowBytes;
+        unsigned char* bottom = pixels + (height - 1 - y) * rowBytes;
+        memcpy(row.data(), top, rowBytes);
+        memcpy(top, bottom, rowBytes);
+        memcpy(bottom, row.data(), rowBytes);
+    }
+}
+
+static void buildMipChain(DecodedTexture& tex) {
+    int w = tex.width;
+    int h = tex.height;
+    while (w > 1 || h > 1) {
+        const vector<unsigned char>& src = tex.mips.back();
+        int nw = std::max(1, w / 2);
+        int nh = std::max(1, h / 2);
+        vector<unsigned char> dst((size_t)nw * nh * 4);
+
+        for (int y = 0; y < nh; ++y) {
+            int y0 = std::min(2 * y, h - 1), y1 = std::min(2 * y + 1, h - 1);
+            for (int x = 0; x < nw; ++x) {
+                int x0 = std::min(2 * x, w - 1), x1 = std::min(2 * x + 1, w - 1);
+                for (int c = 0; c < 4; ++c) {
+                    int sum = src[((size_t)y0 * w + x0) * 4 + c] + src[((size_t)y0 * w + x1) * 4 + c] +
+                              src[((size_t)y1 * w + x0) * 4 + c] + src[((size_t)y1 * w + x1) * 4 + c];
+                    dst[((size_t)y * nw + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+        tex.mips.push_back(std::move(dst));
+        w = nw;
+        h = nh;
+    }
+}
+
+CTextureCache::CTextureCache() : shuttingDown(false) {}
+
+CTextureCache::~CTextureCache() {
+    shuttingDown = true;
+    workers.reset();
+}
+
+int CTextureCache::request(const string& path) {
+    if (path.empty()) return -1;
+
+    auto found = slots.find(path);
+    if (found != slots.end()) {
+        entries[found->second].references++;
+        return found->second;
+    }
+
+    if (!compressionChecked) {
+        compressionChecked = true;
+        useCompression = compressionEnabled && hasGLExtension("GL_EXT_texture_compression_s3tc");
+    }
+
+    int slot = (int)entries.size();
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        entries.push_back(Entry());
+    }
+    Entry& entry = entries[slot];
+    entry.path = path;
+    entry.references = 1;
+    slots[path] = slot;
+
+    if (!workers) workers.reset(new CThreadPool());
+    bool compress = useCompression;
+    uint32_t generation = entry.generation;
+    workers->enqueue([this, slot, generation, path, compress]() { decode(slot, generation, path, compress); });
+    return slot;
+}
+
+void CTextureCache::releaseSlot(int slot) {
+    if (slot < 0 || slot >= (int)entries.size() || entries[slot].references <= 0) return;
+    Entry& entry = entries[slot];
+    if (--entry.references > 0) return;
+
+    if (entry.texture) glDeleteTextures(1, &entry.texture);
+    uploadQueue.erase(std::remove(uploadQueue.begin(), uploadQueue.end(), slot), uploadQueue.end());
+    slots.erase(entry.path);
+
+    uint32_t generation = entry.generation + 1;
+    entry = Entry();
+    entry.generation = generation;
+    freeSlots.push_back(slot);
+}
+
+void CTextureCache::decode(int slot, uint32_t generation, string path, bool compress) {
+    if (shuttingDown) return;
+    CAllocationScope scope(ALLOC_TEXTURES);
+
+    shared_ptr<DecodedTexture> tex;
+    if (compress) tex = loadCompressed(path);
+    if (!tex) {
+        tex = decodeSource(path);
+        if (tex && compress) tex = transcode(path, *tex);
+    }
+
+    lock_guard<mutex> lock(completedMutex);
+    completed.push_back(CompletedTexture{ slot, generation, tex });
+}
+
+shared_ptr<DecodedTexture> CTextureCache::decodeSource(const string& path) {
+    int width = 0, height = 0, channels = 0;
+    unsigned char* pixels = stbi_load(path.c_str(), &width, &height, &channels, 4);
+    if (!pixels) return nullptr;
+
+    shared_ptr<DecodedTexture> tex = make_shared<DecodedTexture>();
+    tex->width = width;
+    tex->height = height;
+    flipRows(pixels, width, height);
+    tex->mips.push_back(vector<unsigned char>(pixels, pixels + (size_t)width * height * 4));
+    stbi_image_free(pixels);
+    buildMipChain(*tex);
+    return tex;
+}
+
+string CTextureCache::cachePathFor(const string& path) const {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : path) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bct", (unsigned long long)hash);
+    return cacheDirectory + "/" + name;
+}
+
+shared_ptr<DecodedTexture> CTextureCache::loadCompressed(const string& path) {
+    uint64_t sourceSize = 0;
+    int64_t sourceTime = 0;
+    if (!sourceStamp(path, sourceSize, sourceTime)) return nullptr;
+
+    shared_ptr<CMappedFile> mapping = make_shared<CMappedFile>();
+    if (!mapping->open(cachePathFor(path))) return nullptr;
+    if (mapping->getSize() < sizeof(CompressedCacheHeader)) return nullptr;
+
+    CompressedCacheHeader header;
+    memcpy(&header, mapping->getData(), sizeof(header));
+    if (memcmp(header.magic, "BCT1", 4) != 0 || header.version != COMPRESSED_CACHE_VERSION ||
+        header.sourceSize != sourceSize || header.sourceTime != sourceTime || header.levelCount == 0) {
+        return nullptr;
+    }
+    BlockFormat format = (BlockFormat)header.format;
+    if (format != BlockFormat::BC1 && format != BlockFormat::BC3) return nullptr;
+
+    size_t offset = sizeof(header) + header.levelCount * sizeof(uint64_t);
+    if (offset > mapping->getSize()) return nullptr;
+
+    shared_ptr<DecodedTexture> tex = make_shared<DecodedTexture>();
+    tex->width = (int)header.width;
+    tex->height = (int)header.height;
+    tex->compressedFormat = glFormatFor(format);
+
+    for (uint32_t level = 0; level < header.levelCount; ++level) {
+        uint64_t levelSize = 0;
+        memcpy(&levelSize, mapping->getData() + sizeof(header) + level * sizeof(uint64_t), sizeof(levelSize));
+        int lw = std::max(1, tex->width >> level);
+        int lh = std::max(1, tex->height >> level);
+        if (levelSize != compressedLevelSize(format, lw, lh) || offset + levelSize > mapping->getSize()) return nullptr;
+
+        tex->levelData.push_back(mapping->getData() + offset);
+        tex->levelSizes.push_back((size_t)levelSize);
+        offset += (size_t)levelSize;
+    }
+    tex->mapping = mapping;
+    return tex;
+}
+
+shared_ptr<DecodedTexture> CTextureCache::transcode(const string& path, const DecodedTexture& source) {
+    BlockFormat format = BlockFormat::BC1;
+    const vector<unsigned char>& base = source.mips[0];
+    for (size_t i = 3; i < base.size(); i += 4) {
+        if (base[i] != 255) {
+            format = BlockFormat::BC3;
+            break;
+        }
+    }
+
+    shared_ptr<DecodedTexture> tex = make_shared<DecodedTexture>();
+    tex->width = source.width;
+    tex->height = source.height;
+    tex->compressedFormat = glFormatFor(format);
+
+    for (size_t level = 0; level < source.mips.size(); ++level) {
+        int lw = std::max(1, source.width >> level);
+        int lh = std::max(1, source.height >> level);
+        tex->mips.push_back(compressImage(format, source.mips[level].data(), lw, lh));
+    }
+    for (const auto& level : tex->mips) {
+        tex->levelData.push_back(level.data());
+        tex->levelSizes.push_back(level.size());
+    }
+
+    CompressedCacheHeader header;
+    memcpy(header.magic, "BCT1", 4);
+    header.version = COMPRESSED_CACHE_VERSION;
+    header.format = (uint32_t)format;
+    header.width = (uint32_t)source.width;
+    header.height = (uint32_t)source.height;
+    header.levelCount = (uint32_t)tex->mips.size();
+    if (!sourceStamp(path, header.sourceSize, header.sourceTime)) return tex;
+
+    std::error_code error;
+    std::filesystem::create_directories(cacheDirectory, error);
+
+    string cachePath = cachePathFor(path);
+    string tempPath = cachePath + ".tmp" + to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (!file) return tex;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (const auto& level : tex->mips) {
+        uint64_t levelSize = level.size();
+        ok = ok && fwrite(&levelSize, sizeof(levelSize), 1, file) == 1;
+    }
+    for (const auto& level : tex->mips) {
+        ok = ok && fwrite(level.data(), 1, level.size(), file) == level.size();
+    }
+    ok = (fclose(file) == 0) && ok;
+
+    if (ok) {
+        std::filesystem::rename(tempPath, cachePath, error);
+        if (!error) return tex;
+    }
+    std::filesystem::remove(tempPath, error);
+    return tex;
+}
+
+void CTextureCache::collectCompleted() {
+    vector<CompletedTexture> done;
+    {
+        lock_guard<mutex> lock(completedMutex);
+        done.swap(completed);
+    }
+
+    for (auto& item : done) {
+        Entry& entry = entries[item.slot];
+        if (entry.generation != item.generation) continue;
+        if (!item.texture) {
+            entry.failed = true;
+            LOG_WARNING(LOG_TEXTURES, "No se pudo cargar la textura %s", entry.path.c_str());
+            continue;
+        }
+        entry.pending = item.texture;
+        uploadQueue.push_back(item.slot);
+    }
+}
+
+void CTextureCache::createTexture(Entry& entry) {
+    DecodedTexture& tex = *entry.pending;
+    int levelCount = tex.compressedFormat ? (int)tex.levelData.size() : (int)tex.mips.size();
+
+    glGenTextures(1, &entry.texture);
+    glBindTexture(GL_TEXTURE_2D, entry.texture);
+    if (!tex.compressedFormat) {
+        for (int level = 0; level < levelCount; ++level) {
+            int lw = std::max(1, tex.width >> level);
+            int lh = std::max(1, tex.height >> level);
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, lw, lh, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+}
+
+size_t CTextureCache::uploadCompressedLevel(Entry& entry) {
+    DecodedTexture& tex = *entry.pending;
+    int level = entry.uploadLevel;
+    int lw = std::max(1, tex.width >> level);
+    int lh = std::max(1, tex.height >> level);
+    size_t bytes = tex.levelSizes[level];
+
+    glBindTexture(GL_TEXTURE_2D, entry.texture);
+    glCompressedTexImage2D(GL_TEXTURE_2D, level, tex.compressedFormat, lw, lh, 0, (GLsizei)bytes, tex.levelData[level]);
+
+    entry.residentBytes += bytes;
+    entry.uploadLevel++;
+    if (entry.uploadLevel >= (int)tex.levelData.size()) {
+        entry.ready = true;
+        entry.pending.reset();
+    }
+    return bytes;
+}
+
+size_t CTextureCache::uploadRows(Entry& entry, size_t byteBudget) {
+    DecodedTexture& tex = *entry.pending;
+
+    int lw = std::max(1, tex.width >> entry.uploadLevel);
+    int lh = std::max(1, tex.height >> entry.uploadLevel);
+    size_t rowBytes = (size_t)lw * 4;
+    int rows = (int)std::min<size_t>(std::max<size_t>(byteBudget / rowBytes, 1), (size_t)(lh - entry.uploadRow));
+    size_t bytes = rows * rowBytes;
+
+    if (pbos[0] == 0) glGenBuffers(2, pbos);
+    GLuint pbo = pbos[nextPbo];
+    nextPbo ^= 1;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (dst) {
+        memcpy(dst, tex.mips[entry.uploadLevel].data() + entry.uploadRow * rowBytes, bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+        glBindTexture(GL_TEXTURE_2D, entry.texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexSubImage2D(GL_TEXTURE_2D, entry.uploadLevel, 0, entry.uploadRow, lw, rows, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    entry.residentBytes += bytes;
+    entry.uploadRow += rows;
+    if (entry.uploadRow >= lh) {
+        entry.uploadRow = 0;
+        entry.uploadLevel++;
+    }
+    if (entry.uploadLevel >= (int)tex.mips.size()) {
+        entry.ready = true;
+        entry.pending.reset();
+    }
+    return bytes;
+}
+
+void CTextureCache::pump(size_t byteBudget) {
+    collectCompleted();
+
+    size_t uploaded = 0;
+    while (!uploadQueue.empty() && uploaded < byteBudget) {
+        Entry& entry = entries[uploadQueue.front()];
+        if (entry.texture == 0) createTexture(entry);
+
+        if (entry.pending->compressedFormat) {
+            uploaded += uploadCompressedLevel(entry);
+        } else {
+            uploaded += uploadRows(entry, byteBudget - uploaded);
+        }
+        if (entry.ready) uploadQueue.pop_front();
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void CTextureCache::release() {
+    shuttingDown = true;
+    workers.reset();
+
+    for (auto& entry : entries) {
+        if (entry.texture) glDeleteTextures(1, &entry.texture);
+    }
+    if (pbos[0]) glDeleteBuffers(2, pbos);
+    pbos[0] = pbos[1] = 0;
+
+    entries.clear();
+    slots.clear();
+    freeSlots.clear();
+    uploadQueue.clear();
+    completed.clear();
+    shuttingDown = false;
+    compressionChecked = false;
+}
+
+GLuint CTextureCache::getTexture(int slot) const {
+    if (slot < 0 || slot >= (int)entries.size() || !entries[slot].ready) return 0;
+    return entries[slot].texture;
+}
+
+int CTextureCache::getReadyCount() const {
+    int count = 0;
+    for (const auto& entry : entries) {
+        if (entry.ready) count++;
+    }
+    return count;
+}
+
+bool CTextureCache::isLoading() const {
+    for (const auto& entry : entries) {
+        if (!entry.path.empty() && !entry.ready && !entry.failed) return true;
+    }
+    return false;
+}
+
+size_t CTextureCache::getResidentBytes() const {
+    size_t bytes = 0;
+    for (const auto& entry : entries) bytes += entry.residentBytes;
+    return bytes;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+#include "ThreadPool.h"
+#include "MappedFile.h"
+#include "BlockCompression.h"
+
+using namespace std;
+
+struct DecodedTexture {
+    int width = 0;
+    int height = 0;
+    GLenum compressedFormat = 0;
+    vector<vector<unsigned char>> mips;
+    vector<const unsigned char*> levelData;
+    vector<size_t> levelSizes;
+    shared_ptr<CMappedFile> mapping;
+};
+
+class CTextureCache {
+    struct Entry {
+        string path;
+        GLuint texture = 0;
+        bool ready = false;
+        bool failed = false;
+        shared_ptr<DecodedTexture> pending;
+        int uploadLevel = 0;
+        int uploadRow = 0;
+        size_t residentBytes = 0;
+        int references = 0;
+        uint32_t generation = 0;
+    };
+
+    vector<Entry> entries;
+    unordered_map<string, int> slots;
+    vector<int> freeSlots;
+    deque<int> uploadQueue;
+
+    unique_ptr<CThreadPool> workers;
+    atomic<bool> shuttingDown;
+    struct CompletedTexture {
+        int slot;
+        uint32_t generation;
+        shared_ptr<DecodedTexture> texture;
+    };
+
+    mutex completedMutex;
+    vector<CompletedTexture> completed;
+
+    GLuint pbos[2] = { 0, 0 };
+    int nextPbo = 0;
+
+    bool compressionEnabled = true;
+    bool compressionChecked = false;
+    bool useCompression = false;
+    string cacheDirectory = "texcache";
+
+    void decode(int slot, uint32_t generation, string path, bool compress);
+    shared_ptr<DecodedTexture> decodeSource(const string& path);
+    shared_ptr<DecodedTexture> loadCompressed(const string& path);
+    shared_ptr<DecodedTexture> transcode(const string& path, const DecodedTexture& source);
+    string cachePathFor(const string& path) const;
+
+    void collectCompleted();
+    void createTexture(Entry& entry);
+    size_t uploadRows(Entry& entry, size_t byteBudget);
+    size_t uploadCompressedLevel(Entry& entry);
+
+public:
+    CTextureCache();
+    ~CTextureCache();
+
+    int request(const string& path);
+    void releaseSlot(int slot);
+    void pump(size_t byteBudget);
+    void release();
+
+    void setCompressionEnabled(bool enabled) { compressionEnabled = enabled; compressionChecked = false; }
+    void setCacheDirectory(const string& directory) { cacheDirectory = directory; }
+    bool isUsingCompression() const { return useCompression; }
+
+    GLuint getTexture(int slot) const;
+    int getTextureCount() const { return (int)slots.size(); }
+    int getReadyCount() const;
+    bool isLoading() const;
+    size_t getResidentBytes() const;
+};
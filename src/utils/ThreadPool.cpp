@@ -0,0 +1,62 @@
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <algorithm>
+
+CThreadPool::CThreadPool(int threadCount) {
+    if (threadCount <= 0) {
+        threadCount = std::max(1, (int)thread::hardware_concurrency() - 1);
+    }
+    for (int i = 0; i < threadCount; ++i) {
+        workers.emplace_back(&CThreadPool::workerLoop, this);
+    }
+}
+
+CThreadPool::~CThreadPool() {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    available.notify_all();
+    for (auto& worker : workers) {
+        if (worker.joinable()) worker.join();
+    }
+}
+
+void CThreadPool::enqueue(function<void()> task) {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        tasks.push(std::move(task));
+    }
+    available.notify_one();
+}
+
+void CThreadPool::wait() {
+    unique_lock<mutex> lock(queueMutex);
+    idle.wait(lock, [this]() { return tasks.empty() && busyWorkers == 0; });
+}
+
+void CThreadPool::workerLoop() {
+    TRACE_THREAD_NAME("Worker");
+    while (true) {
+        function<void()> task;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            available.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop();
+            busyWorkers++;
+        }
+
+        {
+            TRACE_ZONE("Tarea");
+            task();
+        }
+
+        {
+            lock_guard<mutex> lock(queueMutex);
+            busyWorkers--;
+            if (tasks.empty() && busyWorkers == 0) idle.notify_all();
+        }
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+using namespace std;
+
+class CThreadPool {
+    vector<thread> workers;
+    queue<function<void()>> tasks;
+    mutex queueMutex;
+    condition_variable available;
+    condition_variable idle;
+    int busyWorkers = 0;
+    bool stopping = false;
+
+    void workerLoop();
+
+public:
+    explicit CThreadPool(int threadCount = 0);
+    ~CThreadPool();
+
+    void enqueue(function<void()> task);
+    void wait();
+    int getThreadCount() const { return (int)workers.size(); }
+};
@@ -0,0 +1,182 @@
+#include "Trace.h"
+#include "TextWriter.h"
+#include <chrono>
+#include <mutex>
+#include <memory>
+#include <algorithm>
+#include "Logger.h"
+
+static const size_t TRACE_CAPACITY = 1 << 16;
+
+struct TraceRegistry {
+    mutex lock;
+    vector<unique_ptr<CTraceBuffer>> buffers;
+    vector<CTraceBuffer*> freeBuffers;
+    int nextThreadId = 1;
+    chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+};
+
+static TraceRegistry& registry() {
+    static TraceRegistry* instance = new TraceRegistry();
+    return *instance;
+}
+
+struct TraceThread {
+    CTraceBuffer* buffer = nullptr;
+
+    ~TraceThread() {
+        if (!buffer) return;
+        TraceRegistry& reg = registry();
+        lock_guard<mutex> guard(reg.lock);
+        reg.freeBuffers.push_back(buffer);
+    }
+};
+
+CTraceBuffer::CTraceBuffer(int threadId, size_t capacity) : events(capacity), written(0), threadId(threadId) {}
+
+void CTraceBuffer::reset(int id) {
+    written.store(0, memory_order_relaxed);
+    threadId = id;
+    threadName.clear();
+}
+
+void CTraceBuffer::push(const TraceEvent& event) {
+    uint64_t index = written.load(memory_order_relaxed);
+    events[index & (events.size() - 1)] = event;
+    written.store(index + 1, memory_order_release);
+}
+
+size_t CTraceBuffer::snapshot(vector<TraceEvent>& out) const {
+    uint64_t end = written.load(memory_order_acquire);
+    uint64_t begin = end > events.size() ? end - events.size() : 0;
+    size_t first = out.size();
+    for (uint64_t i = begin; i < end; ++i) out.push_back(events[i & (events.size() - 1)]);
+
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t after = written.load(memory_order_relaxed);
+    uint64_t overwritten = after + 1 > events.size() ? after + 1 - events.size() : 0;
+    if (overwritten > begin) {
+        size_t stale = (size_t)(std::min(overwritten, end) - begin);
+        out.erase(out.begin() + first, out.begin() + first + stale);
+    }
+    return out.size() - first;
+}
+
+CTraceBuffer& CTrace::local() {
+    thread_local TraceThread current;
+    if (!current.buffer) {
+        TraceRegistry& reg = registry();
+        lock_guard<mutex> guard(reg.lock);
+        if (!reg.freeBuffers.empty()) {
+            current.buffer = reg.freeBuffers.back();
+            reg.freeBuffers.pop_back();
+            current.buffer->reset(reg.nextThreadId++);
+        } else {
+            reg.buffers.emplace_back(new CTraceBuffer(reg.nextThreadId++, TRACE_CAPACITY));
+            current.buffer = reg.buffers.back().get();
+        }
+    }
+    return *current.buffer;
+}
+
+uint64_t CTrace::now() {
+    return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - registry().epoch).count();
+}
+
+void CTrace::complete(const char* name, uint64_t start, uint64_t end) {
+    TraceEvent event;
+    event.name = name;
+    event.start = start;
+    event.duration = end - start;
+    event.type = 'X';
+    local().push(event);
+}
+
+void CTrace::counter(const char* name, double value) {
+    TraceEvent event;
+    event.name = name;
+    event.start = now();
+    event.value = value;
+    event.type = 'C';
+    local().push(event);
+}
+
+void CTrace::setThreadName(const string& name) {
+    TraceRegistry& reg = registry();
+    CTraceBuffer& buffer = local();
+    lock_guard<mutex> guard(reg.lock);
+    buffer.setThreadName(name);
+}
+
+static void appendMicros(CTextWriter& out, uint64_t nanoseconds) {
+    char fraction[8];
+    snprintf(fraction, sizeof(fraction), ".%03u", (unsigned)(nanoseconds % 1000));
+    out.appendInt((long long)(nanoseconds / 1000));
+    out.append(fraction);
+}
+
+bool CTrace::writeJson(const string& path) {
+    TraceRegistry& reg = registry();
+    vector<pair<int, string>> threads;
+    vector<TraceEvent> events;
+    vector<int> owners;
+    {
+        lock_guard<mutex> guard(reg.lock);
+        for (const auto& buffer : reg.buffers) {
+            threads.push_back(make_pair(buffer->getThreadId(), buffer->getThreadName()));
+            size_t count = buffer->snapshot(events);
+            owners.insert(owners.end(), count, buffer->getThreadId());
+        }
+    }
+
+    CTextWriter out;
+    out.reserve(events.size() * 96 + 1024);
+    out.append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (const auto& thread : threads) {
+        if (thread.second.empty()) continue;
+        if (!first) out.append(",\n");
+        first = false;
+        out.append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":");
+        out.appendInt(thread.first);
+        out.append(",\"args\":{\"name\":");
+        out.appendQuoted(thread.second.c_str());
+        out.append("}}");
+    }
+    for (size_t i = 0; i < events.size(); ++i) {
+        const TraceEvent& event = events[i];
+        if (!event.name) continue;
+        if (!first) out.append(",\n");
+        first = false;
+        out.append("{\"name\":");
+        out.appendQuoted(event.name);
+        out.append(",\"ph\":\"");
+        out.append(event.type);
+        out.append("\",\"pid\":1,\"tid\":");
+        out.appendInt(owners[i]);
+        out.append(",\"ts\":");
+        appendMicros(out, event.start);
+        if (event.type == 'X') {
+            out.append(",\"dur\":");
+            appendMicros(out, event.duration);
+        } else {
+            char value[32];
+            snprintf(value, sizeof(value), "%.17g", event.value);
+            out.append(",\"args\":{\"value\":");
+            out.append(value);
+            out.append('}');
+        }
+        out.append('}');
+    }
+    out.append("\n]}\n");
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        LOG_ERROR(LOG_IO, "Error guardando traza: %s", path.c_str());
+        return false;
+    }
+    bool ok = out.writeTo(file);
+    ok = (fclose(file) == 0) && ok;
+    if (ok) LOG_INFO(LOG_IO, "Traza guardada: %s (%zu eventos)", path.c_str(), events.size());
+    return ok;
+}
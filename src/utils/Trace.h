@@ -0,0 +1,67 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+using namespace std;
+
+struct TraceEvent {
+    const char* name = nullptr;
+    uint64_t start = 0;
+    uint64_t duration = 0;
+    double value = 0.0;
+    char type = 'X';
+};
+
+class CTraceBuffer {
+    vector<TraceEvent> events;
+    atomic<uint64_t> written;
+    int threadId;
+    string threadName;
+
+public:
+    CTraceBuffer(int threadId, size_t capacity);
+
+    void push(const TraceEvent& event);
+    void reset(int threadId);
+    void setThreadName(const string& name) { threadName = name; }
+
+    int getThreadId() const { return threadId; }
+    const string& getThreadName() const { return threadName; }
+    size_t snapshot(vector<TraceEvent>& out) const;
+};
+
+class CTrace {
+    static CTraceBuffer& local();
+
+public:
+    static uint64_t now();
+    static void complete(const char* name, uint64_t start, uint64_t end);
+    static void counter(const char* name, double value);
+    static void setThreadName(const string& name);
+    static bool writeJson(const string& path);
+};
+
+class CTraceZone {
+    const char* name;
+    uint64_t start;
+
+public:
+    explicit CTraceZone(const char* name) : name(name), start(CTrace::now()) {}
+    ~CTraceZone() { CTrace::complete(name, start, CTrace::now()); }
+    CTraceZone(const CTraceZone&) = delete;
+    CTraceZone& operator=(const CTraceZone&) = delete;
+};
+
+#ifdef VIEWER_TRACING
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_ZONE(name) CTraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+#define TRACE_COUNTER(name, value) CTrace::counter(name, (double)(value))
+#define TRACE_THREAD_NAME(name) CTrace::setThreadName(name)
+#else
+#define TRACE_ZONE(name) ((void)0)
+#define TRACE_COUNTER(name, value) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif